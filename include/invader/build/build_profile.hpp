@@ -0,0 +1,129 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__BUILD__BUILD_PROFILE_HPP
+#define INVADER__BUILD__BUILD_PROFILE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Invader {
+    /**
+     * Records how long each stage of a build takes, how much it allocates, and some counters
+     */
+    class BuildProfile {
+    public:
+        /**
+         * A stage that was recorded
+         */
+        struct Event {
+            /** Category of the stage (e.g. "compile") */
+            const char *category;
+
+            /** Name of the stage (e.g. the tag path) */
+            std::string name;
+
+            /** Microseconds since the profile was started */
+            std::uint64_t start;
+
+            /** Microseconds spent in the stage */
+            std::uint64_t duration;
+
+            /** Microseconds spent in the stage, excluding stages nested inside of it on the same thread */
+            std::uint64_t exclusive_duration;
+
+            /** Allocations made by the thread during the stage, excluding nested stages, if allocations are being counted */
+            std::uint64_t allocations;
+
+            /** Bytes allocated by the thread during the stage, excluding nested stages, if allocations are being counted */
+            std::uint64_t allocated_bytes;
+
+            /** Thread the stage ran on */
+            std::size_t thread;
+
+            /** The stage was not nested inside of another stage */
+            bool top_level;
+        };
+
+        /**
+         * Records a stage from construction until destruction. If no profile is given, this does nothing.
+         */
+        class Scope {
+        public:
+            /**
+             * Begin a stage
+             * @param profile  profile to record into, or nullptr to do nothing
+             * @param category category of the stage; must be a string literal
+             * @param name     name of the stage (copied); if nullptr, the category is used
+             */
+            Scope(BuildProfile *profile, const char *category, const char *name = nullptr);
+            Scope(const Scope &) = delete;
+            Scope &operator=(const Scope &) = delete;
+            ~Scope();
+
+        private:
+            BuildProfile *profile;
+            const char *category;
+            std::string name;
+            std::chrono::steady_clock::time_point start;
+            std::uint64_t child_duration = 0;
+            std::uint64_t child_allocations = 0;
+            std::uint64_t child_allocated_bytes = 0;
+            std::uint64_t allocations_start = 0;
+            std::uint64_t allocated_bytes_start = 0;
+            Scope *parent = nullptr;
+        };
+
+        /**
+         * Add to a counter
+         * @param name   name of the counter; must be a string literal
+         * @param amount amount to add
+         */
+        void add_counter(const char *name, std::uint64_t amount);
+
+        /**
+         * Write all stages and counters as a Chrome trace (chrome://tracing or Perfetto)
+         * @param path path to write to
+         * @return     true if successful
+         */
+        bool write_chrome_trace(const std::filesystem::path &path) const;
+
+        /**
+         * Get a summary of the time spent in each category and the counters
+         * @return summary text
+         */
+        std::string summary() const;
+
+        /**
+         * Get all recorded stages
+         * @return stages
+         */
+        std::vector<Event> get_events() const;
+
+        /**
+         * Count an allocation on the current thread. This is meant to be called from a replacement operator new.
+         * @param size size of the allocation
+         */
+        static void count_allocation(std::size_t size) noexcept;
+
+        /**
+         * Start a profile
+         */
+        BuildProfile();
+
+    private:
+        std::chrono::steady_clock::time_point start;
+        mutable std::mutex mutex;
+        std::vector<Event> events;
+        std::map<std::string, std::uint64_t> counters;
+        std::size_t thread_count = 0;
+
+        std::size_t get_thread_index();
+    };
+}
+
+#endif
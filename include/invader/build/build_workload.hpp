@@ -4,14 +4,19 @@
 #define INVADER__BUILD__BUILD_WORKLOAD_HPP
 
 #include <vector>
+#include <memory>
+#include <memory_resource>
 #include <optional>
 #include <string>
 #include <filesystem>
 #include <chrono>
+#include <cstdio>
 #include "../hek/map.hpp"
+#include "../file/file.hpp"
 #include "../resource/resource_map.hpp"
 #include "../tag/parser/parser.hpp"
 #include "../error_handler/error_handler.hpp"
+#include "build_profile.hpp"
 
 namespace Invader {
     class BuildWorkload : public ErrorHandler {
@@ -97,6 +102,27 @@ namespace Invader {
              */
             bool optimize_space = false;
             
+            /**
+             * Record how long each stage takes into this, if set
+             */
+            BuildProfile *profile = nullptr;
+            
+            /**
+             * Maximum number of threads to use for things done in parallel (0 to use the CPU thread count)
+             */
+            std::size_t max_threads = 0;
+            
+            /**
+             * Get the number of threads to use for things done in parallel
+             * @return number of threads (at least 1)
+             */
+            std::size_t get_thread_count() const noexcept;
+            
+            /**
+             * Index of the tags directories to find tags with. If not set, one is made when building a cache file.
+             */
+            const File::TagDirectoryIndex *tags_index = nullptr;
+            
             /**
              * Control how cache files are built. Changing these may result in an incompatible cache file
              */
@@ -219,11 +245,71 @@ namespace Invader {
             BuildParameters(BuildParameters &&) = default;
         };
         
+        /**
+         * Destination for a cache file, written front-to-back as it is built
+         */
+        class CacheFileSink {
+        public:
+            /**
+             * Write the next part of the cache file
+             * @param data data to write
+             * @param size size of the data
+             */
+            virtual void write(const std::byte *data, std::size_t size) = 0;
+            
+            virtual ~CacheFileSink() = default;
+        };
+        
+        /**
+         * Cache file sink that holds the cache file in memory
+         */
+        class CacheFileVectorSink : public CacheFileSink {
+        public:
+            /** Cache file data written so far */
+            std::vector<std::byte> data;
+            
+            void write(const std::byte *data, std::size_t size) override;
+        };
+        
+        /**
+         * Cache file sink that writes the cache file to a temporary file next to the destination (created on the first write) and moves it into place when finished
+         */
+        class CacheFileFileSink : public CacheFileSink {
+        public:
+            /**
+             * Instantiate a file sink
+             * @param path path to write to
+             */
+            CacheFileFileSink(const std::filesystem::path &path);
+            CacheFileFileSink(const CacheFileFileSink &) = delete;
+            ~CacheFileFileSink() override;
+            
+            void write(const std::byte *data, std::size_t size) override;
+            
+            /**
+             * Close the temporary file and move it to the destination. If this is not called (e.g. the build failed), the temporary file is deleted and the destination is left alone.
+             */
+            void finish();
+            
+        private:
+            std::filesystem::path path;
+            std::filesystem::path temp_path;
+            std::FILE *file = nullptr;
+        };
+        
         /**
          * Compile a map
          * @param parameters build parameters to use
+         * @return           cache file data
          */
         static std::vector<std::byte> compile_map(const BuildParameters &parameters);
+        
+        /**
+         * Compile a map, writing it to a sink instead of returning it
+         * @param parameters build parameters to use
+         * @param sink       sink to write to
+         */
+        static void compile_map(const BuildParameters &parameters, CacheFileSink &sink);
 
         /**
          * Compile a single tag
@@ -280,16 +366,18 @@ namespace Invader {
             }
         };
 
-        /** Denotes an individual tag struct */
+        /** Denotes an individual tag struct; when in BuildWorkload::structs, its data and relocations are allocated from the workload's struct memory */
         struct BuildWorkloadStruct {
+            using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
             /** Data in the struct */
-            std::vector<std::byte> data;
+            std::pmr::vector<std::byte> data;
 
             /** Dependencies in the struct */
-            std::vector<BuildWorkloadDependency> dependencies;
+            std::pmr::vector<BuildWorkloadDependency> dependencies;
 
             /** Struct dependencies in the struct */
-            std::vector<BuildWorkloadStructPointer> pointers;
+            std::pmr::vector<BuildWorkloadStructPointer> pointers;
 
             /** Offset of the struct in tag data if it's currently present */
             std::optional<std::size_t> offset;
@@ -338,6 +426,30 @@ namespace Invader {
              * @return       true if it can be
              */
             bool can_dedupe(const BuildWorkloadStruct &other) const noexcept;
+
+            BuildWorkloadStruct() = default;
+            BuildWorkloadStruct(const BuildWorkloadStruct &) = default;
+            BuildWorkloadStruct(BuildWorkloadStruct &&) = default;
+            BuildWorkloadStruct &operator=(const BuildWorkloadStruct &) = default;
+            BuildWorkloadStruct &operator=(BuildWorkloadStruct &&) = default;
+
+            explicit BuildWorkloadStruct(const allocator_type &allocator) : data(allocator), dependencies(allocator), pointers(allocator) {}
+
+            BuildWorkloadStruct(const BuildWorkloadStruct &other, const allocator_type &allocator) :
+                data(other.data, allocator),
+                dependencies(other.dependencies, allocator),
+                pointers(other.pointers, allocator),
+                offset(other.offset),
+                unsafe_to_dedupe(other.unsafe_to_dedupe),
+                bsp(other.bsp) {}
+
+            BuildWorkloadStruct(BuildWorkloadStruct &&other, const allocator_type &allocator) :
+                data(std::move(other.data), allocator),
+                dependencies(std::move(other.dependencies), allocator),
+                pointers(std::move(other.pointers), allocator),
+                offset(other.offset),
+                unsafe_to_dedupe(other.unsafe_to_dedupe),
+                bsp(other.bsp) {}
         };
 
         /** Denotes an individual tag */
@@ -370,8 +482,14 @@ namespace Invader {
             std::size_t path_offset;
         };
 
+        /**
+         * Memory for structs. Structs are small and numerous, so they are pooled instead of each getting their own heap allocations.
+         * This is not thread-safe, so structs must not be added to or resized from multiple threads at once.
+         */
+        std::unique_ptr<std::pmr::unsynchronized_pool_resource> struct_memory = std::make_unique<std::pmr::unsynchronized_pool_resource>();
+
         /** Structs being worked with */
-        std::vector<BuildWorkloadStruct> structs;
+        std::pmr::vector<BuildWorkloadStruct> structs { struct_memory.get() };
 
         /** Uncompressed vertices for models */
         std::vector<Parser::ModelVertexUncompressed::struct_little> uncompressed_model_vertices;
@@ -431,6 +549,21 @@ namespace Invader {
         const BuildParameters *get_build_parameters() const noexcept {
             return this->parameters;
         }
+        
+        /**
+         * Find the file of a tag in the tags directories, using the tags directory index if there is one
+         * @param tag_path tag path with extension
+         * @return         file path or std::nullopt if not found
+         */
+        std::optional<std::filesystem::path> find_tag_file(const std::string &tag_path) const;
+        
+        /**
+         * Get the tags directory index being used, if any
+         * @return tags directory index or nullptr
+         */
+        const File::TagDirectoryIndex *get_tags_index() const noexcept {
+            return this->tags_index;
+        }
 
         /**
          * Add the tag
@@ -449,6 +582,7 @@ namespace Invader {
          */
         void compile_tag_data_recursively(const std::byte *tag_data, std::size_t tag_data_size, std::size_t tag_index, std::optional<TagFourCC> tag_fourcc = std::nullopt);
         
+        BuildWorkload(BuildWorkload &&) = default;
         ~BuildWorkload() override = default;
 
     private:
@@ -456,7 +590,9 @@ namespace Invader {
 
         std::chrono::steady_clock::time_point start;
         const char *scenario;
-        std::vector<std::byte> build_cache_file();
+        const File::TagDirectoryIndex *tags_index = nullptr;
+        std::unique_ptr<File::TagDirectoryIndex> owned_tags_index;
+        void build_cache_file(CacheFileSink &sink);
         void add_tags();
         void generate_tag_array();
         void dedupe_structs();
@@ -0,0 +1,34 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__CRC__HASH_HPP
+#define INVADER__CRC__HASH_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace Invader {
+    /** Starting value for a 64-bit FNV-1a hash */
+    static constexpr std::uint64_t FNV1A_64_OFFSET_BASIS = 0xCBF29CE484222325;
+
+    /**
+     * Calculate the 64-bit FNV-1a hash of some data. This is used for content hashing and is not cryptographically secure.
+     * @param  data data to hash
+     * @param  size size of data
+     * @param  hash hash to continue from (use this to hash multiple buffers as one)
+     * @return      hash
+     */
+    std::uint64_t fnv1a_64(const std::byte *data, std::size_t size, std::uint64_t hash = FNV1A_64_OFFSET_BASIS) noexcept;
+
+    /**
+     * Calculate the 64-bit FNV-1a hash of some data. This is used for content hashing and is not cryptographically secure.
+     * @param  data data to hash
+     * @param  hash hash to continue from (use this to hash multiple buffers as one)
+     * @return      hash
+     */
+    inline std::uint64_t fnv1a_64(const std::vector<std::byte> &data, std::uint64_t hash = FNV1A_64_OFFSET_BASIS) noexcept {
+        return fnv1a_64(data.data(), data.size(), hash);
+    }
+}
+
+#endif
@@ -6,6 +6,8 @@
 #include <cstdint>
 #include <cstddef>
 #include <optional>
+#include <utility>
+#include <vector>
 
 namespace Invader {
     /**
@@ -19,6 +21,16 @@ namespace Invader {
      */
     std::uint32_t calculate_map_crc(const std::byte *data, std::size_t size, const std::uint32_t *new_crc = nullptr, std::uint32_t *new_random = nullptr, bool *check_dirty = nullptr);
     
+    /**
+     * Calculate the CRC32 of a map from just the parts of it that are checksummed
+     * @param  regions                   data to checksum in order (BSPs, model data, then tag data)
+     * @param  tag_file_checksums_offset offset of the tag file checksums in the tag data header, counting from the start of the first region (used if forging a CRC32)
+     * @param  new_crc                   new CRC32 of the map
+     * @param  new_random                new random number of the map (if forging a CRC32)
+     * @return                           CRC32 of the map
+     */
+    std::uint32_t calculate_map_crc(const std::vector<std::pair<const std::byte *, std::size_t>> &regions, std::size_t tag_file_checksums_offset, const std::uint32_t *new_crc = nullptr, std::uint32_t *new_random = nullptr);
+    
     class Map;
     
     /**
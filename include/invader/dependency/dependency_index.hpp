@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__DEPENDENCY__DEPENDENCY_INDEX_HPP
+#define INVADER__DEPENDENCY__DEPENDENCY_INDEX_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../hek/fourcc.hpp"
+#include "../file/file.hpp"
+
+namespace Invader {
+    /**
+     * Index of what every tag in a set of tags directories depends on, used to find the tags that reference a tag without parsing every tag.
+     * The index for each tags directory is saved next to it and records what tags reference by their content hash, so only tags whose contents are not in it are parsed again.
+     * Tags are hashed with File::get_tag_file_hash(), so with a tags manifest, tags that did not change are not read at all.
+     */
+    class DependencyIndex {
+    public:
+        /**
+         * A tag in the index
+         */
+        struct IndexedTag {
+            /** Path (in Halo format, without the extension) and class of the tag */
+            File::TagFilePath path;
+
+            /** Full filesystem path */
+            std::filesystem::path full_path;
+
+            /** Everything the tag references (in Halo format), without duplicates */
+            std::vector<File::TagFilePath> dependencies;
+        };
+
+        /**
+         * Get the path of the dependency index for a tags directory (the tags directory's path with .invader-dependency-index appended)
+         * @param  tags_directory tags directory
+         * @return                path to the dependency index
+         */
+        static std::filesystem::path index_path(const std::filesystem::path &tags_directory);
+
+        /**
+         * Find all tags that reference a tag. If a tag is in more than one tags directory, only the one with the highest priority is checked.
+         * @param tag path (in Halo format, without the extension) and class of the tag to find
+         * @return    tags that reference the tag
+         */
+        std::vector<const IndexedTag *> find_referencing_tags(const File::TagFilePath &tag) const;
+
+        /**
+         * Find the tag at a path in the index
+         * @param full_path full filesystem path of the tag
+         * @return          the tag, or nullptr if it isn't indexed (e.g. it could not be parsed)
+         */
+        const IndexedTag *find_tag(const std::filesystem::path &full_path) const;
+
+        /**
+         * Get the number of tags that had to be parsed because they were not in the saved index or had changed
+         * @return number of tags parsed
+         */
+        std::size_t get_tags_parsed() const noexcept {
+            return this->tags_parsed;
+        }
+
+        /**
+         * Load the index for the tags directories, updating and saving it if any tags changed
+         * @param tags    tags directories in order of priority
+         * @param rebuild ignore the saved index and parse every tag again
+         * @param threads number of threads to use for parsing tags (0 to use the CPU thread count)
+         */
+        DependencyIndex(const std::vector<std::filesystem::path> &tags, bool rebuild = false, std::size_t threads = 0);
+
+    private:
+        struct TagFilePathHash {
+            std::size_t operator()(const File::TagFilePath &path) const noexcept {
+                return std::hash<std::string>()(path.path) ^ (static_cast<std::size_t>(path.fourcc) * 0x9E3779B97F4A7C15ULL);
+            }
+        };
+
+        /** Every tag that could be parsed */
+        std::vector<IndexedTag> tags;
+
+        /** Indices of the tags with the highest priority that reference each tag */
+        std::unordered_map<File::TagFilePath, std::vector<std::size_t>, TagFilePathHash> referenced_by;
+
+        /** Indices of the tags by their full filesystem path */
+        std::unordered_map<std::string, std::size_t> by_full_path;
+
+        /** Number of tags parsed */
+        std::size_t tags_parsed = 0;
+    };
+}
+
+#endif
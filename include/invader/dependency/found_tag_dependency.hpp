@@ -8,6 +8,7 @@
 #include <vector>
 #include <optional>
 #include "../hek/fourcc.hpp"
+#include "../file/file.hpp"
 
 namespace Invader {
     struct FoundTagDependency {
@@ -16,7 +17,15 @@ namespace Invader {
         bool broken;
         std::optional<std::filesystem::path> file_path;
 
-        static std::vector<FoundTagDependency> find_dependencies(const char *tag_path_to_find, Invader::TagFourCC tag_int_to_find, std::vector<std::filesystem::path> tags, bool reverse, bool recursive, bool &success);
+        /**
+         * Find everything a tag references without parsing it
+         * @param tag_data      tag file data
+         * @param tag_data_size size of the tag file data
+         * @return              dependencies (in Halo format), without duplicates
+         */
+        static std::vector<File::TagFilePath> get_dependencies(const std::byte *tag_data, std::size_t tag_data_size);
+
+        static std::vector<FoundTagDependency> find_dependencies(const char *tag_path_to_find, Invader::TagFourCC tag_int_to_find, std::vector<std::filesystem::path> tags, bool reverse, bool recursive, bool &success, const File::TagDirectoryIndex *tags_index = nullptr);
 
         FoundTagDependency(std::string path, Invader::TagFourCC fourcc, bool broken, std::optional<std::filesystem::path> file_path) : path(path), fourcc(fourcc), broken(broken), file_path(file_path) {}
     };
@@ -4,6 +4,8 @@
 #define INVADER__EXTRACT__EXTRACTION_HPP
 
 #include <vector>
+#include <map>
+#include <mutex>
 #include "../map/tag.hpp"
 #include "../error_handler/error_handler.hpp"
 
@@ -14,6 +16,94 @@ namespace Invader::Parser {
 namespace Invader {
     class ExtractionWorkload : public ErrorHandler {
     public:
+        /**
+         * Destination for extracted tags other than a tags directory
+         */
+        class TagSink {
+        public:
+            /**
+             * Write an extracted tag. This may be called from multiple threads at once.
+             * @param tag_path path of the tag relative to the tags directory, with the extension
+             * @param data     tag data
+             * @return         true if successful
+             */
+            virtual bool write_tag(const std::filesystem::path &tag_path, const std::vector<std::byte> &data) = 0;
+            
+            virtual ~TagSink() = default;
+        };
+        
+        /**
+         * Keeps track of tags extracted from multiple maps so that a tag that is identical in several maps is only saved once
+         */
+        class BulkExtraction {
+        public:
+            /**
+             * Set the map that tags are being extracted from next
+             * @param map_name path of the map as given, used to tell maps apart in conflicts and the manifest
+             */
+            void begin_map(const std::string &map_name);
+            
+            /**
+             * Write a manifest listing each version of each tag extracted, whether it was saved, and which maps have it
+             * @param path path to write to
+             * @return     true if successful
+             */
+            bool write_manifest(const std::filesystem::path &path) const;
+            
+            /**
+             * Get the number of tags that were not saved because an identical tag was already saved
+             * @return number of duplicates
+             */
+            std::size_t get_duplicates() const noexcept {
+                return this->duplicates;
+            }
+            
+            /**
+             * Get the number of tags that were not saved because a different tag with the same path was already saved
+             * @return number of conflicts
+             */
+            std::size_t get_conflicts() const noexcept {
+                return this->conflicts;
+            }
+            
+        private:
+            friend class ExtractionWorkload;
+            
+            struct TagVersion {
+                std::uint64_t hash;
+                bool saved;
+                std::vector<std::size_t> maps;
+            };
+            
+            enum AddResult {
+                ADD_RESULT_SAVE,
+                ADD_RESULT_DUPLICATE,
+                ADD_RESULT_CONFLICT
+            };
+            
+            /**
+             * Record a tag extracted from the current map
+             * @param tag_path      tag path with extension
+             * @param hash          hash of the tag data
+             * @param conflict_map  set to the map the saved version came from if there is a conflict
+             * @return              what to do with the tag
+             */
+            AddResult add_tag(const std::string &tag_path, std::uint64_t hash, std::string &conflict_map);
+            
+            /**
+             * Check if a tag was extracted from any map so far
+             * @param tag_path tag path with extension
+             * @return         true if extracted
+             */
+            bool contains(const std::string &tag_path) const;
+            
+            mutable std::mutex mutex;
+            std::map<std::string, std::vector<TagVersion>> tags;
+            std::vector<std::string> map_names;
+            std::size_t duplicates = 0;
+            std::size_t conflicts = 0;
+        };
+        
         /**
          * Extract a single tag from a map
          * @param tag             tag from a loaded map to extract
@@ -31,8 +121,11 @@ namespace Invader {
          * @param overwrite       overwrite tag files that exist
          * @param non_mp_globals  allow extraction of non-multiplayer globals
          * @param reporting_level reporting level to use
+         * @param threads         number of threads to extract tags with
+         * @param sink            if set, write tags here instead of the tags directory (overwrite is ignored)
+         * @param bulk            if set, skip tags that were already saved from another map and report conflicts
          */
-        static void extract_map(const Map &map, const std::string &tags, const std::vector<std::string> &queries, const std::vector<std::string> &queries_exclude, bool recursive = false, bool overwrite = false, bool non_mp_globals = false, ReportingLevel reporting_level = ReportingLevel::REPORTING_LEVEL_ALL);
+        static void extract_map(const Map &map, const std::string &tags, const std::vector<std::string> &queries, const std::vector<std::string> &queries_exclude, bool recursive = false, bool overwrite = false, bool non_mp_globals = false, ReportingLevel reporting_level = ReportingLevel::REPORTING_LEVEL_ALL, std::size_t threads = 1, TagSink *sink = nullptr, BulkExtraction *bulk = nullptr);
         
     private:
         /**
@@ -49,9 +142,12 @@ namespace Invader {
          * @param recursive       also extract tags depended by a tag
          * @param overwrite       overwrite tag files that exist
          * @param non_mp_globals  allow extraction of non-multiplayer globals
+         * @param threads         number of threads to extract tags with
+         * @param sink            if set, write tags here instead of the tags directory
+         * @param bulk            if set, skip tags that were already saved from another map and report conflicts
          * @return                number of tags successfully extracted
          */
-        std::size_t perform_extraction(const std::vector<std::string> &queries, const std::vector<std::string> &queries_exclude, const std::filesystem::path &tags, bool recursive, bool overwrite, bool non_mp_globals);
+        std::size_t perform_extraction(const std::vector<std::string> &queries, const std::vector<std::string> &queries_exclude, const std::filesystem::path &tags, bool recursive, bool overwrite, bool non_mp_globals, std::size_t threads, TagSink *sink, BulkExtraction *bulk);
         
         /** Map reference */
         const Map &map;
@@ -8,6 +8,7 @@
 #include <filesystem>
 #include <optional>
 #include <mutex>
+#include <unordered_map>
 
 #include "../hek/fourcc.hpp"
 
@@ -76,6 +77,23 @@ namespace Invader::File {
      */
     bool save_file(const std::filesystem::path &path, const std::vector<std::byte> &data);
 
+    /**
+     * Create and open a new temporary file next to a file. The name includes the process ID and a random suffix, so other threads and processes
+     * writing the same file get their own temporary file.
+     * @param  path      path to the file the temporary file is for
+     * @param  temp_path set to the path of the temporary file
+     * @return           the opened temporary file (opened for writing in binary mode), or nullptr on failure
+     */
+    std::FILE *open_temp_file(const std::filesystem::path &path, std::filesystem::path &temp_path);
+
+    /**
+     * Save the file by writing it to a temporary file next to it and then renaming it into place, so the file is never seen half-written
+     * @param  path path to the file
+     * @param  data data to write
+     * @return      true on success; false on failure (nothing is printed)
+     */
+    bool save_file_atomically(const std::filesystem::path &path, const std::vector<std::byte> &data);
+
     /**
      * Convert a tag path to a file path for one tags directory. The file must exist, or std::nullopt will be returned.
      * @param  tag_path   tag path to use
@@ -151,12 +169,53 @@ namespace Invader::File {
         /** Tag class of this tag */
         HEK::TagFourCC tag_fourcc = {};
 
+        /** Size of the tag in bytes (only set if the tags directory has a tags manifest) */
+        std::uint64_t size = 0;
+
+        /** Modification time of the tag (only set if the tags directory has a tags manifest) */
+        std::int64_t modified = 0;
+
+        /** Content hash of the tag if it was recorded in the tags manifest or by get_tag_file_hash(); use get_tag_file_hash() to get the current hash */
+        std::optional<std::uint64_t> content_hash;
+
         /**
          * Split the tag path
          */
         std::vector<std::string> split_tag_path();
     };
 
+    /**
+     * Get the path of the tags manifest for a tags directory (the tags directory's path with .invader-manifest appended).
+     * If the file exists, load_virtual_tag_folder() only lists directories that were modified since it was last saved, and it keeps it up to date.
+     * @param  tags_directory tags directory
+     * @return                path to the tags manifest
+     */
+    std::filesystem::path tags_manifest_path(const std::filesystem::path &tags_directory);
+
+    /**
+     * Get the content hash (64-bit FNV-1a) of a tag if it is known and the tag's size and modification time did not change since. The tag is not read.
+     * @param  tag tag to check
+     * @return     hash, or std::nullopt if it is not known
+     */
+    std::optional<std::uint64_t> get_recorded_tag_file_hash(const TagFile &tag);
+
+    /**
+     * Get the content hash (64-bit FNV-1a) of a tag. If the hash is known and the tag's size and modification time did not change, the tag is not read.
+     * Otherwise, the tag is read and hashed, and its size, modification time, and hash are stored in tag so they can be saved with save_tag_file_hashes().
+     * @param  tag       tag to hash
+     * @param  data_read if set and the tag had to be read, the tag's contents are moved here (otherwise it is left untouched)
+     * @return           hash, or std::nullopt if the tag could not be read
+     */
+    std::optional<std::uint64_t> get_tag_file_hash(TagFile &tag, std::vector<std::byte> *data_read = nullptr);
+
+    /**
+     * Record the hashes of tags in the tags manifests of their tags directories so they don't need to be read again next time.
+     * Tags directories without a tags manifest, tags that are not in the manifest, and tags that were modified very recently are skipped.
+     * @param tags      tags directories given to load_virtual_tag_folder()
+     * @param tag_files tags returned by load_virtual_tag_folder()
+     */
+    void save_tag_file_hashes(const std::vector<std::filesystem::path> &tags, const std::vector<TagFile> &tag_files);
+
     /**
      * Read a tags directory
      * @param  tags              tag directories
@@ -167,6 +226,69 @@ namespace Invader::File {
      */
     std::vector<TagFile> load_virtual_tag_folder(const std::vector<std::filesystem::path> &tags, bool filter_duplicates = true, std::pair<std::mutex, std::size_t> *status = nullptr, std::size_t *errors = nullptr);
 
+    /**
+     * Index of every tag in a set of tags directories, used to find tags without checking the filesystem for each one
+     */
+    class TagDirectoryIndex {
+    public:
+        /**
+         * Find the file for a tag path (with extension)
+         * @param  tag_path tag path to find (either separator may be used)
+         * @return          file path or std::nullopt if no tags directory has it
+         */
+        std::optional<std::filesystem::path> find(const std::string &tag_path) const;
+
+        /**
+         * Find the file for a tag path
+         * @param  tag_path tag path to find
+         * @return          file path or std::nullopt if no tags directory has it
+         */
+        std::optional<std::filesystem::path> find(const TagFilePath &tag_path) const;
+
+        /**
+         * Find the tag for a tag path (with extension)
+         * @param  tag_path tag path to find (either separator may be used)
+         * @return          tag or nullptr if no tags directory has it
+         */
+        const TagFile *find_tag(const std::string &tag_path) const;
+
+        /**
+         * Get all tags in the index, with duplicates in lower priority tags directories filtered out
+         * @return tags
+         */
+        const std::vector<TagFile> &get_tags() const noexcept {
+            return this->tags;
+        }
+
+        /**
+         * Get the tags directories that were indexed
+         * @return tags directories
+         */
+        const std::vector<std::filesystem::path> &get_tags_directories() const noexcept {
+            return this->tags_directories;
+        }
+
+        /**
+         * Index the tags directories
+         * @param tags   tags directories, ordered by priority
+         * @param errors optional pointer to hold the number of errors
+         */
+        TagDirectoryIndex(const std::vector<std::filesystem::path> &tags, std::size_t *errors = nullptr);
+
+        /**
+         * Index tags that were already loaded with load_virtual_tag_folder() (with duplicates filtered)
+         * @param tags             tags that were loaded
+         * @param tags_directories tags directories they were loaded from
+         */
+        TagDirectoryIndex(std::vector<TagFile> tags, const std::vector<std::filesystem::path> &tags_directories);
+
+    private:
+        std::vector<std::filesystem::path> tags_directories;
+        std::vector<TagFile> tags;
+        std::unordered_map<std::string, std::size_t> tags_by_path;
+        void build_lookup();
+    };
+
     /**
      * Convert the tag path to a path using the system's preferred separators
      * @param  tag_path tag path input
@@ -5,9 +5,14 @@
 
 #include <string>
 #include <vector>
+#include <atomic>
 #include <cstddef>
+#include <iterator>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <string_view>
+#include <unordered_map>
 
 #include "../resource/resource_map.hpp"
 #include "../hek/map.hpp"
@@ -279,7 +284,67 @@ namespace Invader {
          * @param tag_fourcc tag class to find
          * @return              the index of the first tag found or std::nullopt if not found
          */
-        std::optional<std::size_t> find_tag(const char *tag_path, TagFourCC tag_fourcc) const noexcept;
+        std::optional<std::size_t> find_tag(const char *tag_path, TagFourCC tag_fourcc) const;
+
+        /**
+         * Find multiple tags with the given paths and classes
+         * @param tags tag paths and classes to find
+         * @return     the index of the first tag found for each path and class, or std::nullopt for each one not found
+         */
+        std::vector<std::optional<std::size_t>> find_tags(const std::vector<std::pair<std::string, TagFourCC>> &tags) const;
+
+        /**
+         * Iterates through each tag in the map, loading each one when it is reached
+         */
+        class TagIterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = Tag;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const Tag *;
+            using reference = const Tag &;
+
+            reference operator*() const {
+                return this->map->get_tag(this->index);
+            }
+            pointer operator->() const {
+                return &**this;
+            }
+            TagIterator &operator++() noexcept {
+                this->index++;
+                return *this;
+            }
+            TagIterator operator++(int) noexcept {
+                auto copy = *this;
+                this->index++;
+                return copy;
+            }
+            bool operator==(const TagIterator &other) const noexcept {
+                return this->map == other.map && this->index == other.index;
+            }
+            bool operator!=(const TagIterator &other) const noexcept {
+                return !(*this == other);
+            }
+
+            TagIterator() = default;
+        private:
+            friend class Map;
+            TagIterator(const Map *map, std::size_t index) noexcept : map(map), index(index) {}
+            const Map *map = nullptr;
+            std::size_t index = 0;
+        };
+
+        /**
+         * Get an iterator to the first tag
+         * @return iterator
+         */
+        TagIterator begin() const noexcept;
+
+        /**
+         * Get an iterator past the last tag
+         * @return iterator
+         */
+        TagIterator end() const noexcept;
 
         /**
          * Get the scenario tag ID
@@ -338,18 +403,49 @@ namespace Invader {
         
 
         /** Model data offset */
-        std::size_t model_data_offset;
+        std::size_t model_data_offset = 0;
 
         /** Model index offset */
-        std::size_t model_index_offset;
+        std::size_t model_index_offset = 0;
 
         /** Model data size too! */
-        std::size_t model_data_size;
+        std::size_t model_data_size = 0;
 
 
         /** Tag array */
         std::vector<Tag> tags;
 
+        /** Key for looking up tags by path and class; the path points to the tag's path in the tag array */
+        struct TagLookupKey {
+            std::string_view path;
+            TagFourCC tag_fourcc;
+
+            bool operator==(const TagLookupKey &other) const noexcept {
+                return this->tag_fourcc == other.tag_fourcc && this->path == other.path;
+            }
+        };
+
+        struct TagLookupKeyHash {
+            std::size_t operator()(const TagLookupKey &key) const noexcept {
+                return std::hash<std::string_view>()(key.path) ^ (static_cast<std::size_t>(key.tag_fourcc) * 0x9E3779B97F4A7C15ULL);
+            }
+        };
+
+        /** Index of the first tag with each path and class, built the first time a tag is looked up */
+        std::unordered_map<TagLookupKey, std::size_t, TagLookupKeyHash> tag_lookup;
+
+        /** Set once the tag lookup is built */
+        std::unique_ptr<std::once_flag> tag_lookup_built;
+
+        /** Set once each tag's path is read from the tag array */
+        struct TagState {
+            std::once_flag path;
+        };
+        std::unique_ptr<TagState[]> tag_state;
+
+        /** Offset of the tag array in tag data */
+        std::size_t tag_array_offset = 0;
+
         /** Scenario tag ID */
         std::size_t scenario_tag_id = 0;
 
@@ -363,19 +459,19 @@ namespace Invader {
         std::uint32_t base_memory_address = 0;
         
         /** Invalid paths? */
-        bool invalid_paths_detected = false;
+        std::atomic<bool> invalid_paths_detected = false;
 
         /** Map is compressed */
         CompressionType compressed = CompressionType::COMPRESSION_TYPE_NONE;
 
         /** Engine */
-        HEK::GameEngine game_engine;
+        HEK::GameEngine game_engine = {};
         
         /** Cache version */
-        HEK::CacheFileEngine cache_version;
+        HEK::CacheFileEngine cache_version = {};
 
         /** Type */
-        HEK::CacheFileType type;
+        HEK::CacheFileType type = {};
 
         /** Name */
         HEK::TagString scenario_name;
@@ -387,24 +483,40 @@ namespace Invader {
         std::optional<std::uint32_t> crc32;
         
         /** CRC32 in header */
-        std::uint32_t header_crc32;
+        std::uint32_t header_crc32 = 0;
 
         /** Asset indices offset */
-        std::uint64_t asset_indices_offset;
+        std::uint64_t asset_indices_offset = 0;
         
         /** Header file size */
-        std::uint64_t header_decompressed_file_size;
+        std::uint64_t header_decompressed_file_size = 0;
         
         /** Header type */
-        HEK::CacheFileType header_type;
+        HEK::CacheFileType header_type = {};
         
 
         /** Load the map now */
         void load_map();
 
-        /** Populate tag array */
+        /** Populate tag array; tag paths are only read from the tag array when they are first accessed */
         void populate_tag_array();
 
+        /**
+         * Read the tag's path from the tag array if it hasn't been read yet
+         * @param index the tag index
+         */
+        void populate_tag_path(std::size_t index) const;
+
+        /**
+         * Read where the tag's data is located from the tag array; this is done for every tag when the map is loaded
+         * @param index the tag index
+         * @throws      OutOfBoundsException if the tag's data could not be located
+         */
+        void populate_tag_data(std::size_t index);
+
+        /** Read every tag's path and build the tag lookup if it hasn't been built yet */
+        void populate_tag_lookup() const;
+
         /** Get BSPs */
         void get_bsps();
 
@@ -27,7 +27,7 @@ namespace Invader {
          * @return the map
          */
         Map &get_map() noexcept {
-            return this->map;
+            return *this->map;
         }
 
         /**
@@ -255,8 +255,8 @@ namespace Invader {
         }
 
     private:
-        /** Map reference */
-        Map &map;
+        /** Map this is in (updated if the map is moved) */
+        Map *map;
 
         /** Path of tag */
         std::string path;
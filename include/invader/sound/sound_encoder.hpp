@@ -52,14 +52,22 @@ namespace Invader::SoundEncoder {
      */
     std::vector<std::byte> encode_to_flac(const std::vector<std::byte> &pcm, std::size_t bits_per_sample, std::uint32_t channel_count, std::uint32_t sample_rate, std::uint32_t compression_level = 5);
 
+    /** Number of blocks run through the Xbox ADPCM encoder before a segment or chunk so its step indices have settled */
+    constexpr std::size_t XBOX_ADPCM_WARM_UP_BLOCK_COUNT = 4;
+
     /**
      * Encode the PCM data to Xbox ADPCM. This is lossy.
+     *
+     * If segment_count is greater than 1, the stream is split into that many segments on block boundaries which are encoded on separate threads.
+     * Each segment is primed by encoding a few of the blocks preceding it, so the output is usually identical or nearly identical to a serial encode.
      * @param pcm             PCM data
      * @param bits_per_sample bits per sample of the PCM data
      * @param channel_count   number of channels
+     * @param segment_count   number of segments to encode in parallel
+     * @param preceding_pcm   if pcm continues a longer stream, the PCM data (ending on a block boundary) directly before it; up to XBOX_ADPCM_WARM_UP_BLOCK_COUNT blocks at its end are used to prime the encoder in the same way
      * @return                Xbox ADPCM data
      */
-    std::vector<std::byte> encode_to_xbox_adpcm(const std::vector<std::byte> &pcm, std::size_t bits_per_sample, std::size_t channel_count);
+    std::vector<std::byte> encode_to_xbox_adpcm(const std::vector<std::byte> &pcm, std::size_t bits_per_sample, std::size_t channel_count, std::size_t segment_count = 1, const std::vector<std::byte> &preceding_pcm = std::vector<std::byte>());
     
     /**
      * Calculate the PCM block size to use for encoding to ADPCM. Basically the number of samples must be a multiple of this.
@@ -68,6 +76,13 @@ namespace Invader::SoundEncoder {
      */
     std::size_t calculate_adpcm_pcm_block_size(std::size_t channel_count) noexcept;
 
+    /**
+     * Calculate the size in bytes of one encoded Xbox ADPCM block.
+     * @param channel_count channel count
+     * @return              ADPCM block size in bytes
+     */
+    std::size_t calculate_adpcm_block_size(std::size_t channel_count) noexcept;
+
     /**
      * Encode the PCM data to 16-bit big endian PCM. This is lossless unless the input data is greater than 16 bits.
      * @param pcm             PCM data
@@ -3,10 +3,64 @@
 #ifndef INVADER__TAG__HEK__CLASS__MODEL_COLLISION_GEOMETRY_HPP
 #define INVADER__TAG__HEK__CLASS__MODEL_COLLISION_GEOMETRY_HPP
 
+#include <vector>
 #include "../../../hek/data_type.hpp"
 #include "../definition.hpp"
 
 namespace Invader::HEK {
+    /**
+     * Pending half of a line that was split by a BSP3D plane when checking for intersections
+     */
+    struct BSPIntersectionStackFrame {
+        struct Result {
+            Point3D<LittleEndian> intersection_point;
+            std::uint32_t surface_index;
+            std::uint32_t leaf_index;
+        };
+
+        Point3D<LittleEndian> point_a;
+        Point3D<LittleEndian> point_b;
+        Point3D<LittleEndian> split_point;
+        FlaggedInt<std::uint32_t> node_index_b;
+        bool first_half_done;
+        bool first_half_intersected;
+        Result first_half_result;
+    };
+
+    /**
+     * Input and output of a batch of vertical intersection checks. Keep this around between batches to avoid reallocating.
+     */
+    struct BSPIntersectionBatch {
+        /** Points to check; fill this in before checking */
+        std::vector<Point3D<LittleEndian>> points;
+
+        /** Whether or not an intersection was found for each point */
+        std::vector<bool> found;
+
+        /** Closest intersection for each point, if found */
+        std::vector<Point3D<LittleEndian>> intersection_points;
+
+        /** Surface index for each point, if found */
+        std::vector<std::uint32_t> surface_indices;
+
+        /** Leaf index for each point, if found */
+        std::vector<std::uint32_t> leaf_indices;
+
+        /** Stack used for traversing the BSP */
+        std::vector<BSPIntersectionStackFrame> stack;
+
+        /**
+         * Clear the points and results, keeping any allocated memory
+         */
+        void clear() noexcept {
+            this->points.clear();
+            this->found.clear();
+            this->intersection_points.clear();
+            this->surface_indices.clear();
+            this->leaf_indices.clear();
+        }
+    };
+
     /**
      * Struct for containing all information required to find intersections among other things
      */
@@ -52,12 +106,37 @@ namespace Invader::HEK {
          */
         bool check_for_intersection(const Point3D<LittleEndian> &point, float range, Point3D<LittleEndian> *intersection_point = nullptr, std::uint32_t *surface_index = nullptr, std::uint32_t *leaf_index = nullptr) const;
         
+        /**
+         * Determine if each point in a batch intersects vertically with the BSP. This gives the same results as calling check_for_intersection for each point.
+         * @param range range up-and-down to check
+         * @param batch batch to check; results are written to its output arrays, one entry per point
+         * @return      number of points that had an intersection
+         */
+        std::size_t check_for_intersections(float range, BSPIntersectionBatch &batch) const;
+        
         /**
          * Determine if a point lays inside of a BSP.
          * @param point      point to check
          * @param leaf_index if non-null and this function returns true, this will be set to the leaf index where the point is located
          */
         bool check_if_point_inside_bsp(const Point3D<LittleEndian> &point, std::uint32_t *leaf_index = nullptr) const;
+        
+        /**
+         * Build a grid over the BSP to speed up check_if_point_inside_bsp when checking a lot of points. The same leaves are found with or without it.
+         * @param cells_per_axis number of cells to split each axis of the BSP's bounding box into
+         */
+        void build_leaf_grid(std::uint32_t cells_per_axis = 32);
+        
+    private:
+        // Each cell holds the deepest node whose subtree contains the entire cell, so lookups can start there (or stop there if it's a leaf)
+        struct LeafGrid {
+            float minimum[3] = {};
+            float cell_size[3] = {};
+            std::uint32_t cells_per_axis = 0;
+            std::vector<FlaggedInt<std::uint32_t>> start_nodes;
+        } leaf_grid;
+        
+        bool check_for_intersection(std::vector<BSPIntersectionStackFrame> &stack, const Point3D<LittleEndian> &point, float range, Point3D<LittleEndian> &intersection_point, std::uint32_t &surface_index, std::uint32_t &leaf_index) const;
     };
 }
 #endif
@@ -23,8 +23,9 @@ namespace Invader::Parser {
      * @param warnings           array to hold warnings
      * @param tags_directories   tags directories in order of precedence
      * @param scripts            optional array of scripts (filename-data pairs). If not set, use source data from the scenario tag
+     * @param tags_index         optional index of the tags directories to find tags with instead of checking the filesystem
      */
-    void compile_scripts(Scenario &scenario, const HEK::GameEngineInfo &info, std::vector<std::string> &warnings, const std::vector<std::filesystem::path> &tags_directories, const std::optional<std::vector<std::pair<std::string, std::vector<std::byte>>>> &scripts = std::nullopt);
+    void compile_scripts(Scenario &scenario, const HEK::GameEngineInfo &info, std::vector<std::string> &warnings, const std::vector<std::filesystem::path> &tags_directories, const std::optional<std::vector<std::pair<std::string, std::vector<std::byte>>>> &scripts = std::nullopt, const File::TagDirectoryIndex *tags_index = nullptr);
 }
 
 #endif
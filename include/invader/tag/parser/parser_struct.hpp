@@ -10,6 +10,7 @@
 #include <optional>
 #include <variant>
 #include <memory>
+#include <type_traits>
 #include "../hek/definition.hpp"
 
 namespace Invader {
@@ -122,6 +123,32 @@ namespace Invader::Parser {
         }
     };
 
+    /**
+     * Function called for each dependency found when scanning a tag for dependencies. This only refers to the function (nothing is copied or
+     * allocated), so the function must outlive it.
+     */
+    class DependencyCallback {
+    public:
+        /**
+         * Call the function
+         * @param path       path of the dependency as stored in the tag (in Halo format; duplicate slashes are not removed)
+         * @param tag_fourcc class of the dependency
+         */
+        void operator()(const char *path, TagFourCC tag_fourcc) const {
+            this->call(this->function, path, tag_fourcc);
+        }
+
+        template<typename F> requires (!std::is_same_v<std::remove_cvref_t<F>, DependencyCallback>)
+        DependencyCallback(F &&function) noexcept : function(const_cast<void *>(static_cast<const void *>(&function))), call([](void *function, const char *path, TagFourCC tag_fourcc) {
+            (*static_cast<std::remove_reference_t<F> *>(function))(path, tag_fourcc);
+        }) {}
+        DependencyCallback(const DependencyCallback &) = default;
+
+    private:
+        void *function;
+        void (*call)(void *function, const char *path, TagFourCC tag_fourcc);
+    };
+
     class ParserStructValue {
     public:
         enum ValueType {
@@ -955,6 +982,14 @@ namespace Invader::Parser {
          */
         static std::unique_ptr<ParserStruct> parse_hek_tag_file(const std::byte *data, std::size_t data_size, bool postprocess = false);
 
+        /**
+         * Find all dependencies in the HEK tag file without parsing it. This reads far less than parse_hek_tag_file and does not allocate.
+         * @param data      Tag file data to read from
+         * @param data_size Size of the tag file
+         * @param callback  Called for each dependency that has a path
+         */
+        static void scan_hek_dependencies(const std::byte *data, std::size_t data_size, const DependencyCallback &callback);
+
         /**
          * Generate a tag base struct
          * @param  tag_class tag class
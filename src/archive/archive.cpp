@@ -212,6 +212,9 @@ int main(int argc, const char **argv) {
     // Fix this a bit
     File::halo_path_to_preferred_path_chars(base_tag.data());
     File::remove_duplicate_slashes_chars(base_tag.data());
+    
+    // Index the tags directories once, since everything here needs to find tags in them
+    File::TagDirectoryIndex tags_index(archive_options.tags);
 
     if(!archive_options.single_tag) {
         // Build the map
@@ -221,6 +224,7 @@ int main(int argc, const char **argv) {
             BuildWorkload::BuildParameters parameters(*archive_options.engine);
             parameters.scenario = base_tag;
             parameters.tags_directories = archive_options.tags;
+            parameters.tags_index = &tags_index;
             parameters.use_tags_for_script_data = true; // TODODILE: use data folder and implement tags/ and data/ split in output archive
             if(parameters.details.build_cache_file_engine == HEK::CacheFileEngine::CACHE_FILE_XBOX) {
                 parameters.details.build_compression_level = 0;
@@ -251,21 +255,15 @@ int main(int argc, const char **argv) {
         // Go through each tag and see if we can find everything.
         archive_list.reserve(tag_count + 64);
         
-        auto archive_it = [&archive_options, &archive_list](const std::string &path, TagFourCC fourcc) {
+        auto archive_it = [&tags_index, &archive_list](const std::string &path, TagFourCC fourcc) {
             std::string full_tag_path = File::halo_path_to_preferred_path(path) + "." + tag_fourcc_to_extension(fourcc);
 
-            // Check each tags directory if it exists. If so, archive it (todo: refactor to tag_path_to_file_path())
-            bool exists = false;
-            for(auto &dir : archive_options.tags) {
-                std::filesystem::path tag_path = std::filesystem::path(dir) / full_tag_path;
-                if(std::filesystem::exists(tag_path)) {
-                    exists = true;
-                    archive_list.emplace_back(tag_path.string(), full_tag_path);
-                    break;
-                }
+            // Find it in the tags directories. If it's there, archive it
+            auto tag_path = tags_index.find(full_tag_path);
+            if(tag_path.has_value()) {
+                archive_list.emplace_back(tag_path->string(), full_tag_path);
             }
-
-            if(!exists) {
+            else {
                 eprintf_error("Failed to find %s. Archive could not be made.", full_tag_path.c_str());
                 std::exit(EXIT_FAILURE);
             }
@@ -279,7 +277,7 @@ int main(int argc, const char **argv) {
         
         // Archive child scenarios
         try {
-            auto path = Invader::File::tag_path_to_file_path(base_tag + ".scenario", archive_options.tags);
+            auto path = tags_index.find(base_tag + ".scenario");
             auto scenario_data = Invader::File::open_file(path.value()).value();
             auto scenario_ptr = Invader::Parser::ParserStruct::parse_hek_tag_file(scenario_data.data(), scenario_data.size());
             auto &scenario = dynamic_cast<Invader::Parser::Scenario &>(*scenario_ptr);
@@ -305,17 +303,11 @@ int main(int argc, const char **argv) {
         }
 
         // Add it
-        bool exists = false;
-        for(auto &dir : archive_options.tags) {
-            std::filesystem::path tag_path = std::filesystem::path(dir) / base_tag.data();
-            if(std::filesystem::exists(tag_path)) {
-                exists = true;
-                archive_list.emplace_back(tag_path.string(), base_tag.data());
-                break;
-            }
+        auto tag_path = tags_index.find(base_tag.data());
+        if(tag_path.has_value()) {
+            archive_list.emplace_back(tag_path->string(), base_tag.data());
         }
-
-        if(!exists) {
+        else {
             eprintf_error("Failed to find %s. Archive could not be made.", base_tag.data());
             return EXIT_FAILURE;
         }
@@ -323,7 +315,7 @@ int main(int argc, const char **argv) {
         // Now find its dependencies
         bool success;
         auto &base_tag_split = base_tag_split_maybe.value();
-        auto dependencies = FoundTagDependency::find_dependencies(base_tag_split.path.c_str(), base_tag_split.fourcc, archive_options.tags, false, true, success);
+        auto dependencies = FoundTagDependency::find_dependencies(base_tag_split.path.c_str(), base_tag_split.fourcc, archive_options.tags, false, true, success, &tags_index);
         if(!success) {
             eprintf_error("Failed to find dependencies for %s. Archive could not be made.", base_tag.data());
             return EXIT_FAILURE;
@@ -5,6 +5,8 @@
 #include <vector>
 #include <cstring>
 #include <filesystem>
+#include <cstdlib>
+#include <new>
 
 #include <invader/build/build_workload.hpp>
 #include <invader/compress/compression.hpp>
@@ -14,6 +16,28 @@
 #include "../command_line_option.hpp"
 #include <invader/file/file.hpp>
 #include <invader/tag/index/index.hpp>
+#include <invader/build/build_profile.hpp>
+
+// Count allocations for --profile-allocations
+static bool count_allocations = false;
+
+void *operator new(std::size_t size) {
+    if(count_allocations) {
+        Invader::BuildProfile::count_allocation(size);
+    }
+    if(void *memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept {
+    std::free(memory);
+}
 
 static std::uint32_t read_str32(const char *err, const char *s) {
     // Make sure it starts with '0x'
@@ -76,6 +100,9 @@ int main(int argc, const char **argv) {
         bool do_not_auto_forge = false;
         bool use_anniverary_mode = false;
         bool use_tags_for_script_source = false;
+        std::optional<std::filesystem::path> profile;
+        bool profile_allocations = false;
+        std::size_t max_threads = 0;
     } build_options;
     
     const CommandLineOption options[] = {
@@ -101,7 +128,10 @@ int main(int argc, const char **argv) {
         CommandLineOption("anniversary-mode", 'a', 0, "Enable anniversary graphics and audio (CEA only)"),
         CommandLineOption("resource-maps", 'R', 1, "Specify the directory for loading resource maps. (by default this is the maps directory)", "<dir>"),
         CommandLineOption("tag-space", 'T', 1, "Override the tag space. This may result in a map that does not work with the stock games. You can specify the number of bytes, optionally suffixing with K (for KiB) or M (for MiB), or specify in hexadecimal the number of bytes (e.g. 0x1000).", "<size>"),
-        CommandLineOption("resource-usage", 'r', 1, "Specify the behavior for using resource maps. Must be: none (don't use resource maps), check (check resource maps), always (always index tags in resource maps - Custom Edition only). Default: none", "<usage>")
+        CommandLineOption("resource-usage", 'r', 1, "Specify the behavior for using resource maps. Must be: none (don't use resource maps), check (check resource maps), always (always index tags in resource maps - Custom Edition only). Default: none", "<usage>"),
+        CommandLineOption("profile", 'p', 1, "Record how long each stage of the build takes, writing it to a file as a Chrome trace (viewable in chrome://tracing or Perfetto) and showing a summary.", "<file>"),
+        CommandLineOption("profile-allocations", 'M', 0, "Also count allocations made in each stage when using --profile. This slows down the build."),
+        CommandLineOption("threads", 'j', 1, "Set the number of threads to use for placing encounters, command lists, and decals and for copying tag data. Default: CPU thread count", "<#>")
     };
 
     static constexpr char DESCRIPTION[] = "Build a cache file.";
@@ -127,6 +157,25 @@ int main(int argc, const char **argv) {
             case 'q':
                 build_options.quiet = true;
                 break;
+            case 'p':
+                build_options.profile = std::string(arguments[0]);
+                break;
+            case 'M':
+                build_options.profile_allocations = true;
+                break;
+            case 'j':
+                try {
+                    int threads = std::stoi(arguments[0]);
+                    if(threads < 1) {
+                        throw std::exception();
+                    }
+                    build_options.max_threads = static_cast<std::size_t>(threads);
+                }
+                catch(std::exception &) {
+                    eprintf_error("Invalid number of threads %s", arguments[0]);
+                    std::exit(EXIT_FAILURE);
+                }
+                break;
             case 'a':
                 build_options.use_anniverary_mode = true;
                 break;
@@ -356,9 +405,22 @@ int main(int argc, const char **argv) {
         parameters.scenario = scenario;
         parameters.rename_scenario = build_options.rename_scenario;
         parameters.optimize_space = build_options.optimize_space;
+        parameters.max_threads = build_options.max_threads;
         parameters.forge_crc = build_options.forged_crc;
         parameters.index = with_index;
         
+        // Profile?
+        std::optional<BuildProfile> profile;
+        if(build_options.profile.has_value()) {
+            profile.emplace();
+            parameters.profile = &*profile;
+            count_allocations = build_options.profile_allocations;
+        }
+        else if(build_options.profile_allocations) {
+            eprintf_error("--profile-allocations requires --profile");
+            return EXIT_FAILURE;
+        }
+        
         if(build_options.max_tag_space.has_value()) {
             parameters.details.build_maximum_tag_space = *build_options.max_tag_space;
         }
@@ -564,9 +626,6 @@ int main(int argc, const char **argv) {
             }
         }
 
-        // Build!
-        auto map = Invader::BuildWorkload::compile_map(parameters);
-        
         static const char MAP_EXTENSION[] = ".map"; 
         auto map_name_with_extension = std::string(map_name) + MAP_EXTENSION;
 
@@ -577,6 +636,28 @@ int main(int argc, const char **argv) {
         }
         else {
             final_file = *build_options.output;
+        }
+
+        // Build! The map is written to a temporary file as it's put together and only replaces the existing map once it's complete.
+        {
+            Invader::BuildWorkload::CacheFileFileSink sink(final_file);
+            Invader::BuildWorkload::compile_map(parameters, sink);
+            sink.finish();
+        }
+        
+        // Write the profile
+        if(profile.has_value()) {
+            count_allocations = false;
+            if(!profile->write_chrome_trace(*build_options.profile)) {
+                eprintf_error("Failed to save %s", build_options.profile->string().c_str());
+                return EXIT_FAILURE;
+            }
+            if(!build_options.quiet) {
+                oprintf("%s", profile->summary().c_str());
+            }
+        }
+        
+        if(build_options.output.has_value()) {
             auto final_file_name_no_extension = final_file.filename().replace_extension();
             auto final_file_name_no_extension_string = final_file_name_no_extension.string();
             
@@ -602,12 +683,6 @@ int main(int argc, const char **argv) {
                 }
             }
         }
-        
-        // Save the file
-        if(!File::save_file(final_file, map)) {
-            eprintf_error("Failed to save %s", final_file.string().c_str());
-            return EXIT_FAILURE;
-        }
 
         return EXIT_SUCCESS;
     }
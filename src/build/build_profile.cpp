@@ -0,0 +1,224 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <cstdio>
+#include <cinttypes>
+#include <algorithm>
+
+#include <invader/build/build_profile.hpp>
+
+namespace Invader {
+    // Allocations made on this thread (only counted if something calls count_allocation)
+    static thread_local std::uint64_t thread_allocations = 0;
+    static thread_local std::uint64_t thread_allocated_bytes = 0;
+
+    // Innermost stage on this thread
+    static thread_local BuildProfile::Scope *thread_scope = nullptr;
+
+    // Index of this thread in the profile it last recorded into
+    static thread_local const BuildProfile *thread_index_profile = nullptr;
+    static thread_local std::size_t thread_index = 0;
+
+    void BuildProfile::count_allocation(std::size_t size) noexcept {
+        thread_allocations++;
+        thread_allocated_bytes += size;
+    }
+
+    BuildProfile::BuildProfile() : start(std::chrono::steady_clock::now()) {
+        // Whichever thread starts the profile is the main thread
+        this->get_thread_index();
+    }
+
+    std::size_t BuildProfile::get_thread_index() {
+        if(thread_index_profile != this) {
+            thread_index_profile = this;
+            thread_index = this->thread_count++;
+        }
+        return thread_index;
+    }
+
+    BuildProfile::Scope::Scope(BuildProfile *profile, const char *category, const char *name) : profile(profile), category(category) {
+        if(!profile) {
+            return;
+        }
+        this->name = name ? name : category;
+        this->parent = thread_scope;
+        thread_scope = this;
+        this->allocations_start = thread_allocations;
+        this->allocated_bytes_start = thread_allocated_bytes;
+        this->start = std::chrono::steady_clock::now();
+    }
+
+    BuildProfile::Scope::~Scope() {
+        if(!this->profile) {
+            return;
+        }
+
+        auto end = std::chrono::steady_clock::now();
+        auto to_us = [](auto duration) {
+            return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+        };
+
+        Event event;
+        event.category = this->category;
+        event.name = std::move(this->name);
+        event.start = to_us(this->start - this->profile->start);
+        event.duration = to_us(end - this->start);
+        event.exclusive_duration = event.duration - std::min(event.duration, this->child_duration);
+
+        std::uint64_t allocations = thread_allocations - this->allocations_start;
+        std::uint64_t allocated_bytes = thread_allocated_bytes - this->allocated_bytes_start;
+        event.allocations = allocations - this->child_allocations;
+        event.allocated_bytes = allocated_bytes - this->child_allocated_bytes;
+        event.top_level = this->parent == nullptr;
+
+        // Let the parent know how much of its time and allocations were ours
+        thread_scope = this->parent;
+        if(this->parent) {
+            this->parent->child_duration += event.duration;
+            this->parent->child_allocations += allocations;
+            this->parent->child_allocated_bytes += allocated_bytes;
+        }
+
+        std::scoped_lock lock(this->profile->mutex);
+        event.thread = this->profile->get_thread_index();
+        this->profile->events.emplace_back(std::move(event));
+    }
+
+    void BuildProfile::add_counter(const char *name, std::uint64_t amount) {
+        std::scoped_lock lock(this->mutex);
+        this->counters[name] += amount;
+    }
+
+    std::vector<BuildProfile::Event> BuildProfile::get_events() const {
+        std::scoped_lock lock(this->mutex);
+        auto events = this->events;
+        std::stable_sort(events.begin(), events.end(), [](auto &a, auto &b) { return a.start < b.start; });
+        return events;
+    }
+
+    static void write_json_string(std::string &output, const char *string) {
+        output += '"';
+        for(const char *c = string; *c; c++) {
+            switch(*c) {
+                case '"':
+                    output += "\\\"";
+                    break;
+                case '\\':
+                    output += "\\\\";
+                    break;
+                default:
+                    if(static_cast<unsigned char>(*c) < 0x20) {
+                        char escaped[8];
+                        std::snprintf(escaped, sizeof(escaped), "\\u%04X", static_cast<unsigned char>(*c));
+                        output += escaped;
+                    }
+                    else {
+                        output += *c;
+                    }
+                    break;
+            }
+        }
+        output += '"';
+    }
+
+    bool BuildProfile::write_chrome_trace(const std::filesystem::path &path) const {
+        auto events = this->get_events();
+        std::uint64_t end = 0;
+
+        std::string output = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        char number[256];
+        bool first = true;
+        for(auto &e : events) {
+            if(!first) {
+                output += ",\n";
+            }
+            first = false;
+            output += "{\"name\":";
+            write_json_string(output, e.name.c_str());
+            output += ",\"cat\":";
+            write_json_string(output, e.category);
+            std::snprintf(number, sizeof(number), ",\"ph\":\"X\",\"pid\":1,\"tid\":%zu,\"ts\":%" PRIu64 ",\"dur\":%" PRIu64 ",\"args\":{\"allocations\":%" PRIu64 ",\"allocated_bytes\":%" PRIu64 "}}", e.thread, e.start, e.duration, e.allocations, e.allocated_bytes);
+            output += number;
+            end = std::max(end, e.start + e.duration);
+        }
+
+        // Put the counters at the end since they're totals
+        std::scoped_lock lock(this->mutex);
+        for(auto &c : this->counters) {
+            if(!first) {
+                output += ",\n";
+            }
+            first = false;
+            output += "{\"name\":";
+            write_json_string(output, c.first.c_str());
+            std::snprintf(number, sizeof(number), ",\"ph\":\"C\",\"pid\":1,\"ts\":%" PRIu64 ",\"args\":{\"value\":%" PRIu64 "}}", end, c.second);
+            output += number;
+        }
+        output += "\n]}\n";
+
+        std::FILE *f = std::fopen(path.string().c_str(), "wb");
+        if(!f) {
+            return false;
+        }
+        bool success = std::fwrite(output.data(), output.size(), 1, f) == 1;
+        return (std::fclose(f) == 0) && success;
+    }
+
+    std::string BuildProfile::summary() const {
+        auto events = this->get_events();
+        std::string output;
+        char line[512];
+
+        // Show the top-level stages of the main thread in order
+        output += "Stages:\n";
+        for(auto &e : events) {
+            if(e.top_level && e.thread == 0) {
+                std::snprintf(line, sizeof(line), "    %-28s %12.03f ms\n", e.name.c_str(), e.duration / 1000.0);
+                output += line;
+            }
+        }
+
+        // Add up the time spent in each category, not counting time spent in nested stages so nothing is counted twice
+        struct CategoryTotal {
+            std::size_t count = 0;
+            std::uint64_t duration = 0;
+            std::uint64_t allocations = 0;
+            std::uint64_t allocated_bytes = 0;
+        };
+        std::map<std::string, CategoryTotal> categories;
+        bool counted_allocations = false;
+        for(auto &e : events) {
+            auto &total = categories[e.category];
+            total.count++;
+            total.duration += e.exclusive_duration;
+            total.allocations += e.allocations;
+            total.allocated_bytes += e.allocated_bytes;
+            counted_allocations = counted_allocations || e.allocations > 0;
+        }
+
+        std::vector<std::pair<std::string, CategoryTotal>> sorted_categories(categories.begin(), categories.end());
+        std::stable_sort(sorted_categories.begin(), sorted_categories.end(), [](auto &a, auto &b) { return a.second.duration > b.second.duration; });
+
+        output += "Time by category (all threads):\n";
+        for(auto &c : sorted_categories) {
+            std::snprintf(line, sizeof(line), "    %-28s %12.03f ms %8zu stage%s", c.first.c_str(), c.second.duration / 1000.0, c.second.count, c.second.count == 1 ? " " : "s");
+            output += line;
+            if(counted_allocations) {
+                std::snprintf(line, sizeof(line), " %10" PRIu64 " allocations (%.02f MiB)", c.second.allocations, c.second.allocated_bytes / 1024.0 / 1024.0);
+                output += line;
+            }
+            output += "\n";
+        }
+
+        std::scoped_lock lock(this->mutex);
+        if(!this->counters.empty()) {
+            output += "Counters:\n";
+            for(auto &c : this->counters) {
+                std::snprintf(line, sizeof(line), "    %-28s %12" PRIu64 "\n", c.first.c_str(), c.second);
+                output += line;
+            }
+        }
+
+        return output;
+    }
+}
@@ -2,6 +2,7 @@
 
 #include <ctime>
 #include <cstdio>
+#include <thread>
 
 #include <invader/build/build_workload.hpp>
 #include <invader/hek/map.hpp>
@@ -45,13 +46,77 @@ namespace Invader {
         scenario(scenario),
         tags_directories(tags_directories),
         details(engine) {}
+    
+    std::size_t BuildWorkload::BuildParameters::get_thread_count() const noexcept {
+        return this->max_threads == 0 ? std::max(std::thread::hardware_concurrency(), 1U) : this->max_threads;
+    }
 
     #define TAG_DATA_HEADER_STRUCT (structs[0])
     #define TAG_ARRAY_STRUCT (structs[1])
 
     BuildWorkload::BuildWorkload() : ErrorHandler() {}
 
+    void BuildWorkload::CacheFileVectorSink::write(const std::byte *data, std::size_t size) {
+        this->data.insert(this->data.end(), data, data + size);
+    }
+    
+    BuildWorkload::CacheFileFileSink::CacheFileFileSink(const std::filesystem::path &path) : path(path) {}
+    
+    BuildWorkload::CacheFileFileSink::~CacheFileFileSink() {
+        // If we didn't finish, throw away what we wrote
+        if(this->file) {
+            std::fclose(this->file);
+            std::error_code ec;
+            std::filesystem::remove(this->temp_path, ec);
+        }
+    }
+    
+    void BuildWorkload::CacheFileFileSink::write(const std::byte *data, std::size_t size) {
+        // Open the file
+        if(!this->file) {
+            this->file = File::open_temp_file(this->path, this->temp_path);
+            if(!this->file) {
+                eprintf_error("Failed to open %s for writing", this->path.string().c_str());
+                throw FailedToOpenFileException();
+            }
+        }
+        
+        // Write if there is data to write
+        if(size > 0 && std::fwrite(data, size, 1, this->file) != 1) {
+            eprintf_error("Failed to write to %s", this->path.string().c_str());
+            throw FailedToOpenFileException();
+        }
+    }
+    
+    void BuildWorkload::CacheFileFileSink::finish() {
+        // Make sure the file exists even if nothing was written
+        this->write(nullptr, 0);
+        
+        // Buffered writes can still fail here, so check before replacing anything
+        auto *file = this->file;
+        this->file = nullptr;
+        std::error_code ec;
+        if(std::fclose(file) != 0) {
+            std::filesystem::remove(this->temp_path, ec);
+            eprintf_error("Failed to write to %s", this->path.string().c_str());
+            throw FailedToOpenFileException();
+        }
+        
+        std::filesystem::rename(this->temp_path, this->path, ec);
+        if(ec) {
+            std::filesystem::remove(this->temp_path, ec);
+            eprintf_error("Failed to write to %s", this->path.string().c_str());
+            throw FailedToOpenFileException();
+        }
+    }
+    
     std::vector<std::byte> BuildWorkload::compile_map(const BuildParameters &parameters) {
+        CacheFileVectorSink sink;
+        compile_map(parameters, sink);
+        return std::move(sink.data);
+    }
+    
+    void BuildWorkload::compile_map(const BuildParameters &parameters, CacheFileSink &sink) {
         BuildWorkload workload;
         workload.parameters = &parameters;
 
@@ -74,12 +139,29 @@ namespace Invader {
                 break;
         }
 
-        return workload.build_cache_file();
+        // Index the tags directories so we don't have to check the filesystem for every tag
+        if(parameters.tags_index) {
+            workload.tags_index = parameters.tags_index;
+        }
+        else {
+            BuildProfile::Scope scope(parameters.profile, "stage", "index tags directories");
+            workload.owned_tags_index = std::make_unique<File::TagDirectoryIndex>(parameters.tags_directories);
+            workload.tags_index = workload.owned_tags_index.get();
+        }
+
+        workload.build_cache_file(sink);
+    }
+    
+    std::optional<std::filesystem::path> BuildWorkload::find_tag_file(const std::string &tag_path) const {
+        if(this->tags_index) {
+            return this->tags_index->find(tag_path);
+        }
+        return File::tag_path_to_file_path(tag_path, this->parameters->tags_directories);
     }
 
     #define BYTES_TO_MiB(bytes) (bytes / 1024.0 / 1024.0)
 
-    std::vector<std::byte> BuildWorkload::build_cache_file() {
+    void BuildWorkload::build_cache_file(CacheFileSink &sink) {
         // Yay
         File::check_working_directory("./toolbeta.map");
         auto cache_version = this->parameters->details.build_cache_file_engine;
@@ -117,22 +199,31 @@ namespace Invader {
         TAG_DATA_HEADER_STRUCT.unsafe_to_dedupe = true;
         TAG_ARRAY_STRUCT.unsafe_to_dedupe = true;
 
+        auto *profile = this->parameters->profile;
+
         // Add all of the tags
         if(this->parameters->verbosity > BuildParameters::BuildVerbosity::BUILD_VERBOSITY_QUIET) {
             oprintf("Reading tags...\n");
         }
-        this->add_tags();
-        
-        // Check this stuff
-        this->check_hud_text_indices();
+        {
+            BuildProfile::Scope scope(profile, "stage", "add tags");
+            this->add_tags();
+            
+            // Check this stuff
+            this->check_hud_text_indices();
+        }
 
         // If we have resource maps to check, check them
         if(this->parameters->details.build_raw_data_handling != BuildParameters::BuildParametersDetails::RawDataHandling::RAW_DATA_HANDLING_RETAIN_ALL) {
+            BuildProfile::Scope scope(profile, "stage", "externalize tags");
             this->externalize_tags();
         }
 
         // Generate the tag array
-        this->generate_tag_array();
+        {
+            BuildProfile::Scope scope(profile, "stage", "generate tag array");
+            this->generate_tag_array();
+        }
 
         // Set the scenario tag thingy
         auto make_tag_data_header_struct = [](std::size_t scenario_index, auto &structs, auto size) {
@@ -175,11 +266,13 @@ namespace Invader {
         
         // Generate memes on Xbox
         if(cache_version == HEK::CacheFileEngine::CACHE_FILE_XBOX) {
+            BuildProfile::Scope scope(profile, "stage", "compress model vertices");
             this->generate_compressed_model_tag_array();
         }
 
         // Dedupe structs
         if(this->parameters->optimize_space) {
+            BuildProfile::Scope scope(profile, "stage", "dedupe structs");
             this->dedupe_structs();
         }
 
@@ -188,7 +281,11 @@ namespace Invader {
             oprintf("Building tag data...");
             oflush();
         }
-        std::size_t end_of_bsps = this->generate_tag_data();
+        std::size_t end_of_bsps;
+        {
+            BuildProfile::Scope scope(profile, "stage", "generate tag data");
+            end_of_bsps = this->generate_tag_data();
+        }
         if(this->parameters->verbosity > BuildParameters::BuildVerbosity::BUILD_VERBOSITY_QUIET) {
             oprintf(" done\n");
         }
@@ -229,7 +326,10 @@ namespace Invader {
             oprintf("Building raw data...");
             oflush();
         }
-        this->generate_bitmap_sound_data(end_of_bsps);
+        {
+            BuildProfile::Scope scope(profile, "stage", "generate raw data");
+            this->generate_bitmap_sound_data(end_of_bsps);
+        }
         if(this->parameters->verbosity > BuildParameters::BuildVerbosity::BUILD_VERBOSITY_QUIET) {
             oprintf(" done\n");
         }
@@ -245,8 +345,7 @@ namespace Invader {
         }
 
         auto &workload = *this;
-        auto generate_final_data = [&workload, &bsp_size_affects_tag_space, &bsp_size, &cache_version, &engine_target, &largest_bsp_size, &largest_bsp_count, &bsp_sizes, &max_size](auto &header) {
-            std::vector<std::byte> final_data;
+        auto generate_final_data = [&workload, &bsp_size_affects_tag_space, &bsp_size, &cache_version, &engine_target, &largest_bsp_size, &largest_bsp_count, &bsp_sizes, &max_size, &sink](auto &header) {
             std::strncpy(header.build.string, workload.parameters->details.build_version.c_str(), sizeof(header.build.string) - 1);
             header.engine = workload.parameters->details.build_cache_file_engine;
             header.map_type = *workload.cache_file_type;
@@ -256,67 +355,71 @@ namespace Invader {
                 oprintf("Building cache file data...");
                 oflush();
             }
-
-            // Add header stuff
-            final_data.resize(sizeof(HEK::CacheFileHeader));
+            
+            auto *profile = workload.parameters->profile;
+            std::optional<BuildProfile::Scope> stage_scope(std::in_place, profile, "stage", "lay out cache file");
+            
+            // Figure out where everything goes first so we can write it all out in one go afterwards. Start with the header.
+            std::size_t file_size = sizeof(HEK::CacheFileHeader);
+            
+            // Each piece of BSP data, in case we need to find anything in there
+            struct BSPPiece {
+                std::size_t offset;
+                const std::vector<std::byte> *data;
+            };
+            std::vector<BSPPiece> bsp_pieces;
             
             // Add each BSP data thing
             for(auto &b : workload.bsp_data) {
-                final_data.insert(final_data.end(), b.begin(), b.end());
+                bsp_pieces.emplace_back(BSPPiece { file_size, &b });
+                file_size += b.size();
             }
 
             // Go through each BSP and add that stuff
             if(cache_version != HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
                 for(std::size_t b = 0; b < workload.bsp_count; b++) {
-                    final_data.insert(final_data.end(), workload.map_data_structs[b + 1].begin(), workload.map_data_structs[b + 1].end());
+                    auto &bsp_data = workload.map_data_structs[b + 1];
+                    bsp_pieces.emplace_back(BSPPiece { file_size, &bsp_data });
+                    file_size += bsp_data.size();
                 }
             }
-            workload.map_data_structs.resize(1);
 
             // Now add all the raw data
-            final_data.insert(final_data.end(), workload.all_raw_data.begin(), workload.all_raw_data.end());
             auto raw_data_size = workload.all_raw_data.size();
-            workload.all_raw_data = std::vector<std::byte>();
+            file_size += raw_data_size;
             
             std::size_t model_data_size;
             std::size_t vertex_size;
             std::size_t model_offset;
             std::size_t tag_data_offset;
+            std::size_t index_size = workload.model_indices.size() * sizeof(*workload.model_indices.data());
             
             // If we're not on Xbox, we put the model data here
             if(cache_version != HEK::CacheFileEngine::CACHE_FILE_XBOX) {
-                // Let's get the model data there
-                model_offset = final_data.size() + REQUIRED_PADDING_32_BIT(final_data.size());
-                final_data.resize(model_offset, std::byte());
-                final_data.insert(final_data.end(), reinterpret_cast<std::byte *>(workload.uncompressed_model_vertices.data()), reinterpret_cast<std::byte *>(workload.uncompressed_model_vertices.data() + workload.uncompressed_model_vertices.size()));
-
-                // Now add model indices
+                // Let's get the model data there, followed by model indices
+                model_offset = file_size + REQUIRED_PADDING_32_BIT(file_size);
                 vertex_size = workload.uncompressed_model_vertices.size() * sizeof(*workload.uncompressed_model_vertices.data());
-                final_data.insert(final_data.end(), reinterpret_cast<std::byte *>(workload.model_indices.data()), reinterpret_cast<std::byte *>(workload.model_indices.data() + workload.model_indices.size()));
-                workload.uncompressed_model_vertices = decltype(workload.uncompressed_model_vertices)();
-                workload.model_indices = decltype(workload.model_indices)();
+                file_size = model_offset + vertex_size + index_size;
                 
-                tag_data_offset = final_data.size() + REQUIRED_PADDING_32_BIT(final_data.size());
+                tag_data_offset = file_size + REQUIRED_PADDING_32_BIT(file_size);
                 model_data_size = tag_data_offset - model_offset;
             }
             
             // If we ARE on Xbox, then we go straight to the tag data
             else {
                 vertex_size = workload.compressed_model_vertices.size() * sizeof(*workload.compressed_model_vertices.data());
-                model_data_size = vertex_size + workload.model_indices.size() * sizeof(*workload.model_indices.data());
+                model_data_size = vertex_size + index_size;
                 model_offset = 0;
-                tag_data_offset = final_data.size() + REQUIRED_PADDING_N_BYTES(final_data.size(), HEK::CacheFileXboxConstants::CACHE_FILE_XBOX_SECTOR_SIZE);
+                tag_data_offset = file_size + REQUIRED_PADDING_N_BYTES(file_size, HEK::CacheFileXboxConstants::CACHE_FILE_XBOX_SECTOR_SIZE);
             }
-            
-            // We're almost there
-            final_data.resize(tag_data_offset, std::byte());
 
             // Add tag data
-            std::size_t tag_data_size = workload.map_data_structs[0].size();
-            final_data.insert(final_data.end(), workload.map_data_structs[0].begin(), workload.map_data_structs[0].end());
+            auto &tag_data = workload.map_data_structs[0];
+            std::size_t tag_data_size = tag_data.size();
+            file_size = tag_data_offset + tag_data_size;
             auto part_count = workload.model_parts.size();
             if(cache_version == HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
-                auto &tag_data_struct = *reinterpret_cast<HEK::NativeCacheFileTagDataHeader *>(final_data.data() + tag_data_offset);
+                auto &tag_data_struct = *reinterpret_cast<HEK::NativeCacheFileTagDataHeader *>(tag_data.data());
                 tag_data_struct.tag_count = static_cast<std::uint32_t>(workload.tags.size());
                 tag_data_struct.tags_literal = CacheFileLiteral::CACHE_FILE_TAGS;
                 tag_data_struct.model_part_count = static_cast<std::uint32_t>(part_count);
@@ -326,14 +429,14 @@ namespace Invader {
                 tag_data_struct.raw_data_indices = workload.raw_data_indices_offset;
             }
             else if(cache_version == HEK::CacheFileEngine::CACHE_FILE_XBOX) {
-                auto &tag_data_struct = *reinterpret_cast<HEK::CacheFileTagDataHeaderXbox *>(final_data.data() + tag_data_offset);
+                auto &tag_data_struct = *reinterpret_cast<HEK::CacheFileTagDataHeaderXbox *>(tag_data.data());
                 tag_data_struct.tag_count = static_cast<std::uint32_t>(workload.tags.size());
                 tag_data_struct.tags_literal = CacheFileLiteral::CACHE_FILE_TAGS;
                 tag_data_struct.model_part_count = static_cast<std::uint32_t>(part_count);
                 tag_data_struct.model_part_count_again = static_cast<std::uint32_t>(part_count);
             }
             else {
-                auto &tag_data_struct = *reinterpret_cast<HEK::CacheFileTagDataHeaderPC *>(final_data.data() + tag_data_offset);
+                auto &tag_data_struct = *reinterpret_cast<HEK::CacheFileTagDataHeaderPC *>(tag_data.data());
                 tag_data_struct.tag_count = static_cast<std::uint32_t>(workload.tags.size());
                 tag_data_struct.tags_literal = CacheFileLiteral::CACHE_FILE_TAGS;
                 tag_data_struct.model_part_count = static_cast<std::uint32_t>(part_count);
@@ -349,12 +452,10 @@ namespace Invader {
             if(cache_version == HEK::CacheFileEngine::CACHE_FILE_DEMO) {
                 header.head_literal = CacheFileLiteral::CACHE_FILE_HEAD_DEMO;
                 header.foot_literal = CacheFileLiteral::CACHE_FILE_FOOT_DEMO;
-                *reinterpret_cast<HEK::CacheFileDemoHeader *>(final_data.data()) = *reinterpret_cast<HEK::CacheFileHeader *>(&header);
             }
             else {
                 header.head_literal = CacheFileLiteral::CACHE_FILE_HEAD;
                 header.foot_literal = CacheFileLiteral::CACHE_FILE_FOOT;
-                std::memcpy(final_data.data(), &header, sizeof(header));
             }
 
             if(workload.parameters->verbosity > BuildParameters::BuildVerbosity::BUILD_VERBOSITY_QUIET) {
@@ -362,12 +463,13 @@ namespace Invader {
             }
             
             // Resize to ye ol' sector
+            std::size_t end_padding = 0;
             if(cache_version == HEK::CacheFileEngine::CACHE_FILE_XBOX) {
-                final_data.insert(final_data.end(), REQUIRED_PADDING_N_BYTES(final_data.size(), HEK::CacheFileXboxConstants::CACHE_FILE_XBOX_SECTOR_SIZE), std::byte());
+                end_padding = REQUIRED_PADDING_N_BYTES(file_size, HEK::CacheFileXboxConstants::CACHE_FILE_XBOX_SECTOR_SIZE);
             }
 
             // Check to make sure we aren't too big
-            std::size_t uncompressed_size = final_data.size();
+            std::size_t uncompressed_size = file_size + end_padding;
             if(static_cast<std::uint64_t>(uncompressed_size) > max_size) {
                 REPORT_ERROR_PRINTF(workload, ERROR_TYPE_FATAL_ERROR, std::nullopt, "Map file exceeds maximum size for the target engine when uncompressed (%.04f MiB > %.04f MiB)", BYTES_TO_MiB(uncompressed_size), BYTES_TO_MiB(static_cast<std::size_t>(max_size)));
                 throw MaximumFileSizeException();
@@ -384,27 +486,94 @@ namespace Invader {
             }
 
             // Hold this here, of course
-            auto &tag_file_checksums = reinterpret_cast<HEK::CacheFileTagDataHeader *>(final_data.data() + tag_data_offset)->tag_file_checksums;
+            auto &tag_file_checksums = reinterpret_cast<HEK::CacheFileTagDataHeader *>(tag_data.data())->tag_file_checksums;
             tag_file_checksums = workload.tag_file_checksums;
             
             // If we can calculate the CRC32, do it
             std::uint32_t new_crc = 0;
             bool can_calculate_crc = cache_version != CacheFileEngine::CACHE_FILE_XBOX;
+            static const std::byte ZERO_PADDING[4] = {};
+            stage_scope.reset();
             
             if(can_calculate_crc) {
+                BuildProfile::Scope crc_scope(profile, "stage", "calculate crc32");
                 if(workload.parameters->verbosity > BuildParameters::BuildVerbosity::BUILD_VERBOSITY_QUIET) {
                     oprintf("Calculating CRC32...");
                     oflush();
                 }
                 
+                // Gather everything that gets checksummed; we already have all of it, so there's no need to put the map together first
+                std::vector<std::pair<const std::byte *, std::size_t>> crc_regions;
+                auto add_bsp_region = [&bsp_pieces](std::size_t offset, std::size_t size, auto &regions) {
+                    // The range may cross from one piece into the next since they're laid out one after another
+                    for(auto &p : bsp_pieces) {
+                        if(size == 0) {
+                            break;
+                        }
+                        std::size_t piece_end = p.offset + p.data->size();
+                        if(offset < p.offset || offset >= piece_end) {
+                            continue;
+                        }
+                        std::size_t amount = std::min(size, piece_end - offset);
+                        regions.emplace_back(p.data->data() + (offset - p.offset), amount);
+                        offset += amount;
+                        size -= amount;
+                    }
+                    if(size > 0) {
+                        throw OutOfBoundsException();
+                    }
+                };
+                
+                if(cache_version != HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
+                    auto &scenario_tag_struct = workload.structs[*workload.tags[workload.scenario_index].base_struct];
+                    auto &scenario_tag_data = *reinterpret_cast<Parser::Scenario::struct_little *>(scenario_tag_struct.data.data());
+                    std::size_t scenario_bsp_count = scenario_tag_data.structure_bsps.count.read();
+                    if(scenario_bsp_count > 0) {
+                        auto *scenario_tag_bsps = reinterpret_cast<Parser::ScenarioBSP::struct_little *>(tag_data.data() + *workload.structs[*scenario_tag_struct.resolve_pointer(&scenario_tag_data.structure_bsps.pointer)].offset);
+                        for(std::size_t b = 0; b < scenario_bsp_count; b++) {
+                            std::size_t start = scenario_tag_bsps[b].bsp_start.read();
+                            std::size_t size = scenario_tag_bsps[b].bsp_size.read();
+                            
+                            // If it's MCC, CRC32 the vertex data
+                            if(cache_version == HEK::CacheFileEngine::CACHE_FILE_MCC_CEA) {
+                                HEK::ScenarioStructureBSPCompiledHeaderCEA<HEK::LittleEndian> bsp_header;
+                                std::vector<std::pair<const std::byte *, std::size_t>> header_regions;
+                                add_bsp_region(start, sizeof(bsp_header), header_regions);
+                                auto *bsp_header_data = reinterpret_cast<std::byte *>(&bsp_header);
+                                for(auto &r : header_regions) {
+                                    std::memcpy(bsp_header_data, r.first, r.second);
+                                    bsp_header_data += r.second;
+                                }
+                                if(bsp_header.lightmap_vertex_size.read() > 0) {
+                                    add_bsp_region(bsp_header.lightmap_vertices.read(), bsp_header.lightmap_vertex_size.read(), crc_regions);
+                                }
+                            }
+                            
+                            add_bsp_region(start, size, crc_regions);
+                        }
+                    }
+                }
+                
+                // Now model data
+                crc_regions.emplace_back(reinterpret_cast<const std::byte *>(workload.uncompressed_model_vertices.data()), vertex_size);
+                crc_regions.emplace_back(reinterpret_cast<const std::byte *>(workload.model_indices.data()), index_size);
+                crc_regions.emplace_back(ZERO_PADDING, model_data_size - vertex_size - index_size);
+                
+                // Lastly, tag data
+                std::size_t tag_file_checksums_offset = reinterpret_cast<const std::byte *>(&tag_file_checksums) - tag_data.data();
+                for(auto &r : crc_regions) {
+                    tag_file_checksums_offset += r.second;
+                }
+                crc_regions.emplace_back(tag_data.data(), tag_data_size);
+                
                 // Calculate the CRC32 and/or forge one if we must
                 if(workload.parameters->forge_crc.has_value()) {
                     std::uint32_t checksum_delta = 0;
-                    new_crc = calculate_map_crc(final_data.data(), final_data.size(), &workload.parameters->forge_crc.value(), &checksum_delta);
+                    new_crc = calculate_map_crc(crc_regions, tag_file_checksums_offset, &workload.parameters->forge_crc.value(), &checksum_delta);
                     tag_file_checksums = checksum_delta;
                 }
                 else {
-                    new_crc = calculate_map_crc(final_data.data(), final_data.size());
+                    new_crc = calculate_map_crc(crc_regions, tag_file_checksums_offset);
                 }
                 
                 header.crc32 = new_crc;
@@ -417,27 +586,102 @@ namespace Invader {
             }
             
             // Set the file size
-            header.decompressed_file_size = final_data.size();
-
-            // Copy it again, this time with the new CRC32
+            header.decompressed_file_size = uncompressed_size;
+            
+            // If we're compressing, we need the whole thing in memory first
+            CacheFileVectorSink uncompressed_sink;
+            CacheFileSink &output = workload.parameters->details.build_compress ? uncompressed_sink : sink;
+            if(workload.parameters->details.build_compress) {
+                uncompressed_sink.data.reserve(uncompressed_size);
+            }
+            
+            stage_scope.emplace(profile, "stage", "write cache file");
+            auto write_padding = [&output](std::size_t size) {
+                static const std::byte ZEROS[HEK::CacheFileXboxConstants::CACHE_FILE_XBOX_SECTOR_SIZE] = {};
+                while(size > 0) {
+                    auto amount = std::min(size, sizeof(ZEROS));
+                    output.write(ZEROS, amount);
+                    size -= amount;
+                }
+            };
+            
+            // Write the header
+            alignas(HEK::CacheFileHeader) std::byte header_data[sizeof(HEK::CacheFileHeader)] = {};
             if(cache_version == HEK::CacheFileEngine::CACHE_FILE_DEMO) {
-                *reinterpret_cast<HEK::CacheFileDemoHeader *>(final_data.data()) = *reinterpret_cast<HEK::CacheFileHeader *>(&header);
+                *reinterpret_cast<HEK::CacheFileDemoHeader *>(header_data) = *reinterpret_cast<HEK::CacheFileHeader *>(&header);
             }
             else {
-                std::memcpy(final_data.data(), &header, sizeof(header));
+                std::memcpy(header_data, &header, sizeof(header));
+            }
+            output.write(header_data, sizeof(header_data));
+            std::size_t written = sizeof(header_data);
+            
+            // Then BSPs (freeing them as we go)
+            for(auto &b : workload.bsp_data) {
+                output.write(b.data(), b.size());
+                written += b.size();
+                b = std::vector<std::byte>();
+            }
+            if(cache_version != HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
+                for(std::size_t b = 0; b < workload.bsp_count; b++) {
+                    auto &bsp_data = workload.map_data_structs[b + 1];
+                    output.write(bsp_data.data(), bsp_data.size());
+                    written += bsp_data.size();
+                    bsp_data = std::vector<std::byte>();
+                }
+            }
+            workload.map_data_structs.resize(1);
+            
+            // Raw data
+            output.write(workload.all_raw_data.data(), raw_data_size);
+            written += raw_data_size;
+            workload.all_raw_data = std::vector<std::byte>();
+            
+            // Model data
+            if(cache_version != HEK::CacheFileEngine::CACHE_FILE_XBOX) {
+                write_padding(model_offset - written);
+                output.write(reinterpret_cast<const std::byte *>(workload.uncompressed_model_vertices.data()), vertex_size);
+                output.write(reinterpret_cast<const std::byte *>(workload.model_indices.data()), index_size);
+                written = model_offset + vertex_size + index_size;
+                workload.uncompressed_model_vertices = decltype(workload.uncompressed_model_vertices)();
+                workload.model_indices = decltype(workload.model_indices)();
             }
+            
+            // Tag data
+            write_padding(tag_data_offset - written);
+            output.write(tag_data.data(), tag_data_size);
+            write_padding(end_padding);
+            stage_scope.reset();
 
             // Compress if needed
+            std::size_t compressed_size = uncompressed_size;
             if(workload.parameters->details.build_compress) {
+                BuildProfile::Scope compress_scope(profile, "stage", "compress");
                 if(workload.parameters->verbosity > BuildParameters::BuildVerbosity::BUILD_VERBOSITY_QUIET) {
                     oprintf("Compressing...");
                     oflush();
                 }
-                final_data = Compression::compress_map_data(final_data.data(), final_data.size(), workload.parameters->details.build_compression_level.value_or(19));
+                auto compressed_data = Compression::compress_map_data(uncompressed_sink.data.data(), uncompressed_sink.data.size(), workload.parameters->details.build_compression_level.value_or(19));
+                uncompressed_sink.data = std::vector<std::byte>();
+                compressed_size = compressed_data.size();
+                sink.write(compressed_data.data(), compressed_size);
                 if(workload.parameters->verbosity > BuildParameters::BuildVerbosity::BUILD_VERBOSITY_QUIET) {
                     oprintf(" done\n");
                 }
             }
+            
+            if(profile) {
+                profile->add_counter("tags", workload.tags.size());
+                profile->add_counter("stubbed tags", workload.stubbed_tag_count);
+                profile->add_counter("structs", workload.structs.size());
+                profile->add_counter("tag data bytes", tag_data_size);
+                profile->add_counter("raw data bytes", raw_data_size);
+                profile->add_counter("model data bytes", model_data_size);
+                profile->add_counter("cache file bytes", uncompressed_size);
+                if(workload.parameters->details.build_compress) {
+                    profile->add_counter("compressed bytes", compressed_size);
+                }
+            }
 
             // Display the scenario name and information
             if(workload.parameters->verbosity > BuildParameters::BuildVerbosity::BUILD_VERBOSITY_QUIET) {
@@ -526,7 +770,6 @@ namespace Invader {
 
                 // If we compressed it, how small did we get it?
                 if(workload.parameters->details.build_compress) {
-                    std::size_t compressed_size = final_data.size();
                     oprintf("Compressed size:   %.02f MiB (%.02f %%)\n", BYTES_TO_MiB(compressed_size), 100.0 * compressed_size / uncompressed_size);
                 }
 
@@ -553,8 +796,6 @@ namespace Invader {
 
                 oprintf("\n");
             }
-
-            return final_data;
         };
 
         switch(this->parameters->details.build_cache_file_engine) {
@@ -567,16 +808,19 @@ namespace Invader {
                 std::snprintf(header.timestamp.string, sizeof(header.timestamp.string), "%04u-%02u-%02uT%02u:%02u:%02uZ", gmt->tm_year + 1900, gmt->tm_mon + 1, gmt->tm_mday, gmt->tm_hour, gmt->tm_min, gmt->tm_sec);
                 
                 // Done
-                return generate_final_data(header);
+                generate_final_data(header);
+                break;
             }
             case HEK::CacheFileEngine::CACHE_FILE_MCC_CEA: {
                 HEK::CacheFileHeaderCEA header = {};
                 header.flags = this->parameters->details.build_flags_cea;
-                return generate_final_data(header);
+                generate_final_data(header);
+                break;
             }
             default: {
                 HEK::CacheFileHeader header = {};
-                return generate_final_data(header);
+                generate_final_data(header);
+                break;
             }
         }
     }
@@ -844,8 +1088,7 @@ namespace Invader {
                 break;
             }
         }
-        
-        auto &tags_directories = this->parameters->tags_directories;
+
 
         // Find it
         char formatted_path[512];
@@ -854,9 +1097,7 @@ namespace Invader {
         Invader::File::halo_path_to_preferred_path_chars(formatted_path);
         
         // Only set the new path if it exists
-        if((new_path = Invader::File::tag_path_to_file_path(formatted_path, tags_directories)).has_value() && !std::filesystem::exists(*new_path)) {
-            new_path = std::nullopt;
-        }
+        new_path = this->find_tag_file(formatted_path);
 
         // If it wasn't found in the current array list, add it to the list and let's begin
         if(!found) {
@@ -882,14 +1123,23 @@ namespace Invader {
         }
 
         // Open it
-        auto tag_file = Invader::File::open_file(*new_path);
+        auto *profile = this->parameters->profile;
+        std::optional<std::vector<std::byte>> tag_file;
+        {
+            BuildProfile::Scope scope(profile, "read tag", formatted_path);
+            tag_file = Invader::File::open_file(*new_path);
+        }
         if(!tag_file.has_value()) {
             eprintf_error("Failed to open %s\n", formatted_path);
             throw FailedToOpenFileException();
         }
         auto &tag_file_data = *tag_file;
+        if(profile) {
+            profile->add_counter("tag file bytes", tag_file_data.size());
+        }
 
         try {
+            BuildProfile::Scope scope(profile, "compile tag", formatted_path);
             this->compile_tag_data_recursively(tag_file_data.data(), tag_file_data.size(), return_value, tag_fourcc);
         }
         catch(std::exception &e) {
@@ -1061,7 +1311,7 @@ namespace Invader {
         return workload;
     }
 
-    template <typename Tag, HEK::Pointer64 stub_address, bool native> static void do_generate_tag_array(std::size_t tag_count, std::vector<BuildWorkload::BuildWorkloadTag> &tags, std::vector<BuildWorkload::BuildWorkloadStruct> &structs) {
+    template <typename Tag, HEK::Pointer64 stub_address, bool native> static void do_generate_tag_array(std::size_t tag_count, std::vector<BuildWorkload::BuildWorkloadTag> &tags, std::pmr::vector<BuildWorkload::BuildWorkloadStruct> &structs) {
         TAG_ARRAY_STRUCT.data.resize(sizeof(Tag) * tag_count);
 
         // Reserve tag paths
@@ -1198,58 +1448,103 @@ namespace Invader {
         };
 
         auto &cache_version = this->parameters->details.build_cache_file_engine;
-
-        auto recursively_generate_data = [&structs, &tags, &pointers, &pointers_64_bit, &pointer_of_tag_path, &cache_version](std::vector<std::byte> &data, std::size_t struct_index, auto &recursively_generate_data) {
-            auto &s = structs[struct_index];
-
-            // Return the pointer thingy
-            if(s.offset.has_value()) {
-                return;
-            }
-
-            // Set the offset thingy
-            std::size_t offset = data.size();
-            s.offset = offset;
-            data.insert(data.end(), s.data.begin(), s.data.end());
-
-            // Get the pointers
-            for(auto &pointer : s.pointers) {
-                recursively_generate_data(data, pointer.struct_index, recursively_generate_data);
-                PointerInternal pointer_internal { pointer.offset + offset, pointer.struct_index, pointer.struct_data_offset };
+        auto thread_count = this->parameters->get_thread_count();
+
+        // Lay out a struct and everything it points to (depth-first, in pointer order, with each struct's tree padded to 32-bit) at the end of data
+        auto generate_data = [&structs, &tags, &pointers, &pointers_64_bit, &pointer_of_tag_path, &cache_version, &thread_count](std::vector<std::byte> &data, std::size_t struct_index) {
+            // First, figure out where everything goes without copying anything
+            struct LayoutFrame {
+                std::size_t struct_index;
+                std::size_t next_pointer;
+            };
+            std::vector<LayoutFrame> stack;
+            std::vector<std::size_t> laid_out;
+            std::size_t data_size = data.size();
+            
+            auto lay_out = [&structs, &stack, &laid_out, &data_size](std::size_t struct_index) {
+                auto &s = structs[struct_index];
+                if(s.offset.has_value()) {
+                    return;
+                }
+                s.offset = data_size;
+                data_size += s.data.size();
+                laid_out.emplace_back(struct_index);
+                stack.emplace_back(LayoutFrame { struct_index, 0 });
+            };
+            
+            lay_out(struct_index);
+            while(!stack.empty()) {
+                auto &frame = stack.back();
+                auto &s = structs[frame.struct_index];
+                
+                // Once we've gone through all of the pointers, pad it
+                if(frame.next_pointer == s.pointers.size()) {
+                    data_size += REQUIRED_PADDING_32_BIT(data_size);
+                    stack.pop_back();
+                    continue;
+                }
+                
+                auto &pointer = s.pointers[frame.next_pointer++];
+                PointerInternal pointer_internal { pointer.offset + *s.offset, pointer.struct_index, pointer.struct_data_offset };
                 if(cache_version != HEK::CacheFileEngine::CACHE_FILE_NATIVE || pointer.limit_to_32_bits) {
                     pointers.emplace_back(pointer_internal);
                 }
                 else {
                     pointers_64_bit.emplace_back(pointer_internal);
                 }
+                lay_out(pointer.struct_index); // this may invalidate frame
             }
-
-            // Get the pointers
-            for(auto &dependency : s.dependencies) {
-                auto tag_index = dependency.tag_index;
-                std::uint32_t full_id = static_cast<std::uint32_t>((tag_index + 0x6174) | 0x8000) << 16 | static_cast<std::uint16_t>(tag_index); // salt = (0x6174 'at' | 0x8000) + index
-                HEK::TagID new_tag_id = { full_id };
-
-                if(dependency.tag_id_only) {
-                    *reinterpret_cast<HEK::LittleEndian<HEK::TagID> *>(data.data() + offset + dependency.offset) = new_tag_id;
-                }
-                else {
-                    auto &dependency_struct = *reinterpret_cast<HEK::TagDependency<HEK::LittleEndian> *>(data.data() + offset + dependency.offset);
-                    dependency_struct.tag_fourcc = tags[tag_index].tag_fourcc;
-                    dependency_struct.tag_id = new_tag_id;
-                    if(cache_version != HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
-                        dependency_struct.path_pointer = pointer_of_tag_path(tag_index);
+            
+            // Next, allocate it all at once and copy everything in
+            data.resize(data_size);
+            auto copy_structs = [&structs, &tags, &pointer_of_tag_path, &cache_version, &laid_out, &data](std::size_t first, std::size_t end) {
+                for(std::size_t l = first; l < end; l++) {
+                    auto &s = structs[laid_out[l]];
+                    std::size_t offset = *s.offset;
+                    std::copy(s.data.begin(), s.data.end(), data.begin() + offset);
+                    
+                    // Get the pointers
+                    for(auto &dependency : s.dependencies) {
+                        auto tag_index = dependency.tag_index;
+                        std::uint32_t full_id = static_cast<std::uint32_t>((tag_index + 0x6174) | 0x8000) << 16 | static_cast<std::uint16_t>(tag_index); // salt = (0x6174 'at' | 0x8000) + index
+                        HEK::TagID new_tag_id = { full_id };
+                        
+                        if(dependency.tag_id_only) {
+                            *reinterpret_cast<HEK::LittleEndian<HEK::TagID> *>(data.data() + offset + dependency.offset) = new_tag_id;
+                        }
+                        else {
+                            auto &dependency_struct = *reinterpret_cast<HEK::TagDependency<HEK::LittleEndian> *>(data.data() + offset + dependency.offset);
+                            dependency_struct.tag_fourcc = tags[tag_index].tag_fourcc;
+                            dependency_struct.tag_id = new_tag_id;
+                            if(cache_version != HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
+                                dependency_struct.path_pointer = pointer_of_tag_path(tag_index);
+                            }
+                        }
                     }
                 }
+            };
+            
+            // Each struct only touches its own bytes, so split it up across threads if there's enough to copy
+            std::size_t struct_count = laid_out.size();
+            if(thread_count == 1 || struct_count < 4096) {
+                copy_structs(0, struct_count);
+            }
+            else {
+                std::vector<std::thread> threads;
+                std::size_t structs_per_thread = (struct_count + thread_count - 1) / thread_count;
+                for(std::size_t first = structs_per_thread; first < struct_count; first += structs_per_thread) {
+                    threads.emplace_back(copy_structs, first, std::min(first + structs_per_thread, struct_count));
+                }
+                copy_structs(0, std::min(structs_per_thread, struct_count));
+                for(auto &t : threads) {
+                    t.join();
+                }
             }
-
-            // Append stuff
-            data.insert(data.end(), REQUIRED_PADDING_32_BIT(data.size()), std::byte());
         };
 
         // Build the tag data for the main tag data
         auto &tag_data_struct = this->map_data_structs.emplace_back();
-        recursively_generate_data(tag_data_struct, 0, recursively_generate_data);
+        generate_data(tag_data_struct, 0);
         auto *tag_data_b = tag_data_struct.data();
 
         // Adjust the pointers
@@ -1299,7 +1594,7 @@ namespace Invader {
                     pointers.clear();
                     pointers_64_bit.clear();
                     auto &bsp_data_struct = this->map_data_structs.emplace_back();
-                    recursively_generate_data(bsp_data_struct, base_struct, recursively_generate_data);
+                    generate_data(bsp_data_struct, base_struct);
                     
                     std::size_t bsp_size = bsp_data_struct.size();
                     
@@ -2350,8 +2645,10 @@ namespace Invader {
         auto &vertices_data_struct = this->structs[vertices_data_struct_index];
         
         // Add an entry for each part
-        auto *indices_array_data = reinterpret_cast<HEK::CacheFileModelPartIndicesXbox *>((indices_array_struct.data = std::vector<std::byte>(part_count * sizeof(HEK::CacheFileModelPartIndicesXbox))).data());
-        auto *vertices_array_data = reinterpret_cast<HEK::CacheFileModelPartVerticesXbox *>((vertices_array_struct.data = std::vector<std::byte>(part_count * sizeof(HEK::CacheFileModelPartVerticesXbox))).data());
+        indices_array_struct.data.assign(part_count * sizeof(HEK::CacheFileModelPartIndicesXbox), std::byte());
+        vertices_array_struct.data.assign(part_count * sizeof(HEK::CacheFileModelPartVerticesXbox), std::byte());
+        auto *indices_array_data = reinterpret_cast<HEK::CacheFileModelPartIndicesXbox *>(indices_array_struct.data.data());
+        auto *vertices_array_data = reinterpret_cast<HEK::CacheFileModelPartVerticesXbox *>(vertices_array_struct.data.data());
         
         // Fill it up with the vertices/indices
         auto *indices_data = this->model_indices.data();
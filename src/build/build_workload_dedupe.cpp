@@ -11,7 +11,7 @@ namespace Invader {
         
         // Make sure dependencies match
         if(this->dependencies != other.dependencies) {
-            std::vector<BuildWorkloadDependency> this_dep_small;
+            std::pmr::vector<BuildWorkloadDependency> this_dep_small;
             for(auto &td : this->dependencies) {
                 if(td.offset < other_size) {
                     if(td.offset + sizeof(HEK::TagDependency<HEK::LittleEndian>) > other_size) { // other struct only contains part of the dependency
@@ -27,7 +27,7 @@ namespace Invader {
         
         // And now pointers
         if(this->pointers != other.pointers) {
-            std::vector<BuildWorkloadStructPointer> this_ptr_small;
+            std::pmr::vector<BuildWorkloadStructPointer> this_ptr_small;
             for(auto &ptr : this->pointers) {
                 if(ptr.offset < other_size) {
                     this_ptr_small.emplace_back(ptr);
@@ -44,6 +44,7 @@ namespace Invader {
     void BuildWorkload::dedupe_structs() {
         bool found_something = true;
         std::size_t total_savings = 0;
+        std::size_t total_hits = 0;
         std::size_t struct_count = this->structs.size();
 
         oprintf("Optimizing tag space...");
@@ -83,6 +84,7 @@ namespace Invader {
                         }
 
                         total_savings += this->structs[j].data.size();
+                        total_hits++;
                         this->structs[j].unsafe_to_dedupe = true;
 
                         found_something = true;
@@ -91,5 +93,10 @@ namespace Invader {
             }
         }
         oprintf(" done; reduced tag space usage by %.02f MiB\n", total_savings / 1024.0 / 1024.0);
+        
+        if(auto *profile = this->parameters->profile) {
+            profile->add_counter("dedupe hits", total_hits);
+            profile->add_counter("dedupe bytes saved", total_savings);
+        }
     }
 }
@@ -7,6 +7,7 @@ endif()
 if(${INVADER_COMPARE})
     add_executable(invader-compare
         src/compare/compare.cpp
+        src/compare/compare_cache.cpp
     )
 
     target_link_libraries(invader-compare invader ${INVADER_CRT_NOGLOB})
@@ -2,9 +2,13 @@
 
 #include <thread>
 #include <mutex>
+#include <future>
+#include <atomic>
 #include <vector>
 #include <cstring>
 #include <regex>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <invader/map/map.hpp>
 #include <invader/resource/resource_map.hpp>
@@ -12,9 +16,11 @@
 #include <invader/version.hpp>
 #include <invader/printf.hpp>
 #include <invader/file/file.hpp>
+#include <invader/crc/hash.hpp>
 #include <invader/tag/parser/parser.hpp>
 #include <invader/extract/extraction.hpp>
 #include "../command_line_option.hpp"
+#include "compare_cache.hpp"
 
 using namespace Invader;
 
@@ -24,6 +30,12 @@ enum Show : std::uint8_t {
     SHOW_ALL = 0xFF
 };
 
+struct TagFilePathHash {
+    std::size_t operator()(const File::TagFilePath &path) const noexcept {
+        return std::hash<std::string>()(path.path) ^ (static_cast<std::size_t>(path.fourcc) * 0x9E3779B97F4A7C15ULL);
+    }
+};
+
 struct Input {
     std::optional<std::filesystem::path> map;
     std::optional<std::filesystem::path> maps;
@@ -33,6 +45,11 @@ struct Input {
     std::vector<File::TagFilePath> tag_paths;
     std::vector<File::TagFile> virtual_directory;
     std::unique_ptr<Map> map_data;
+    
+    // Path of every tag in the map (by tag index) or the virtual directory (by index), and where to find them by path and by class (in order)
+    std::vector<File::TagFilePath> entry_paths;
+    std::unordered_map<File::TagFilePath, std::vector<std::size_t>, TagFilePathHash> entries_by_path;
+    std::unordered_map<TagFourCC, std::vector<std::size_t>> entries_by_fourcc;
 };
 
 template <typename T> static void close_input(T &options) {
@@ -49,7 +66,7 @@ enum ByPath {
     BY_PATH_DIFFERENT = 2
 };
 
-static void regular_comparison(const std::vector<Input> &inputs, bool precision, Show show, bool match_all, bool functional, ByPath by_path, bool verbose, std::size_t job_count);
+static void regular_comparison(const std::vector<Input> &inputs, bool precision, Show show, bool match_all, bool functional, ByPath by_path, bool verbose, std::size_t job_count, const std::optional<std::filesystem::path> &cache_directory);
 
 int main(int argc, const char **argv) {
     set_up_color_term();
@@ -66,7 +83,8 @@ int main(int argc, const char **argv) {
         bool verbose = false;
         ByPath by_path = ByPath::BY_PATH_SAME;
         Show show = Show::SHOW_ALL;
-        std::optional<std::size_t> job_count;
+        std::size_t job_count = std::thread::hardware_concurrency() < 1 ? 1 : std::thread::hardware_concurrency();
+        std::optional<std::filesystem::path> cache_directory;
         std::vector<std::string> search;
         std::vector<std::string> search_exclude;
     } compare_options;
@@ -78,7 +96,7 @@ int main(int argc, const char **argv) {
         CommandLineOption("maps", 'm', 1, "Add a maps directory to the input to specify where to find resource files for a map. This option must be used after --input."),
         CommandLineOption("map", 'M', 1, "Add a map to the input. Only one map can be specified per input. If a maps directory isn't specified, then the map's directory will be used. This option must be used after --input."),
         CommandLineOption("precision", 'p', 0, "Allow for slight differences in floats to account for precision loss."),
-        CommandLineOption("functional", 'f', 0, "Precompile the tags before comparison to check for only functional differences."),
+        CommandLineOption("functional", 'f', 0, "Precompile the tags before comparison to check for only functional differences. Precompiled tags are matched by their 64-bit FNV-1a hashes rather than byte-by-byte, so tags whose hashes collide would be reported as matching."),
         CommandLineOption("search", 's', 1, "Search for tags (* and ? are wildcards) and compare these. Use multiple times for multiple queries. If unspecified, all tags will be compared.", "<expr>"),
         CommandLineOption("search-exclude", 'e', 1, "Search for tags (* and ? are wildcards) and ignore these. Use multiple times for multiple queries. This takes precedence over --search.", "<expr>"),
         CommandLineOption("by-path", 'B', 1, "Set what tags get compared against other tags. By default, only tags with the same relative path are checked. Using \"any\" ignores paths completely (useful for finding duplicates when both inputs are different) while \"different\" only checks tags with different paths (useful for finding duplicates when both inputs are the same). Can be: any, different, or same (default)", "<path-type>"),
@@ -86,7 +104,8 @@ int main(int argc, const char **argv) {
         CommandLineOption("ignore-resources", 'G', 0, "Ignore resource maps for the current map input. This option must be used after --input."),
         CommandLineOption("verbose", 'v', 0, "Output more information on the differences between tags to standard output. This will not work with --functional."),
         CommandLineOption("all", 'a', 0, "Only match if tags are in all inputs."),
-        CommandLineOption("threads", 'j', 1, "Set the number of threads to use for comparison. Default: 1")
+        CommandLineOption("threads", 'j', 1, "Set the number of threads to use for comparison. Default: CPU thread count"),
+        CommandLineOption("cache", 'K', 1, "Cache functionally compiled tags in this directory so identical tags do not need to be compiled again on later runs. This only applies to --functional.", "<dir>")
     };
     
     static constexpr char DESCRIPTION[] = "Compare tags against other tags.";
@@ -119,7 +138,11 @@ int main(int argc, const char **argv) {
 
             case 'j':
                 try {
-                    compare_options.job_count = std::stoul(args[0]);
+                    int threads = std::stoi(args[0]);
+                    if(threads < 1) {
+                        throw std::exception();
+                    }
+                    compare_options.job_count = static_cast<std::size_t>(threads);
                 }
                 catch(std::exception &) {
                     eprintf_error("Invalid number of threads %s\n", args[0]);
@@ -143,6 +166,10 @@ int main(int argc, const char **argv) {
                 }
                 break;
                 
+            case 'K':
+                compare_options.cache_directory = args[0];
+                break;
+                
             case 'I':
                 close_input(compare_options);
                 compare_options.top_input = &compare_options.inputs.emplace_back();
@@ -240,11 +267,6 @@ int main(int argc, const char **argv) {
         return EXIT_FAILURE;
     }
     
-    // Default 0 to 1
-    if(!compare_options.job_count.has_value()) {
-        compare_options.job_count = 1;
-    }
-    
     // Can we close it?
     close_input(compare_options);
     
@@ -311,9 +333,11 @@ int main(int argc, const char **argv) {
             // Go through each tag and add them if we want to do the thing
             auto tag_count = map.get_tag_count();
             i.tag_paths.reserve(tag_count);
+            i.entry_paths.reserve(tag_count);
             for(std::size_t t = 0; t < tag_count; t++) {
                 auto &tag = map.get_tag(t);
                 auto tag_fourcc = tag.get_tag_fourcc();
+                i.entry_paths.emplace_back(tag.get_path(), tag_fourcc);
                 if(!tag.data_is_available() || std::strcmp(tag_fourcc_to_extension(tag_fourcc), "unknown") == 0) {
                     continue;
                 }
@@ -329,42 +353,71 @@ int main(int argc, const char **argv) {
                 return EXIT_FAILURE;
             }
             i.tag_paths.reserve(i.virtual_directory.size());
+            i.entry_paths.reserve(i.virtual_directory.size());
             for(auto &t : i.virtual_directory) {
-                add_if_matched(File::split_tag_class_extension(File::preferred_path_to_halo_path(t.tag_path)).value());
+                auto &path = i.entry_paths.emplace_back(File::split_tag_class_extension(File::preferred_path_to_halo_path(t.tag_path)).value());
+                add_if_matched(File::TagFilePath(path));
             }
         }
         i.tag_paths.shrink_to_fit();
+        
+        // Index everything so we don't have to go through every tag to find each one
+        for(std::size_t e = 0; e < i.entry_paths.size(); e++) {
+            i.entries_by_path[i.entry_paths[e]].push_back(e);
+            i.entries_by_fourcc[i.entry_paths[e].fourcc].push_back(e);
+        }
     }
     
-    regular_comparison(compare_options.inputs, compare_options.precision, compare_options.show, compare_options.match_all, compare_options.functional, compare_options.by_path, compare_options.verbose, *compare_options.job_count);
+    regular_comparison(compare_options.inputs, compare_options.precision, compare_options.show, compare_options.match_all, compare_options.functional, compare_options.by_path, compare_options.verbose, compare_options.job_count, compare_options.cache_directory);
 }
 
-static void regular_comparison(const std::vector<Input> &inputs, bool precision, Show show, bool match_all, bool functional, ByPath by_path, bool verbose, std::size_t job_count) {
+static void regular_comparison(const std::vector<Input> &inputs, bool precision, Show show, bool match_all, bool functional, ByPath by_path, bool verbose, std::size_t job_count, const std::optional<std::filesystem::path> &cache_directory) {
     // Find all tags we have in common first
     auto input_count = inputs.size();
     std::vector<File::TagFilePath> tags;
     
     #define CAN_COMPARE(by_path, path1, path2) ((by_path == ByPath::BY_PATH_SAME && path1 == path2) || (by_path == ByPath::BY_PATH_DIFFERENT && path1 != path2) || (by_path == ByPath::BY_PATH_ANY))
     
+    // Count each path and class for each input so we can check if an input has something to compare a tag with without going through all of its tags
+    struct TagPathCounts {
+        std::unordered_map<File::TagFilePath, std::size_t, TagFilePathHash> paths;
+        std::unordered_map<TagFourCC, std::size_t> fourccs;
+    };
+    std::vector<TagPathCounts> counts(input_count);
+    for(std::size_t i = 0; i < input_count; i++) {
+        for(auto &tag : inputs[i].tag_paths) {
+            counts[i].paths[tag]++;
+            counts[i].fourccs[tag.fourcc]++;
+        }
+    }
+    
+    auto has_tag_to_compare = [&by_path](const TagPathCounts &counts, const File::TagFilePath &tag) -> bool {
+        switch(by_path) {
+            case ByPath::BY_PATH_SAME:
+                return counts.paths.contains(tag);
+            case ByPath::BY_PATH_ANY:
+                return counts.fourccs.contains(tag.fourcc);
+            case ByPath::BY_PATH_DIFFERENT: {
+                // There has to be at least one tag of this class that isn't at this path
+                auto fourcc_count = counts.fourccs.find(tag.fourcc);
+                if(fourcc_count == counts.fourccs.end()) {
+                    return false;
+                }
+                auto path_count = counts.paths.find(tag);
+                return fourcc_count->second > (path_count == counts.paths.end() ? 0 : path_count->second);
+            }
+        }
+        std::terminate();
+    };
+    
     // Do this thing
     if(match_all) {
         auto &first_input = inputs[0];
-        auto input_count = inputs.size();
         tags.reserve(first_input.tag_paths.size());
         for(auto &tag : first_input.tag_paths) {
             bool not_found = false;
             for(std::size_t i = 1; i < input_count; i++) {
-                bool found = false;
-                for(auto &tag2 : inputs[i].tag_paths) {
-                    if(tag2.fourcc != tag.fourcc) {
-                        continue;
-                    }
-                    if(CAN_COMPARE(by_path, tag.path, tag2.path)) {
-                        found = true;
-                        break;
-                    }
-                }
-                if(!found) {
+                if(!has_tag_to_compare(counts[i], tag)) {
                     not_found = true;
                     break;
                 }
@@ -376,33 +429,15 @@ static void regular_comparison(const std::vector<Input> &inputs, bool precision,
         }
     }
     else {
+        std::unordered_set<File::TagFilePath, TagFilePathHash> tags_added;
         for(std::size_t i = 0; i < input_count; i++) {
             auto &input = inputs[i];
             for(std::size_t j = i + 1; j < input_count; j++) {
-                auto &input2 = inputs[j];
                 for(auto &tag : input.tag_paths) {
-                    // Make sure we don't add any duplicates
-                    bool found = false;
-                    for(auto &otag : tags) {
-                        if(otag == tag) {
-                            found = true;
-                            break;
-                        }
-                    }
-                    if(found) {
-                        continue;
-                    }
-                    
-                    // Add it if it's present!
-                    for(auto &tag2 : input2.tag_paths) {
-                        if(tag2.fourcc != tag.fourcc) {
-                            continue;
-                        }
-                        if(CAN_COMPARE(by_path, tag.path, tag2.path)) {
-                            found = true;
-                            tags.push_back(tag);
-                            break;
-                        }
+                    // Make sure we don't add any duplicates, then add it if it's present!
+                    if(!tags_added.contains(tag) && has_tag_to_compare(counts[j], tag)) {
+                        tags_added.insert(tag);
+                        tags.push_back(tag);
                     }
                 }
             }
@@ -414,8 +449,12 @@ static void regular_comparison(const std::vector<Input> &inputs, bool precision,
     bool show_all = (show & Show::SHOW_ALL) == Show::SHOW_ALL;
     
     // Next, compare each tag
-    std::size_t matched_count = 0;
-    std::size_t mismatched_count = 0;
+    std::atomic<std::size_t> matched_count = 0;
+    std::atomic<std::size_t> mismatched_count = 0;
+    
+    // Hashes of functionally compiled tags so each one is only compiled once, including ones still being compiled by another thread
+    std::unordered_map<std::uint64_t, std::shared_future<std::uint64_t>> functional_hashes;
+    std::mutex functional_mutex;
     
     std::mutex tag_mutex;
     std::mutex log_mutex;
@@ -424,7 +463,7 @@ static void regular_comparison(const std::vector<Input> &inputs, bool precision,
     std::vector<std::thread> threads;
     threads.reserve(job_count);
     for(std::size_t t = 0; t < job_count; t++) {
-        auto perform_comparison_thread = [](auto *inputs, auto *tags, auto by_path, auto show_all, auto show, auto *matched_count, auto *mismatched_count, auto functional, auto precision, auto verbose, auto *tag_mutex, auto *tag_index, auto *log_mutex) {
+        auto perform_comparison_thread = [](auto *inputs, auto *tags, auto by_path, auto show_all, auto show, auto *matched_count, auto *mismatched_count, auto functional, auto precision, auto verbose, auto *tag_mutex, auto *tag_index, auto *log_mutex, auto *functional_hashes, auto *functional_mutex, auto *cache_directory) {
             reset_loop: while(true) {
                 tag_mutex->lock();
                 if(*tag_index >= tags->size()) {
@@ -435,13 +474,17 @@ static void regular_comparison(const std::vector<Input> &inputs, bool precision,
                 (*tag_index)++;
                 tag_mutex->unlock();
                 
-                std::vector<std::unique_ptr<Parser::ParserStruct>> structs;
-                std::vector<std::string> struct_paths;
-                std::vector<const Input *> struct_inputs;
+                // Each tag found to compare, along with a hash of its data so identical tags don't need to be parsed
+                struct FoundTag {
+                    std::vector<std::byte> data;
+                    std::uint64_t hash;
+                    std::string path;
+                    const Input *input;
+                };
+                std::vector<FoundTag> found_tags;
                 
                 bool first_input = true;
                 bool only_finding_same_tag = true;
-                auto path_unsplit = File::halo_path_to_preferred_path(tag.path + "." + HEK::tag_fourcc_to_extension(tag.fourcc)); // combine this
                 
                 try {
                     // Go through each input
@@ -456,67 +499,67 @@ static void regular_comparison(const std::vector<Input> &inputs, bool precision,
                         
                         only_finding_same_tag = by_path_copy == ByPath::BY_PATH_SAME;
                         
-                        // If it's a map, do this
-                        if(i.map.has_value()) {
-                            // First, extract it
-                            auto tag_count = i.map_data->get_tag_count();
-                            for(std::size_t t = 0; t < tag_count; t++) {
-                                auto &map_tag = i.map_data->get_tag(t);
-                                auto &map_tag_path = map_tag.get_path();
-                                if(map_tag.get_tag_fourcc() == tag.fourcc && CAN_COMPARE(by_path_copy, tag.path, map_tag_path)) {
-                                    // Lock the lock mutex in case issues arise when extracting the tag. This may slow down throughput a bit, but it's better than clobbering standard error while other stuff is logging.
-                                    log_mutex->lock();
-                                    
-                                    bool successful = false;
-                                    try {
-                                        auto extracted_data = Invader::ExtractionWorkload::extract_single_tag(i.map_data->get_tag(t));
-                                        structs.emplace_back(Parser::ParserStruct::parse_hek_tag_file(extracted_data.data(), extracted_data.size(), true));
-                                        struct_paths.emplace_back(map_tag_path);
-                                        struct_inputs.emplace_back(&i);
-                                        successful = true;
-                                    }
-                                    catch(std::exception &e) {
-                                        eprintf_error("Cannot compare %s.%s due to an error: %s", File::halo_path_to_preferred_path(tag.path).c_str(), HEK::tag_fourcc_to_extension(tag.fourcc), e.what());
-                                        successful = false;
-                                    }
-                                    
-                                    // We can now unlock the mutex
-                                    log_mutex->unlock();
-                                    
-                                    // And if we failed, restart the whole loop
-                                    if(!successful) {
-                                        goto reset_loop;
-                                    }
-                                            
-                                    if(only_finding_same_tag) {
-                                        break;
-                                    }
-                                }
-                            }
+                        // Only look at tags with the same path (if we need to) or the same class
+                        const std::vector<std::size_t> *entries = nullptr;
+                        if(only_finding_same_tag) {
+                            auto found = i.entries_by_path.find(tag);
+                            entries = found == i.entries_by_path.end() ? nullptr : &found->second;
                         }
-                        
-                        // If it's a tag, do this
                         else {
-                            for(auto &vd : i.virtual_directory) {
-                                // Skip if the FourCC is different
-                                if(vd.tag_fourcc != tag.fourcc) {
-                                    continue;
+                            auto found = i.entries_by_fourcc.find(tag.fourcc);
+                            entries = found == i.entries_by_fourcc.end() ? nullptr : &found->second;
+                        }
+                        if(entries == nullptr) {
+                            continue;
+                        }
+                        
+                        for(auto entry : *entries) {
+                            auto &entry_path = i.entry_paths[entry].path;
+                            if(!CAN_COMPARE(by_path_copy, tag.path, entry_path)) {
+                                continue;
+                            }
+                            
+                            // If it's a map, extract it
+                            if(i.map.has_value()) {
+                                // Lock the lock mutex in case issues arise when extracting the tag. This may slow down throughput a bit, but it's better than clobbering standard error while other stuff is logging.
+                                log_mutex->lock();
+                                
+                                bool successful = false;
+                                try {
+                                    auto extracted_data = Invader::ExtractionWorkload::extract_single_tag(i.map_data->get_tag(entry));
+                                    found_tags.emplace_back(FoundTag { std::move(extracted_data), 0, entry_path, &i });
+                                    successful = true;
+                                }
+                                catch(std::exception &e) {
+                                    eprintf_error("Cannot compare %s.%s due to an error: %s", File::halo_path_to_preferred_path(tag.path).c_str(), HEK::tag_fourcc_to_extension(tag.fourcc), e.what());
+                                    successful = false;
                                 }
                                 
-                                if(CAN_COMPARE(by_path_copy, path_unsplit, vd.tag_path)) {
-                                    // Open it
-                                    auto file = Invader::File::open_file(vd.full_path).value();
-                                    
-                                    // Parse it
-                                    structs.emplace_back(Parser::ParserStruct::parse_hek_tag_file(file.data(), file.size(), true));
-                                    struct_paths.emplace_back(File::split_tag_class_extension(File::preferred_path_to_halo_path(vd.tag_path)).value().path);
-                                    struct_inputs.emplace_back(&i);
-                                    
-                                    if(only_finding_same_tag) {
-                                        break;
-                                    }
+                                // We can now unlock the mutex
+                                log_mutex->unlock();
+                                
+                                // And if we failed, restart the whole loop
+                                if(!successful) {
+                                    goto reset_loop;
                                 }
                             }
+                            
+                            // If it's a tag, open it
+                            else {
+                                found_tags.emplace_back(FoundTag { Invader::File::open_file(i.virtual_directory[entry].full_path).value(), 0, entry_path, &i });
+                            }
+                            
+                            // Use the hash from the tags manifest if the tag didn't change since it was hashed
+                            auto &found_tag = found_tags.back();
+                            std::optional<std::uint64_t> recorded_hash;
+                            if(!i.map.has_value()) {
+                                recorded_hash = File::get_recorded_tag_file_hash(i.virtual_directory[entry]);
+                            }
+                            found_tag.hash = recorded_hash.has_value() ? *recorded_hash : fnv1a_64(found_tag.data);
+                            
+                            if(only_finding_same_tag) {
+                                break;
+                            }
                         }
                     }
                 }
@@ -527,7 +570,7 @@ static void regular_comparison(const std::vector<Input> &inputs, bool precision,
                     continue;
                 }
                 
-                auto found_count = structs.size();
+                auto found_count = found_tags.size();
                 if(found_count < 2) {
                     continue;
                 }
@@ -536,18 +579,18 @@ static void regular_comparison(const std::vector<Input> &inputs, bool precision,
                 #define MATCHED_TO(type) "%s%s.%s, %s.%s", show_all ? type ": " : ""
                 #define MATCHED_TO_DIFFERENT_INPUT(type) "%s%s.%s, %s.%s (%zu)", show_all ? type ": " : ""
                 
-                auto &first_struct = structs[0];
+                auto &first_tag = found_tags[0];
                 
                 // Just for setting counter/debugging
-                auto match_log = [&tag, &matched_count, &show, &show_all, &mismatched_count, &struct_paths, &by_path, &struct_inputs, &inputs, &log_mutex](bool did_match, std::size_t i, const std::list<std::string> &other_messages = {}) {
+                auto match_log = [&tag, &matched_count, &show, &show_all, &mismatched_count, &found_tags, &by_path, &inputs, &log_mutex](bool did_match, std::size_t i, const std::list<std::string> &other_messages = {}) {
                     auto *extension = HEK::tag_fourcc_to_extension(tag.fourcc);
-                    auto other_path = File::halo_path_to_preferred_path(struct_paths[i]);
+                    auto other_path = File::halo_path_to_preferred_path(found_tags[i].path);
                     bool show_different_input = inputs->size() > 2; // only need to show differing inputs if we have more than two inputs
                     std::size_t input_of_other = 1;
                     
                     // If we're using multiple inputs, get the input of the other thing
                     if(show_different_input) {
-                        auto *other_input = struct_inputs[i];
+                        auto *other_input = found_tags[i].input;
                         for(auto &i : *inputs) {
                             if(&i == other_input) {
                                 input_of_other = &i - inputs->data();
@@ -596,6 +639,14 @@ static void regular_comparison(const std::vector<Input> &inputs, bool precision,
                     }
                 };
                 
+                // Tags with the exact same data always match, so they don't need to be parsed (or compiled) to compare them
+                auto is_identical = [&found_tags, &first_tag](std::size_t i) -> bool {
+                    return found_tags[i].hash == first_tag.hash && found_tags[i].data == first_tag.data;
+                };
+                auto parse_tag = [](const FoundTag &found_tag) {
+                    return Parser::ParserStruct::parse_hek_tag_file(found_tag.data.data(), found_tag.data.size(), true);
+                };
+                
                 if(functional) {
                     try {
                         auto meme_up_struct = [&tag](Parser::ParserStruct &struct_v) -> std::vector<std::uint8_t> {
@@ -651,10 +702,54 @@ static void regular_comparison(const std::vector<Input> &inputs, bool precision,
                             return meme_data;
                         };
                         
-                        auto first_meme = meme_up_struct(*first_struct);
+                        // Get the hash of the functionally compiled tag, only compiling it if a tag with the same data hasn't been compiled yet
+                        auto functional_hash = [&tag, &meme_up_struct, &parse_tag, &functional_hashes, &functional_mutex, &cache_directory](const FoundTag &found_tag) -> std::uint64_t {
+                            auto key = CompareCache::functional_key(found_tag.hash, tag.fourcc);
+                            
+                            // If another thread already has (or is getting) this one, wait for it instead
+                            std::promise<std::uint64_t> promise;
+                            {
+                                std::unique_lock lock(*functional_mutex);
+                                auto found = functional_hashes->find(key);
+                                if(found != functional_hashes->end()) {
+                                    auto future = found->second;
+                                    lock.unlock();
+                                    return future.get();
+                                }
+                                functional_hashes->emplace(key, promise.get_future().share());
+                            }
+                            
+                            try {
+                                std::optional<std::uint64_t> hash;
+                                if(cache_directory->has_value()) {
+                                    hash = CompareCache::load_functional_hash(**cache_directory, key);
+                                }
+                                if(!hash.has_value()) {
+                                    auto mms = meme_up_struct(*parse_tag(found_tag));
+                                    hash = fnv1a_64(reinterpret_cast<const std::byte *>(mms.data()), mms.size());
+                                    if(cache_directory->has_value()) {
+                                        CompareCache::save_functional_hash(**cache_directory, key, *hash);
+                                    }
+                                }
+                                promise.set_value(*hash);
+                                return *hash;
+                            }
+                            catch(...) {
+                                promise.set_exception(std::current_exception());
+                                throw;
+                            }
+                        };
+                        
+                        std::optional<std::uint64_t> first_hash;
                         for(std::size_t i = 1; i < found_count; i++) {
-                            auto mms = meme_up_struct(*structs[i]);
-                            match_log(first_meme == mms, i);
+                            if(is_identical(i)) {
+                                match_log(true, i);
+                                continue;
+                            }
+                            if(!first_hash.has_value()) {
+                                first_hash = functional_hash(first_tag);
+                            }
+                            match_log(*first_hash == functional_hash(found_tags[i]), i);
                         }
                     }
                     catch(std::exception &e) {
@@ -664,13 +759,22 @@ static void regular_comparison(const std::vector<Input> &inputs, bool precision,
                     }
                 }
                 else {
+                    std::unique_ptr<Parser::ParserStruct> first_struct;
                     for(std::size_t i = 1; i < found_count; i++) {
                         std::list<std::string> differences;
                         bool matched = false;
                         bool match_successful;
                         
                         try {
-                            matched = first_struct->compare(structs[i].get(), precision, true, verbose ? &differences : nullptr);
+                            if(is_identical(i)) {
+                                matched = true;
+                            }
+                            else {
+                                if(!first_struct) {
+                                    first_struct = parse_tag(first_tag);
+                                }
+                                matched = first_struct->compare(parse_tag(found_tags[i]).get(), precision, true, verbose ? &differences : nullptr);
+                            }
                             match_successful = true;
                         }
                         catch(std::exception &e) {
@@ -691,7 +795,7 @@ static void regular_comparison(const std::vector<Input> &inputs, bool precision,
             }
         };
         
-        threads.emplace_back(perform_comparison_thread, &inputs, &tags, by_path, show_all, show, &matched_count, &mismatched_count, functional, precision, verbose, &tag_mutex, &tag_index, &log_mutex);
+        threads.emplace_back(perform_comparison_thread, &inputs, &tags, by_path, show_all, show, &matched_count, &mismatched_count, functional, precision, verbose, &tag_mutex, &tag_index, &log_mutex, &functional_hashes, &functional_mutex, &cache_directory);
     }
     
     // Wait for threads to finish
@@ -701,7 +805,8 @@ static void regular_comparison(const std::vector<Input> &inputs, bool precision,
     
     // Show the total matched if we are showing both
     if(show_all) {
-        auto total = matched_count + mismatched_count;
-        oprintf("Matched %zu / %zu tag%s\n", matched_count, total, total == 1 ? "" : "s");
+        std::size_t matched = matched_count;
+        auto total = matched + mismatched_count;
+        oprintf("Matched %zu / %zu tag%s\n", matched, total, total == 1 ? "" : "s");
     }
 }
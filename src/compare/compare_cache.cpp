@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <cstring>
+#include <invader/crc/hash.hpp>
+#include <invader/file/file.hpp>
+#include <invader/hek/endian.hpp>
+#include <invader/version.hpp>
+#include "compare_cache.hpp"
+
+namespace Invader::CompareCache {
+    // Bump this whenever the format or the way tags get flattened for comparison changes so old entries get ignored
+    static constexpr std::uint32_t COMPARE_CACHE_VERSION = 1;
+    static constexpr char COMPARE_CACHE_MAGIC[8] = "invcmpc";
+
+    struct CompareCacheEntry {
+        char magic[sizeof(COMPARE_CACHE_MAGIC)];
+        HEK::LittleEndian<std::uint32_t> version;
+        HEK::LittleEndian<std::uint32_t> padding;
+        HEK::LittleEndian<std::uint64_t> functional_hash;
+    };
+    static_assert(sizeof(CompareCacheEntry) == 0x18);
+
+    static std::filesystem::path path_for_key(const std::filesystem::path &cache_directory, std::uint64_t key) {
+        char file_name[32];
+        std::snprintf(file_name, sizeof(file_name), "%016llx.bin", static_cast<unsigned long long>(key));
+        return cache_directory / file_name;
+    }
+
+    std::uint64_t functional_key(std::uint64_t data_hash, HEK::TagFourCC tag_fourcc) noexcept {
+        // Tags compile differently between versions of Invader, so the version is part of the key
+        HEK::LittleEndian<std::uint64_t> parameters[] = { data_hash, static_cast<std::uint64_t>(tag_fourcc), COMPARE_CACHE_VERSION };
+        auto *version = full_version();
+        auto key = fnv1a_64(reinterpret_cast<const std::byte *>(parameters), sizeof(parameters));
+        return fnv1a_64(reinterpret_cast<const std::byte *>(version), std::strlen(version), key);
+    }
+
+    std::optional<std::uint64_t> load_functional_hash(const std::filesystem::path &cache_directory, std::uint64_t key) {
+        // Nothing cached yet is not an error
+        auto path = path_for_key(cache_directory, key);
+        std::error_code ec;
+        if(!std::filesystem::is_regular_file(path, ec)) {
+            return std::nullopt;
+        }
+
+        auto data_maybe = File::open_file(path);
+        if(!data_maybe.has_value()) {
+            return std::nullopt;
+        }
+        auto &data = *data_maybe;
+
+        // Make sure it's valid
+        if(data.size() != sizeof(CompareCacheEntry)) {
+            return std::nullopt;
+        }
+        const auto &entry = *reinterpret_cast<const CompareCacheEntry *>(data.data());
+        if(std::memcmp(entry.magic, COMPARE_CACHE_MAGIC, sizeof(entry.magic)) != 0 || entry.version != COMPARE_CACHE_VERSION) {
+            return std::nullopt;
+        }
+
+        return entry.functional_hash.read();
+    }
+
+    void save_functional_hash(const std::filesystem::path &cache_directory, std::uint64_t key, std::uint64_t functional_hash) {
+        std::vector<std::byte> data(sizeof(CompareCacheEntry));
+        auto &entry = *reinterpret_cast<CompareCacheEntry *>(data.data());
+        std::memcpy(entry.magic, COMPARE_CACHE_MAGIC, sizeof(entry.magic));
+        entry.version = COMPARE_CACHE_VERSION;
+        entry.padding = 0;
+        entry.functional_hash = functional_hash;
+
+        std::error_code ec;
+        std::filesystem::create_directories(cache_directory, ec);
+        auto path = path_for_key(cache_directory, key);
+        File::save_file_atomically(path, data);
+    }
+}
@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__COMPARE__COMPARE_CACHE_HPP
+#define INVADER__COMPARE__COMPARE_CACHE_HPP
+
+#include <filesystem>
+#include <optional>
+#include <cstdint>
+#include <invader/hek/fourcc.hpp>
+
+namespace Invader::CompareCache {
+    /**
+     * Get the key for a functionally compiled tag
+     * @param data_hash  hash of the tag file data
+     * @param tag_fourcc class of the tag
+     * @return           key
+     */
+    std::uint64_t functional_key(std::uint64_t data_hash, HEK::TagFourCC tag_fourcc) noexcept;
+
+    /**
+     * Load the hash of a functionally compiled tag from the cache
+     * @param cache_directory cache directory
+     * @param key             key of the tag
+     * @return                hash if found and valid
+     */
+    std::optional<std::uint64_t> load_functional_hash(const std::filesystem::path &cache_directory, std::uint64_t key);
+
+    /**
+     * Save the hash of a functionally compiled tag to the cache. Failing to save is not an error; it'll just be slower next time.
+     * @param cache_directory cache directory
+     * @param key             key of the tag
+     * @param functional_hash hash of the functionally compiled tag
+     */
+    void save_functional_hash(const std::filesystem::path &cache_directory, std::uint64_t key, std::uint64_t functional_hash);
+}
+
+#endif
@@ -0,0 +1,14 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <invader/crc/hash.hpp>
+
+namespace Invader {
+    std::uint64_t fnv1a_64(const std::byte *data, std::size_t size, std::uint64_t hash) noexcept {
+        static constexpr std::uint64_t FNV1A_64_PRIME = 0x100000001B3;
+        for(std::size_t i = 0; i < size; i++) {
+            hash ^= static_cast<std::uint8_t>(data[i]);
+            hash *= FNV1A_64_PRIME;
+        }
+        return hash;
+    }
+}
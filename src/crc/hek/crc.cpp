@@ -115,6 +115,44 @@ namespace Invader {
         }
     }
     
+    std::uint32_t calculate_map_crc(const std::vector<std::pair<const std::byte *, std::size_t>> &regions, std::size_t tag_file_checksums_offset, const std::uint32_t *new_crc, std::uint32_t *new_random) {
+        if(new_crc && !new_random) {
+            std::terminate();
+        }
+        
+        // If we aren't forging, we don't need to put it all together
+        if(!new_crc) {
+            std::uint32_t crc = 0;
+            for(auto &r : regions) {
+                crc = crc32(crc, r.first, r.second);
+            }
+            return ~crc;
+        }
+        
+        std::size_t total_size = 0;
+        for(auto &r : regions) {
+            total_size += r.second;
+        }
+        
+        std::vector<std::byte> data_crc;
+        data_crc.reserve(total_size);
+        for(auto &r : regions) {
+            data_crc.insert(data_crc.end(), r.first, r.first + r.second);
+        }
+        
+        if(tag_file_checksums_offset + sizeof(std::uint32_t) > data_crc.size()) {
+            throw OutOfBoundsException();
+        }
+        
+        // Overwrite with new CRC32
+        FakeFileHandle handle = { reinterpret_cast<std::uint8_t *>(data_crc.data()), data_crc.size(), 0 };
+        std::uint32_t newcrc = ~crc_spoof_reverse_bits(*new_crc);
+        crc_spoof_modify_file_crc32(&handle, tag_file_checksums_offset, newcrc, false);
+        *new_random = *reinterpret_cast<std::uint32_t *>(data_crc.data() + tag_file_checksums_offset);
+        
+        return ~crc32(0, data_crc.data(), data_crc.size());
+    }
+    
     std::uint32_t calculate_map_crc(const std::byte *data, std::size_t size, const std::uint32_t *new_crc, std::uint32_t *new_random, bool *check_dirty) {
         return calculate_map_crc(Map::map_with_copy(data, size), new_crc, new_random, check_dirty);
     }
@@ -6,6 +6,7 @@
 #include <invader/version.hpp>
 #include <invader/printf.hpp>
 #include <invader/dependency/found_tag_dependency.hpp>
+#include <invader/dependency/dependency_index.hpp>
 #include <invader/build/build_workload.hpp>
 #include <invader/map/map.hpp>
 #include "../command_line_option.hpp"
@@ -22,6 +23,7 @@ int main(int argc, char * const *argv) {
         CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_TAGS_MULTIPLE),
         CommandLineOption("reverse", 'R', 0, "Find all tags that depend on the tag, instead. The tag does not have to exist if not using --fs-path."),
         CommandLineOption("recursive", 'r', 0, "Recursively get all depended tags."),
+        CommandLineOption("rebuild-index", 'I', 0, "Parse every tag again when using --reverse rather than only the tags that changed since the dependency index was last saved."),
     };
 
     static constexpr char DESCRIPTION[] = "Check dependencies for a tag.";
@@ -30,6 +32,7 @@ int main(int argc, char * const *argv) {
     struct DependencyOption {
         bool reverse = false;
         bool recursive = false;
+        bool rebuild_index = false;
         std::vector<std::filesystem::path> tags;
         bool use_filesystem_path = false;
     } dependency_options;
@@ -48,6 +51,9 @@ int main(int argc, char * const *argv) {
             case 'r':
                 dependency_options.recursive = true;
                 break;
+            case 'I':
+                dependency_options.rebuild_index = true;
+                break;
             case 'P':
                 dependency_options.use_filesystem_path = true;
                 break;
@@ -81,9 +87,31 @@ int main(int argc, char * const *argv) {
         return EXIT_FAILURE;
     }
 
+    // Finding what references a tag uses the dependency index so only tags that changed need to be parsed
+    if(dependency_options.reverse) {
+        try {
+            DependencyIndex index(dependency_options.tags, dependency_options.rebuild_index);
+            auto found_tags = index.find_referencing_tags(File::TagFilePath(File::preferred_path_to_halo_path(tag_path_split->path), tag_path_split->fourcc));
+            for(auto *tag : found_tags) {
+                oprintf("%s.%s\n", File::halo_path_to_preferred_path(tag->path.path).c_str(), HEK::tag_fourcc_to_extension(tag->path.fourcc));
+            }
+        }
+        catch(std::exception &e) {
+            eprintf_error("Failed to index the tags directories: %s", e.what());
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    // Recursively going through dependencies looks up a lot of tags, so index the tags directories first
+    std::optional<File::TagDirectoryIndex> tags_index;
+    if(dependency_options.recursive) {
+        tags_index.emplace(dependency_options.tags);
+    }
+
     // Here's an array we can use to hold what we got
     bool success;
-    auto found_tags = FoundTagDependency::find_dependencies(tag_path_split->path.c_str(), tag_path_split->fourcc, dependency_options.tags, dependency_options.reverse, dependency_options.recursive, success);
+    auto found_tags = FoundTagDependency::find_dependencies(tag_path_split->path.c_str(), tag_path_split->fourcc, dependency_options.tags, dependency_options.reverse, dependency_options.recursive, success, tags_index.has_value() ? &*tags_index : nullptr);
 
     if(!success) {
         return EXIT_FAILURE;
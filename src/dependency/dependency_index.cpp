@@ -0,0 +1,310 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <invader/dependency/dependency_index.hpp>
+#include <invader/dependency/found_tag_dependency.hpp>
+#include <invader/hek/endian.hpp>
+#include <invader/printf.hpp>
+
+namespace Invader {
+    // Bump this whenever the format (or what gets indexed) changes so old indices get rebuilt
+    static constexpr std::uint32_t DEPENDENCY_INDEX_VERSION = 2;
+    static constexpr char DEPENDENCY_INDEX_MAGIC[8] = "invdepi";
+
+    struct DependencyIndexHeader {
+        char magic[sizeof(DEPENDENCY_INDEX_MAGIC)];
+        HEK::LittleEndian<std::uint32_t> version;
+        HEK::LittleEndian<std::uint32_t> tag_count;
+    };
+    static_assert(sizeof(DependencyIndexHeader) == 0x10);
+
+    struct DependencyIndexTag {
+        HEK::LittleEndian<std::uint64_t> content_hash;
+        HEK::LittleEndian<std::uint32_t> dependency_count;
+        HEK::LittleEndian<std::uint32_t> padding;
+    };
+    static_assert(sizeof(DependencyIndexTag) == 0x10);
+
+    struct DependencyIndexDependency {
+        HEK::LittleEndian<std::uint32_t> tag_fourcc;
+        HEK::LittleEndian<std::uint32_t> path_length;
+    };
+    static_assert(sizeof(DependencyIndexDependency) == 0x8);
+
+    // What tags reference by their content hash; whether a tag changed is up to the tags manifest
+    using SavedIndex = std::unordered_map<std::uint64_t, std::vector<File::TagFilePath>>;
+
+    static SavedIndex load_index(const std::filesystem::path &path) {
+        std::error_code ec;
+        if(!std::filesystem::is_regular_file(path, ec)) {
+            return SavedIndex();
+        }
+
+        auto data_maybe = File::open_file(path);
+        if(!data_maybe.has_value()) {
+            return SavedIndex();
+        }
+        auto &data = *data_maybe;
+
+        // Anything wrong with the index means every tag gets parsed again
+        std::size_t offset = 0;
+        auto read = [&data, &offset](std::size_t size) -> const std::byte * {
+            if(data.size() - offset < size) {
+                return nullptr;
+            }
+            auto *what = data.data() + offset;
+            offset += size;
+            return what;
+        };
+
+        const auto *header = reinterpret_cast<const DependencyIndexHeader *>(read(sizeof(DependencyIndexHeader)));
+        if(!header || std::memcmp(header->magic, DEPENDENCY_INDEX_MAGIC, sizeof(header->magic)) != 0 || header->version != DEPENDENCY_INDEX_VERSION) {
+            return SavedIndex();
+        }
+
+        SavedIndex index;
+        std::uint32_t tag_count = header->tag_count;
+        for(std::uint32_t t = 0; t < tag_count; t++) {
+            const auto *tag = reinterpret_cast<const DependencyIndexTag *>(read(sizeof(DependencyIndexTag)));
+            if(!tag) {
+                return SavedIndex();
+            }
+
+            auto &dependencies = index[tag->content_hash];
+            std::uint32_t dependency_count = tag->dependency_count;
+            for(std::uint32_t d = 0; d < dependency_count; d++) {
+                const auto *dependency = reinterpret_cast<const DependencyIndexDependency *>(read(sizeof(DependencyIndexDependency)));
+                const char *dependency_path_data = dependency ? reinterpret_cast<const char *>(read(dependency->path_length)) : nullptr;
+                if(!dependency_path_data) {
+                    return SavedIndex();
+                }
+                dependencies.emplace_back(std::string(dependency_path_data, dependency->path_length), static_cast<HEK::TagFourCC>(dependency->tag_fourcc.read()));
+            }
+        }
+
+        return index;
+    }
+
+    static bool save_index(const std::filesystem::path &path, const SavedIndex &index) {
+        std::vector<std::byte> data;
+        auto append = [&data](const void *what, std::size_t size) {
+            auto *bytes = reinterpret_cast<const std::byte *>(what);
+            data.insert(data.end(), bytes, bytes + size);
+        };
+
+        DependencyIndexHeader header = {};
+        std::memcpy(header.magic, DEPENDENCY_INDEX_MAGIC, sizeof(header.magic));
+        header.version = DEPENDENCY_INDEX_VERSION;
+        header.tag_count = static_cast<std::uint32_t>(index.size());
+        append(&header, sizeof(header));
+
+        for(auto &[content_hash, dependencies] : index) {
+            DependencyIndexTag tag = {};
+            tag.content_hash = content_hash;
+            tag.dependency_count = static_cast<std::uint32_t>(dependencies.size());
+            append(&tag, sizeof(tag));
+
+            for(auto &d : dependencies) {
+                DependencyIndexDependency dependency = {};
+                dependency.tag_fourcc = static_cast<std::uint32_t>(d.fourcc);
+                dependency.path_length = static_cast<std::uint32_t>(d.path.size());
+                append(&dependency, sizeof(dependency));
+                append(d.path.data(), d.path.size());
+            }
+        }
+
+        return File::save_file_atomically(path, data);
+    }
+
+    // Tags of these classes cannot reference anything, so they don't need to be read
+    static bool cannot_have_dependencies(HEK::TagFourCC fourcc) noexcept {
+        switch(fourcc) {
+            case HEK::TagFourCC::TAG_FOURCC_NULL:
+            case HEK::TagFourCC::TAG_FOURCC_BITMAP:
+            case HEK::TagFourCC::TAG_FOURCC_CAMERA_TRACK:
+            case HEK::TagFourCC::TAG_FOURCC_HUD_MESSAGE_TEXT:
+            case HEK::TagFourCC::TAG_FOURCC_PHYSICS:
+            case HEK::TagFourCC::TAG_FOURCC_SOUND_ENVIRONMENT:
+            case HEK::TagFourCC::TAG_FOURCC_STRING_LIST:
+            case HEK::TagFourCC::TAG_FOURCC_UNICODE_STRING_LIST:
+            case HEK::TagFourCC::TAG_FOURCC_WIND:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    std::filesystem::path DependencyIndex::index_path(const std::filesystem::path &tags_directory) {
+        auto path = tags_directory;
+
+        // Remove any trailing separator so the index ends up next to the directory rather than in it
+        if(!path.has_filename() && path.has_parent_path()) {
+            path = path.parent_path();
+        }
+
+        path += ".invader-dependency-index";
+        return path;
+    }
+
+    std::vector<const DependencyIndex::IndexedTag *> DependencyIndex::find_referencing_tags(const File::TagFilePath &tag) const {
+        std::vector<const IndexedTag *> found;
+        auto referenced = this->referenced_by.find(tag);
+        if(referenced != this->referenced_by.end()) {
+            found.reserve(referenced->second.size());
+            for(auto i : referenced->second) {
+                found.emplace_back(&this->tags[i]);
+            }
+        }
+        return found;
+    }
+
+    const DependencyIndex::IndexedTag *DependencyIndex::find_tag(const std::filesystem::path &full_path) const {
+        auto tag = this->by_full_path.find(full_path.string());
+        return tag == this->by_full_path.end() ? nullptr : &this->tags[tag->second];
+    }
+
+    DependencyIndex::DependencyIndex(const std::vector<std::filesystem::path> &tags, bool rebuild, std::size_t threads) {
+        auto all_tags = File::load_virtual_tag_folder(tags, false);
+
+        // Load what was indexed last time
+        std::vector<SavedIndex> saved(tags.size());
+        if(!rebuild) {
+            for(std::size_t d = 0; d < tags.size(); d++) {
+                saved[d] = load_index(index_path(tags[d]));
+            }
+        }
+
+        // Only parse the tags whose contents aren't in the index
+        std::vector<std::optional<std::vector<File::TagFilePath>>> indexed(all_tags.size());
+        std::atomic<std::size_t> next_tag = 0;
+        std::atomic<std::size_t> tags_parsed = 0;
+        std::mutex log_mutex;
+
+        auto index_tags = [&]() {
+            while(true) {
+                auto t = next_tag++;
+                if(t >= all_tags.size()) {
+                    return;
+                }
+
+                auto &tag = all_tags[t];
+                if(cannot_have_dependencies(tag.tag_fourcc)) {
+                    indexed[t].emplace();
+                    continue;
+                }
+
+                // The hash comes from the tags manifest if the tag didn't change; otherwise the tag is read here
+                std::vector<std::byte> tag_data;
+                auto content_hash = File::get_tag_file_hash(tag, &tag_data);
+                if(!content_hash.has_value()) {
+                    std::scoped_lock lock(log_mutex);
+                    eprintf_error("Failed to read tag %s", tag.full_path.string().c_str());
+                    continue;
+                }
+
+                auto &saved_index = saved[tag.tag_directory];
+                auto saved_tag = saved_index.find(*content_hash);
+                if(saved_tag != saved_index.end()) {
+                    indexed[t] = saved_tag->second;
+                    continue;
+                }
+
+                if(tag_data.empty()) {
+                    auto tag_data_maybe = File::open_file(tag.full_path);
+                    if(!tag_data_maybe.has_value()) {
+                        std::scoped_lock lock(log_mutex);
+                        eprintf_error("Failed to read tag %s", tag.full_path.string().c_str());
+                        continue;
+                    }
+                    tag_data = std::move(*tag_data_maybe);
+                }
+
+                try {
+                    indexed[t] = FoundTagDependency::get_dependencies(tag_data.data(), tag_data.size());
+                    tags_parsed++;
+                }
+                catch(std::exception &e) {
+                    std::scoped_lock lock(log_mutex);
+                    eprintf_warn("Warning: Failed to compile tag %s: %s", tag.full_path.string().c_str(), e.what());
+                }
+            }
+        };
+
+        std::size_t thread_count = threads == 0 ? std::max(std::thread::hardware_concurrency(), 1U) : threads;
+        thread_count = std::max(std::min(thread_count, all_tags.size()), static_cast<std::size_t>(1));
+        std::vector<std::thread> workers;
+        workers.reserve(thread_count - 1);
+        for(std::size_t w = 1; w < thread_count; w++) {
+            workers.emplace_back(index_tags);
+        }
+        index_tags();
+        for(auto &w : workers) {
+            w.join();
+        }
+        this->tags_parsed = tags_parsed;
+
+        // Record any hashes we had to compute in the tags manifests
+        File::save_tag_file_hashes(tags, all_tags);
+
+        // Save the index for each tags directory if anything in it changed
+        std::vector<SavedIndex> new_indices(tags.size());
+        for(std::size_t t = 0; t < all_tags.size(); t++) {
+            if(indexed[t].has_value() && all_tags[t].content_hash.has_value() && !cannot_have_dependencies(all_tags[t].tag_fourcc)) {
+                new_indices[all_tags[t].tag_directory].emplace(*all_tags[t].content_hash, *indexed[t]);
+            }
+        }
+        for(std::size_t d = 0; d < tags.size(); d++) {
+            auto &old_index = saved[d];
+            auto &new_index = new_indices[d];
+            bool changed = rebuild || old_index.size() != new_index.size();
+            for(auto i = new_index.begin(); !changed && i != new_index.end(); i++) {
+                changed = old_index.find(i->first) == old_index.end();
+            }
+            if(changed) {
+                auto path = index_path(tags[d]);
+                if(!save_index(path, new_index)) {
+                    eprintf_warn("Failed to save the dependency index %s", path.string().c_str());
+                }
+            }
+        }
+
+        // If a tag is in more than one tags directory, only the one with the highest priority is used
+        std::unordered_map<std::string, std::size_t> used;
+        used.reserve(all_tags.size());
+        for(std::size_t t = 0; t < all_tags.size(); t++) {
+            auto [it, inserted] = used.emplace(all_tags[t].tag_path, t);
+            if(!inserted && all_tags[t].tag_directory < all_tags[it->second].tag_directory) {
+                it->second = t;
+            }
+        }
+
+        this->tags.reserve(all_tags.size());
+        for(std::size_t t = 0; t < all_tags.size(); t++) {
+            if(!indexed[t].has_value()) {
+                continue;
+            }
+
+            auto &tag = all_tags[t];
+            auto tag_path = File::split_tag_class_extension(File::preferred_path_to_halo_path(tag.tag_path));
+            if(!tag_path.has_value()) {
+                continue;
+            }
+
+            auto index = this->tags.size();
+            auto &indexed_tag = this->tags.emplace_back();
+            indexed_tag.path = std::move(*tag_path);
+            indexed_tag.full_path = tag.full_path;
+            indexed_tag.dependencies = std::move(*indexed[t]);
+            this->by_full_path.emplace(tag.full_path.string(), index);
+
+            if(used[tag.tag_path] == t) {
+                for(auto &d : indexed_tag.dependencies) {
+                    this->referenced_by[d].emplace_back(index);
+                }
+            }
+        }
+    }
+}
@@ -6,50 +6,45 @@
 #include <invader/tag/parser/parser_struct.hpp>
 
 #include <filesystem>
+#include <unordered_set>
 
 namespace Invader {
-    static std::vector<File::TagFilePath> get_dependencies(const std::byte *tag_data, std::size_t tag_data_length) {
+    std::vector<File::TagFilePath> FoundTagDependency::get_dependencies(const std::byte *tag_data, std::size_t tag_data_size) {
         std::vector<File::TagFilePath> dependencies;
-        
-        auto recursively_get_dependencies = [&dependencies](const Parser::ParserStruct &st, auto &recursively_get_dependencies) -> void {
-            for(auto &v : st.get_values()) {
-                switch(v.get_type()) {
-                    case Parser::ParserStructValue::ValueType::VALUE_TYPE_REFLEXIVE: {
-                        auto count = v.get_array_size();
-                        for(std::size_t i = 0; i < count; i++) {
-                            recursively_get_dependencies(v.get_object_in_array(i), recursively_get_dependencies);
-                        }
-                        break;
-                    }
-                    case Parser::ParserStructValue::ValueType::VALUE_TYPE_DEPENDENCY: {
-                        auto &dep = v.get_dependency();
-                        if(!dep.path.empty()) {
-                            dependencies.emplace_back(File::halo_path_to_preferred_path(dep.path), dep.tag_fourcc);
-                        }
-                        break;
-                    }
-                    default: break;
-                }
+        std::unordered_set<std::string> found;
+        Parser::ParserStruct::scan_hek_dependencies(tag_data, tag_data_size, [&dependencies, &found](const char *path, TagFourCC tag_fourcc) {
+            File::TagFilePath dependency(File::preferred_path_to_halo_path(File::remove_duplicate_slashes(path)), tag_fourcc);
+            if(found.insert(dependency.join()).second) {
+                dependencies.emplace_back(std::move(dependency));
             }
-        };
-        
-        recursively_get_dependencies(*Parser::ParserStruct::parse_hek_tag_file(tag_data, tag_data_length), recursively_get_dependencies);
-        
+        });
         return dependencies;
     }
 
-    std::vector<FoundTagDependency> FoundTagDependency::find_dependencies(const char *tag_path_to_find_2, Invader::TagFourCC tag_int_to_find, std::vector<std::filesystem::path> tags, bool reverse, bool recursive, bool &success) {
+    std::vector<FoundTagDependency> FoundTagDependency::find_dependencies(const char *tag_path_to_find_2, Invader::TagFourCC tag_int_to_find, std::vector<std::filesystem::path> tags, bool reverse, bool recursive, bool &success, const File::TagDirectoryIndex *tags_index) {
         std::vector<FoundTagDependency> found_tags;
         success = true;
 
         if(!reverse) {
-            auto find_dependencies_in_tag = [&tags, &found_tags, &recursive, &success](const char *tag_path_to_find_2, Invader::TagFourCC tag_int_to_find, auto recursion) -> void {
+            auto find_dependencies_in_tag = [&tags, &tags_index, &found_tags, &recursive, &success](const char *tag_path_to_find_2, Invader::TagFourCC tag_int_to_find, auto recursion) -> void {
                 std::string tag_path_to_find = File::halo_path_to_preferred_path(tag_path_to_find_2);
+                
+                // If we have an index, we only need to look in the one tags directory it's in
+                std::vector<std::filesystem::path> tag_file_paths;
+                if(tags_index) {
+                    if(auto *tag = tags_index->find_tag(tag_path_to_find + "." + tag_fourcc_to_extension(tag_int_to_find))) {
+                        tag_file_paths.emplace_back(tag->full_path);
+                    }
+                }
+                else {
+                    for(auto &tags_directory : tags) {
+                        tag_file_paths.emplace_back(std::filesystem::path(tags_directory) / (tag_path_to_find + "." + tag_fourcc_to_extension(tag_int_to_find)));
+                    }
+                }
 
                 // See if we can open the tag
                 bool found = false;
-                for(auto &tags_directory : tags) {
-                    std::filesystem::path tag_path = std::filesystem::path(tags_directory) / (tag_path_to_find + "." + tag_fourcc_to_extension(tag_int_to_find));
+                for(auto &tag_path : tag_file_paths) {
                     auto tag_data = File::open_file(tag_path);
                     if(!tag_data.has_value()) {
                         eprintf_error("Failed to read tag %s", tag_path.string().c_str());
@@ -59,6 +54,8 @@ namespace Invader {
                     try {
                         auto dependencies = get_dependencies(tag_data->data(), tag_data->size());
                         for(auto &dependency : dependencies) {
+                            dependency.path = File::halo_path_to_preferred_path(dependency.path);
+                            
                             // Make sure it's not in found_tags
                             bool dupe = false;
                             for(auto &tag : found_tags) {
@@ -75,12 +72,20 @@ namespace Invader {
                             std::string path_copy = dependency.join();
 
                             bool found = false;
-                            for(auto &tags_directory : tags) {
-                                auto complete_tag_path = std::filesystem::path(tags_directory) / path_copy;
-                                if(std::filesystem::is_regular_file(complete_tag_path)) {
-                                    found_tags.emplace_back(dependency.path, class_to_use, false, complete_tag_path);
+                            if(tags_index) {
+                                if(auto *tag = tags_index->find_tag(path_copy)) {
+                                    found_tags.emplace_back(dependency.path, class_to_use, false, tag->full_path);
                                     found = true;
-                                    break;
+                                }
+                            }
+                            else {
+                                for(auto &tags_directory : tags) {
+                                    auto complete_tag_path = std::filesystem::path(tags_directory) / path_copy;
+                                    if(std::filesystem::is_regular_file(complete_tag_path)) {
+                                        found_tags.emplace_back(dependency.path, class_to_use, false, complete_tag_path);
+                                        found = true;
+                                        break;
+                                    }
                                 }
                             }
 
@@ -163,7 +168,7 @@ namespace Invader {
                             try {
                                 auto dependencies = get_dependencies(tag_data->data(), tag_data->size());
                                 for(auto &dependency : dependencies) {
-                                    if(dependency.path == tag_path_to_find && dependency.fourcc == tag_int_to_find) {
+                                    if(File::halo_path_to_preferred_path(dependency.path) == tag_path_to_find && dependency.fourcc == tag_int_to_find) {
                                         found_tags.emplace_back(dir_tag_path, fourcc, false, file.path());
                                         break;
                                     }
@@ -1,6 +1,7 @@
 #include <invader/error_handler/error_handler.hpp>
 #include <invader/printf.hpp>
 #include <invader/error.hpp>
+#include <mutex>
 
 #ifdef __linux__
 #include <sys/ioctl.h>
@@ -15,6 +16,10 @@
 
 namespace Invader {
     void ErrorHandler::report_error(ErrorType type, const char *error, std::optional<std::size_t> tag_index) {
+        // Errors can be reported from multiple threads, so only report one at a time so the counts are right and the messages don't get mixed together
+        static std::mutex report_mutex;
+        std::scoped_lock lock(report_mutex);
+        
         // Print the right column (description)
         std::size_t terminal_width = 80;
         
@@ -11,6 +11,13 @@ if(${INVADER_EXTRACT})
 
     target_link_libraries(invader-extract invader ${INVADER_CRT_NOGLOB})
 
+    # --archive needs libarchive
+    if(LibArchive_FOUND)
+        target_include_directories(invader-extract PUBLIC ${LibArchive_INCLUDE_DIRS})
+        target_link_libraries(invader-extract ${LibArchive_LIBRARIES})
+        target_compile_definitions(invader-extract PRIVATE INVADER_EXTRACT_ARCHIVE)
+    endif()
+
     set(TARGETS_LIST ${TARGETS_LIST} invader-extract)
 
     do_windows_rc(invader-extract invader-extract.exe "Invader tag extraction tool")
@@ -11,6 +11,60 @@
 #include <invader/build/build_workload.hpp>
 #include <invader/tag/parser/parser.hpp>
 #include <regex>
+#include <thread>
+#include <unordered_set>
+
+#ifdef INVADER_EXTRACT_ARCHIVE
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <archive.h>
+#include <archive_entry.h>
+
+struct ArchiveFormat {
+    const char *extension;
+    int (*filter)(archive *a);
+    int (*format)(archive *a);
+};
+
+static const constexpr ArchiveFormat archive_formats[] = {
+    {".7z", nullptr, archive_write_set_format_7zip},
+    {".tar", nullptr, archive_write_set_format_pax_restricted},
+    {".tar.gz", archive_write_add_filter_gzip, archive_write_set_format_pax_restricted},
+    {".tar.xz", archive_write_add_filter_xz, archive_write_set_format_pax_restricted},
+    {".tar.zst", archive_write_add_filter_zstd, archive_write_set_format_pax_restricted},
+    {".zip", nullptr, archive_write_set_format_zip}
+};
+
+// Writes each extracted tag straight into an archive
+class ArchiveTagSink : public Invader::ExtractionWorkload::TagSink {
+public:
+    bool write_tag(const std::filesystem::path &tag_path, const std::vector<std::byte> &data) override {
+        // libarchive always needs POSIX paths.
+        auto archive_path = tag_path.generic_string();
+        
+        auto *entry = archive_entry_new();
+        archive_entry_set_pathname(entry, archive_path.c_str());
+        archive_entry_set_perm(entry, 0644);
+        archive_entry_set_filetype(entry, AE_IFREG);
+        archive_entry_set_mtime(entry, this->mtime, 0);
+        archive_entry_set_size(entry, static_cast<la_int64_t>(data.size()));
+        
+        // Only one entry can be written at a time
+        std::scoped_lock lock(this->mutex);
+        bool success = archive_write_header(this->a, entry) == ARCHIVE_OK && archive_write_data(this->a, data.data(), data.size()) == static_cast<la_ssize_t>(data.size());
+        archive_entry_free(entry);
+        return success;
+    }
+    
+    ArchiveTagSink(archive *a) : a(a), mtime(std::time(nullptr)) {}
+    
+private:
+    archive *a;
+    std::time_t mtime;
+    std::mutex mutex;
+};
+#endif
 
 int main(int argc, const char **argv) {
     set_up_color_term();
@@ -30,6 +84,9 @@ int main(int argc, const char **argv) {
         bool overwrite = false;
         bool non_mp_globals = false;
         bool ignore_resource_maps = false;
+        std::size_t max_threads = std::thread::hardware_concurrency() < 1 ? 1 : std::thread::hardware_concurrency();
+        std::optional<std::string> archive;
+        std::optional<std::string> manifest;
     } extract_options;
 
     // Command line options
@@ -37,19 +94,22 @@ int main(int argc, const char **argv) {
         CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_INFO),
         CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_MAPS),
         CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_TAGS),
+        CommandLineOption("archive", 'a', 1, "Write the extracted tags into an archive instead of the tags directory. The format is determined by the extension (.7z, .tar, .tar.gz, .tar.xz, .tar.zst, or .zip).", "<file>"),
+        CommandLineOption("manifest", 'M', 1, "Write a list of each version of each tag extracted, whether it was saved, and which maps (by the path given) have it.", "<file>"),
         CommandLineOption("recursive", 'r', 0, "Extract tag dependencies"),
         CommandLineOption("overwrite", 'O', 0, "Overwrite tags if they already exist"),
         CommandLineOption("ignore-resources", 'G', 0, "Ignore resource maps."),
         CommandLineOption("search", 's', 1, "Search for tags (* and ? are wildcards) and extract these. Use multiple times for multiple queries. If unspecified, all tags will be extracted.", "<expr>"),
         CommandLineOption("search-exclude", 'e', 1, "Search for tags (* and ? are wildcards) and ignore these. Use multiple times for multiple queries. This takes precedence over --search.", "<expr>"),
-        CommandLineOption("non-mp-globals", 'n', 0, "Enable extraction of non-multiplayer .globals")
+        CommandLineOption("non-mp-globals", 'n', 0, "Enable extraction of non-multiplayer .globals"),
+        CommandLineOption("threads", 'j', 1, "Set the number of threads to use for parallel extraction. Default: CPU thread count")
     };
 
-    static constexpr char DESCRIPTION[] = "Extract data from cache files.";
-    static constexpr char USAGE[] = "[options] <map>";
+    static constexpr char DESCRIPTION[] = "Extract data from cache files. If multiple maps are given, tags that are the same in multiple maps are only saved once, and tags that differ from one already saved are reported and not saved.";
+    static constexpr char USAGE[] = "[options] <map> [<map> ...]";
 
     // Do it!
-    auto remaining_arguments = Invader::CommandLineOption::parse_arguments<ExtractOptions &>(argc, argv, options, USAGE, DESCRIPTION, 1, 1, extract_options, [](char opt, const auto &args, auto &extract_options) {
+    auto remaining_arguments = Invader::CommandLineOption::parse_arguments<ExtractOptions &>(argc, argv, options, USAGE, DESCRIPTION, 1, 65535, extract_options, [](char opt, const auto &args, auto &extract_options) {
         switch(opt) {
             case 'I':
                 extract_options.ignore_resource_maps = true;
@@ -57,6 +117,12 @@ int main(int argc, const char **argv) {
             case 'm':
                 extract_options.maps_directory = args[0];
                 break;
+            case 'a':
+                extract_options.archive = args[0];
+                break;
+            case 'M':
+                extract_options.manifest = args[0];
+                break;
             case 't':
                 if(extract_options.tags_directory.has_value()) {
                     eprintf_error("This tool does not support multiple tags directories.");
@@ -79,6 +145,19 @@ int main(int argc, const char **argv) {
             case 'e':
                 extract_options.search_queries_exclude.emplace_back(File::preferred_path_to_halo_path(args[0]));
                 break;
+            case 'j':
+                try {
+                    int threads = std::stoi(args[0]);
+                    if(threads < 1) {
+                        throw std::exception();
+                    }
+                    extract_options.max_threads = static_cast<std::size_t>(threads);
+                }
+                catch(std::exception &) {
+                    eprintf_error("Invalid number of threads %s\n", args[0]);
+                    std::exit(EXIT_FAILURE);
+                }
+                break;
             case 'i':
                 Invader::show_version_info();
                 std::exit(EXIT_SUCCESS);
@@ -90,9 +169,20 @@ int main(int argc, const char **argv) {
         extract_options.tags_directory = "tags";
     }
 
-    // Check if the tags directory exists
+    // Maps are told apart by their path when reporting conflicts and in the manifest, so the same map can't be given twice
+    std::unordered_set<std::string> given_maps;
+    for(auto *map_path : remaining_arguments) {
+        std::error_code ec;
+        auto canonical_path = std::filesystem::weakly_canonical(map_path, ec);
+        if(!given_maps.insert(ec ? std::string(map_path) : canonical_path.string()).second) {
+            eprintf_error("%s was given more than once", map_path);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Check if the tags directory exists (unless we're writing to an archive)
     std::filesystem::path tags(*extract_options.tags_directory);
-    if(!std::filesystem::is_directory(tags)) {
+    if(!extract_options.archive.has_value() && !std::filesystem::is_directory(tags)) {
         if(extract_options.tags_directory == "tags") {
             eprintf_error("No tags directory was given, and \"tags\" was not found or is not a directory.");
         }
@@ -102,83 +192,193 @@ int main(int argc, const char **argv) {
         return EXIT_FAILURE;
     }
 
-    std::vector<std::byte> loc, bitmaps, sounds;
-
-    // Find the asset data
-    if(!extract_options.maps_directory.has_value()) {
-        std::filesystem::path map = std::string(remaining_arguments[0]);
-        auto maps_folder = std::filesystem::absolute(map).parent_path();
-        if(std::filesystem::is_directory(maps_folder)) {
-            extract_options.maps_directory = maps_folder.string();
+    #ifdef INVADER_EXTRACT_ARCHIVE
+    // If we're writing to an archive, open it first so tags can be written into it as they're extracted
+    archive *archive = nullptr;
+    std::unique_ptr<ArchiveTagSink> archive_sink;
+    if(extract_options.archive.has_value()) {
+        // Figure out the format from the extension
+        const auto &archive_path = *extract_options.archive;
+        const ArchiveFormat *format = nullptr;
+        for(auto &f : archive_formats) {
+            auto extension_length = std::strlen(f.extension);
+            if(archive_path.size() > extension_length && archive_path.compare(archive_path.size() - extension_length, extension_length, f.extension) == 0) {
+                format = &f;
+            }
+        }
+        if(!format) {
+            eprintf_error("Unknown archive format for %s. The extension must be one of .7z, .tar, .tar.gz, .tar.xz, .tar.zst, or .zip.", archive_path.c_str());
+            return EXIT_FAILURE;
+        }
+        
+        archive = archive_write_new();
+        if((format->filter && format->filter(archive) != ARCHIVE_OK) || format->format(archive) != ARCHIVE_OK || archive_write_open_filename(archive, archive_path.c_str()) != ARCHIVE_OK) {
+            eprintf_error("Failed to open %s for writing: %s", archive_path.c_str(), archive_error_string(archive));
+            archive_write_free(archive);
+            return EXIT_FAILURE;
         }
+        archive_sink = std::make_unique<ArchiveTagSink>(archive);
     }
+    ExtractionWorkload::TagSink *sink = archive_sink.get();
+    #else
+    if(extract_options.archive.has_value()) {
+        eprintf_error("--archive is unavailable because invader-extract was built without libarchive");
+        return EXIT_FAILURE;
+    }
+    ExtractionWorkload::TagSink *sink = nullptr;
+    #endif
 
-    // Load resource maps
-    if(extract_options.maps_directory.has_value() && !extract_options.ignore_resource_maps) {
-        std::filesystem::path maps_directory(*extract_options.maps_directory);
-        auto open_map_possibly = [&maps_directory](const char *map) -> std::vector<std::byte> {
-            auto potential_map = Invader::File::open_file(maps_directory / map);
-            if(potential_map.has_value()) {
-                return *potential_map;
-            }
-            else {
-                return std::vector<std::byte>();
+    // Load a map along with any resource maps it uses
+    auto load_map = [&extract_options](const char *map_path) -> std::unique_ptr<Map> {
+        std::vector<std::byte> loc, bitmaps, sounds;
+        
+        // Find the asset data
+        auto maps_directory_maybe = extract_options.maps_directory;
+        if(!maps_directory_maybe.has_value()) {
+            std::filesystem::path map = std::string(map_path);
+            auto maps_folder = std::filesystem::absolute(map).parent_path();
+            if(std::filesystem::is_directory(maps_folder)) {
+                maps_directory_maybe = maps_folder.string();
             }
-        };
-
-        // Get its header
-        Invader::HEK::CacheFileHeader header;
-        std::FILE *f = std::fopen(remaining_arguments[0], "rb");
-        if(!f) {
-            eprintf_error("Failed to open %s to determine its version", remaining_arguments[0]);
-            return EXIT_FAILURE;
         }
-        if(!std::fread(&header, sizeof(header), 1, f)) {
-            eprintf_error("Failed to read %s to determine its version", remaining_arguments[0]);
+
+        // Load resource maps
+        if(maps_directory_maybe.has_value() && !extract_options.ignore_resource_maps) {
+            std::filesystem::path maps_directory(*maps_directory_maybe);
+            auto open_map_possibly = [&maps_directory](const char *map) -> std::vector<std::byte> {
+                auto potential_map = Invader::File::open_file(maps_directory / map);
+                if(potential_map.has_value()) {
+                    return *potential_map;
+                }
+                else {
+                    return std::vector<std::byte>();
+                }
+            };
+
+            // Get its header
+            Invader::HEK::CacheFileHeader header;
+            std::FILE *f = std::fopen(map_path, "rb");
+            if(!f) {
+                eprintf_error("Failed to open %s to determine its version", map_path);
+                return nullptr;
+            }
+            if(!std::fread(&header, sizeof(header), 1, f)) {
+                eprintf_error("Failed to read %s to determine its version", map_path);
+                std::fclose(f);
+                return nullptr;
+            }
             std::fclose(f);
-            return EXIT_FAILURE;
-        }
-        std::fclose(f);
-
-        // Check if we can do things to it
-        if(header.valid()) {
-            switch(header.engine.read()) {
-                case HEK::CACHE_FILE_DEMO:
-                case HEK::CACHE_FILE_RETAIL:
-                    bitmaps = open_map_possibly("bitmaps.map");
-                    sounds = open_map_possibly("sounds.map");
-                    break;
-                case HEK::CACHE_FILE_MCC_CEA:
-                    if(!(reinterpret_cast<const HEK::CacheFileHeaderCEA *>(&header)->flags & HEK::CacheFileHeaderCEAFlags::CACHE_FILE_HEADER_CEA_FLAGS_CLASSIC_ONLY)) {
+
+            // Check if we can do things to it
+            if(header.valid()) {
+                switch(header.engine.read()) {
+                    case HEK::CACHE_FILE_DEMO:
+                    case HEK::CACHE_FILE_RETAIL:
                         bitmaps = open_map_possibly("bitmaps.map");
-                    }
-                    break;
-                case HEK::CACHE_FILE_CUSTOM_EDITION:
-                    loc = open_map_possibly("loc.map");
-                    bitmaps = open_map_possibly("bitmaps.map");
-                    sounds = open_map_possibly("sounds.map");
-                    break;
-                default:
-                    break; // nothing else gets resource maps
+                        sounds = open_map_possibly("sounds.map");
+                        break;
+                    case HEK::CACHE_FILE_MCC_CEA:
+                        if(!(reinterpret_cast<const HEK::CacheFileHeaderCEA *>(&header)->flags & HEK::CacheFileHeaderCEAFlags::CACHE_FILE_HEADER_CEA_FLAGS_CLASSIC_ONLY)) {
+                            bitmaps = open_map_possibly("bitmaps.map");
+                        }
+                        break;
+                    case HEK::CACHE_FILE_CUSTOM_EDITION:
+                        loc = open_map_possibly("loc.map");
+                        bitmaps = open_map_possibly("bitmaps.map");
+                        sounds = open_map_possibly("sounds.map");
+                        break;
+                    default:
+                        break; // nothing else gets resource maps
+                }
+            }
+            // Maybe it's a demo map?
+            else if(reinterpret_cast<Invader::HEK::CacheFileDemoHeader *>(&header)->valid()) {
+                bitmaps = open_map_possibly("bitmaps.map");
+                sounds = open_map_possibly("sounds.map");
             }
         }
-        // Maybe it's a demo map?
-        else if(reinterpret_cast<Invader::HEK::CacheFileDemoHeader *>(&header)->valid()) {
-            bitmaps = open_map_possibly("bitmaps.map");
-            sounds = open_map_possibly("sounds.map");
+
+        // Load map
+        try {
+            auto file = File::open_file(map_path).value();
+            return std::make_unique<Map>(Map::map_with_move(std::move(file), std::move(bitmaps), std::move(loc), std::move(sounds)));
+        }
+        catch (std::exception &e) {
+            eprintf_error("Failed to parse %s: %s", map_path, e.what());
+            return nullptr;
         }
+    };
+
+    // If there's more than one map, only save each tag once and keep track of which maps have which version of each tag
+    std::unique_ptr<ExtractionWorkload::BulkExtraction> bulk;
+    if(remaining_arguments.size() > 1 || extract_options.manifest.has_value()) {
+        bulk = std::make_unique<ExtractionWorkload::BulkExtraction>();
     }
 
-    // Load map
-    std::unique_ptr<Map> map;
-    try {
-        auto file = File::open_file(remaining_arguments[0]).value();
-        map = std::make_unique<Map>(Map::map_with_move(std::move(file), std::move(bitmaps), std::move(loc), std::move(sounds)));
+    bool success = true;
+    std::size_t maps_loaded = 0;
+    for(auto *map_path : remaining_arguments) {
+        auto map = load_map(map_path);
+        if(!map) {
+            success = false;
+            if(!bulk) {
+                break;
+            }
+            continue;
+        }
+        maps_loaded++;
+        
+        if(bulk) {
+            oprintf("Extracting %s\n", map_path);
+            bulk->begin_map(map_path);
+        }
+        ExtractionWorkload::extract_map(*map, *extract_options.tags_directory, extract_options.search_queries, extract_options.search_queries_exclude, extract_options.recursive, extract_options.overwrite, extract_options.non_mp_globals, ErrorHandler::ReportingLevel::REPORTING_LEVEL_ALL, extract_options.max_threads, sink, bulk.get());
     }
-    catch (std::exception &e) {
-        eprintf_error("Failed to parse %s: %s", remaining_arguments[0], e.what());
+
+    // If no map could be loaded, nothing was extracted, so don't save anything
+    if(maps_loaded == 0) {
+        #ifdef INVADER_EXTRACT_ARCHIVE
+        if(archive) {
+            archive_write_fail(archive);
+            archive_write_free(archive);
+            std::error_code ec;
+            std::filesystem::remove(*extract_options.archive, ec);
+        }
+        #endif
         return EXIT_FAILURE;
     }
 
-    ExtractionWorkload::extract_map(*map, *extract_options.tags_directory, extract_options.search_queries, extract_options.search_queries_exclude, extract_options.recursive, extract_options.overwrite, extract_options.non_mp_globals);
+    #ifdef INVADER_EXTRACT_ARCHIVE
+    // Save and close
+    if(archive) {
+        const auto &archive_path = *extract_options.archive;
+        bool closed = archive_write_close(archive) == ARCHIVE_OK;
+        if(!closed) {
+            eprintf_error("Failed to save %s: %s", archive_path.c_str(), archive_error_string(archive));
+            success = false;
+        }
+        else {
+            oprintf("Saved %s\n", archive_path.c_str());
+        }
+        archive_write_free(archive);
+    }
+    #endif
+
+    if(bulk) {
+        auto duplicates = bulk->get_duplicates();
+        auto conflicts = bulk->get_conflicts();
+        if(conflicts) {
+            oprintf_success_warn("Skipped %zu duplicate tag%s and %zu conflicting tag%s", duplicates, duplicates == 1 ? "" : "s", conflicts, conflicts == 1 ? "" : "s");
+        }
+        else {
+            oprintf_success("Skipped %zu duplicate tag%s", duplicates, duplicates == 1 ? "" : "s");
+        }
+        
+        if(extract_options.manifest.has_value() && !bulk->write_manifest(*extract_options.manifest)) {
+            eprintf_error("Failed to write the manifest to %s", extract_options.manifest->c_str());
+            success = false;
+        }
+    }
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
 }
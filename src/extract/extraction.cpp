@@ -1,13 +1,17 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <condition_variable>
+#include <mutex>
 #include <regex>
+#include <thread>
 #include <invader/build/build_workload.hpp>
+#include <invader/crc/hash.hpp>
 #include <invader/extract/extraction.hpp>
 #include <invader/tag/hek/header.hpp>
 #include <invader/tag/parser/parser.hpp>
 
 namespace Invader {
-    void ExtractionWorkload::extract_map(const Map &map, const std::string &tags, const std::vector<std::string> &queries, const std::vector<std::string> &queries_exclude, bool recursive, bool overwrite, bool non_mp_globals, ReportingLevel reporting_level) {
+    void ExtractionWorkload::extract_map(const Map &map, const std::string &tags, const std::vector<std::string> &queries, const std::vector<std::string> &queries_exclude, bool recursive, bool overwrite, bool non_mp_globals, ReportingLevel reporting_level, std::size_t threads, TagSink *sink, BulkExtraction *bulk) {
         // There's no need to extract recursively if we're extracting all tags
         if(queries.size() == 0) {
             recursive = false;
@@ -15,7 +19,7 @@ namespace Invader {
         
         ExtractionWorkload workload(map, reporting_level);
         auto start = std::chrono::steady_clock::now();
-        auto success = workload.perform_extraction(queries, queries_exclude, tags, recursive, overwrite, non_mp_globals);
+        auto success = workload.perform_extraction(queries, queries_exclude, tags, recursive, overwrite, non_mp_globals, threads, sink, bulk);
         auto matched = workload.matched_tags.size();
         auto warnings = workload.get_warnings();
         auto errors = workload.get_errors();
@@ -47,20 +51,17 @@ namespace Invader {
         }
     }
     
-    std::size_t ExtractionWorkload::perform_extraction(const std::vector<std::string> &queries, const std::vector<std::string> &queries_exclude, const std::filesystem::path &tags, bool recursive, bool overwrite, bool non_mp_globals) {
+    std::size_t ExtractionWorkload::perform_extraction(const std::vector<std::string> &queries, const std::vector<std::string> &queries_exclude, const std::filesystem::path &tags, bool recursive, bool overwrite, bool non_mp_globals, std::size_t threads, TagSink *sink, BulkExtraction *bulk) {
         // Set these variables up
         auto *map = &this->map;
         auto type = map->get_type();
         auto tag_count = map->get_tag_count();
-        std::vector<bool> extracted_tags(tag_count);
+        std::vector<std::uint8_t> extracted_tags(tag_count);
         std::deque<std::size_t> all_tags_to_extract;
         auto &workload = *this;
         auto engine = map->get_cache_version();
 
-        auto extract_tag = [&extracted_tags, &map, &tags, &all_tags_to_extract, &type, &recursive, &overwrite, &non_mp_globals, &workload, &engine](std::size_t tag_index) -> bool {
-            // Do it
-            extracted_tags[tag_index] = true;
-
+        auto extract_tag = [&map, &tags, &type, &recursive, &overwrite, &non_mp_globals, &workload, &engine, &sink, &bulk](std::size_t tag_index, std::vector<std::size_t> &dependencies_found) -> bool {
             // Get the tag path
             const auto &tag = map->get_tag(tag_index);
             if(!tag.data_is_available()) {
@@ -80,9 +81,10 @@ namespace Invader {
             auto tfp = File::TagFilePath(Invader::File::halo_path_to_preferred_path(tag_path), tag.get_tag_fourcc());
 
             // Figure out the path we're writing to
-            auto tag_path_to_write_to = Invader::File::tag_path_to_file_path(tfp, tags);
+            auto tag_path_to_write_to = Invader::File::tag_path_to_file_path(tfp, sink ? std::filesystem::path() : tags);
 
-            if(!overwrite && std::filesystem::exists(tag_path_to_write_to)) {
+            // If we're extracting multiple maps, tags saved from a previous map are checked after they're extracted
+            if(!sink && !overwrite && std::filesystem::exists(tag_path_to_write_to) && !(bulk && bulk->contains(tfp.join()))) {
                 return false;
             }
 
@@ -109,8 +111,8 @@ namespace Invader {
                     }
                     for(auto &d : dependencies) {
                         auto tag_index = map->find_tag(d.first->c_str(), d.second);
-                        if(tag_index.has_value() && extracted_tags[*tag_index] == false) {
-                            all_tags_to_extract.push_back(*tag_index);
+                        if(tag_index.has_value()) {
+                            dependencies_found.push_back(*tag_index);
                         }
                     }
                 }
@@ -195,6 +197,29 @@ namespace Invader {
                 }
             }
 
+            // If we're extracting multiple maps, only save the first version of each tag
+            if(bulk) {
+                std::string conflict_map;
+                switch(bulk->add_tag(tfp.join(), fnv1a_64(new_tag), conflict_map)) {
+                    case BulkExtraction::ADD_RESULT_SAVE:
+                        break;
+                    case BulkExtraction::ADD_RESULT_DUPLICATE:
+                        return false;
+                    case BulkExtraction::ADD_RESULT_CONFLICT:
+                        REPORT_ERROR_PRINTF(workload, ERROR_TYPE_WARNING, tag_index, "Tag differs from the one extracted from %s, so it was not saved", conflict_map.c_str());
+                        return false;
+                }
+            }
+
+            // Send it to the sink if we have one
+            if(sink) {
+                if(!sink->write_tag(tag_path_to_write_to, new_tag)) {
+                    REPORT_ERROR_PRINTF(workload, ERROR_TYPE_ERROR, tag_index, "Failed to save %s", tag_path_to_write_to.string().c_str());
+                    return false;
+                }
+                return true;
+            }
+
             // Create directories along the way
             std::error_code ec;
             std::filesystem::create_directories(tag_path_to_write_to.parent_path(), ec);
@@ -234,37 +259,75 @@ namespace Invader {
             }
         }
 
-        // Extract tags
-        std::size_t total = 0;
+        // Extract tags. Each thread takes the next tag in the queue, and dependencies found by recursive extraction are added to the end of it.
         std::size_t extracted = 0;
-        while(all_tags_to_extract.size() > 0) {
-            std::size_t tag = all_tags_to_extract[0];
-            all_tags_to_extract.erase(all_tags_to_extract.begin());
-            if(extracted_tags[tag]) {
-                continue;
-            }
-            const auto &tag_map = map->get_tag(tag);
-            auto path_dot = File::TagFilePath(File::halo_path_to_preferred_path(tag_map.get_path()), tag_map.get_tag_fourcc());
-            
-            // Do it!
-            bool result;
-            try {
-                result = extract_tag(tag);
-            }
-            catch(std::exception &e) {
-                eprintf_error("Error while extracting %s: %s", path_dot.join().c_str(), e.what());
-                result = false;
-            }
-            if(result) {
-                oprintf_success("Extracted %s", path_dot.join().c_str());
-                extracted++;
-            }
-            else {
-                oprintf("Skipped %s\n", path_dot.join().c_str());
+        std::size_t tags_in_progress = 0;
+        std::mutex queue_mutex;
+        std::condition_variable queue_cv;
+        
+        auto extract_tags = [&all_tags_to_extract, &extracted_tags, &extracted, &tags_in_progress, &queue_mutex, &queue_cv, &map, &extract_tag]() {
+            while(true) {
+                std::size_t tag;
+                {
+                    std::unique_lock lock(queue_mutex);
+                    queue_cv.wait(lock, [&all_tags_to_extract, &tags_in_progress]() { return !all_tags_to_extract.empty() || tags_in_progress == 0; });
+                    if(all_tags_to_extract.empty()) {
+                        return;
+                    }
+                    tag = all_tags_to_extract.front();
+                    all_tags_to_extract.pop_front();
+                    if(extracted_tags[tag]) {
+                        continue;
+                    }
+                    extracted_tags[tag] = true;
+                    tags_in_progress++;
+                }
+                
+                // Do it! If the tag can't even be read, it's still reported by its index (and the other threads are still let go).
+                std::string tag_name = "tag #" + std::to_string(tag);
+                bool result;
+                std::vector<std::size_t> dependencies_found;
+                try {
+                    const auto &tag_map = map->get_tag(tag);
+                    tag_name = File::TagFilePath(File::halo_path_to_preferred_path(tag_map.get_path()), tag_map.get_tag_fourcc()).join();
+                    result = extract_tag(tag, dependencies_found);
+                }
+                catch(std::exception &e) {
+                    eprintf_error("Error while extracting %s: %s", tag_name.c_str(), e.what());
+                    result = false;
+                }
+                
+                {
+                    std::scoped_lock lock(queue_mutex);
+                    if(result) {
+                        oprintf_success("Extracted %s", tag_name.c_str());
+                        extracted++;
+                    }
+                    else {
+                        oprintf("Skipped %s\n", tag_name.c_str());
+                    }
+                    for(auto d : dependencies_found) {
+                        if(!extracted_tags[d]) {
+                            all_tags_to_extract.push_back(d);
+                        }
+                    }
+                    tags_in_progress--;
+                }
+                queue_cv.notify_all();
             }
+        };
+        
+        std::vector<std::thread> extraction_threads;
+        threads = std::max(threads, static_cast<std::size_t>(1));
+        extraction_threads.reserve(threads - 1);
+        for(std::size_t i = 1; i < threads; i++) {
+            extraction_threads.emplace_back(extract_tags);
+        }
+        extract_tags();
+        for(auto &t : extraction_threads) {
+            t.join();
         }
         
-        this->matched_tags.reserve(total);
         for(std::size_t i = 0; i < tag_count; i++) {
             if(extracted_tags[i]) {
                 this->matched_tags.push_back(i);
@@ -274,6 +337,69 @@ namespace Invader {
         return extracted;
     }
     
+    void ExtractionWorkload::BulkExtraction::begin_map(const std::string &map_name) {
+        std::scoped_lock lock(this->mutex);
+        this->map_names.emplace_back(map_name);
+    }
+    
+    bool ExtractionWorkload::BulkExtraction::contains(const std::string &tag_path) const {
+        std::scoped_lock lock(this->mutex);
+        return this->tags.find(tag_path) != this->tags.end();
+    }
+    
+    ExtractionWorkload::BulkExtraction::AddResult ExtractionWorkload::BulkExtraction::add_tag(const std::string &tag_path, std::uint64_t hash, std::string &conflict_map) {
+        std::scoped_lock lock(this->mutex);
+        std::size_t map_index = this->map_names.empty() ? 0 : this->map_names.size() - 1;
+        if(this->map_names.empty()) {
+            this->map_names.emplace_back();
+        }
+        
+        auto &versions = this->tags[tag_path];
+        for(auto &v : versions) {
+            if(v.hash == hash) {
+                v.maps.push_back(map_index);
+                if(v.saved) {
+                    this->duplicates++;
+                    return AddResult::ADD_RESULT_DUPLICATE;
+                }
+                this->conflicts++;
+                conflict_map = this->map_names[versions[0].maps[0]];
+                return AddResult::ADD_RESULT_CONFLICT;
+            }
+        }
+        
+        // The first version found is the one that gets saved
+        bool save = versions.empty();
+        versions.emplace_back(TagVersion { hash, save, { map_index } });
+        if(save) {
+            return AddResult::ADD_RESULT_SAVE;
+        }
+        this->conflicts++;
+        conflict_map = this->map_names[versions[0].maps[0]];
+        return AddResult::ADD_RESULT_CONFLICT;
+    }
+    
+    bool ExtractionWorkload::BulkExtraction::write_manifest(const std::filesystem::path &path) const {
+        std::scoped_lock lock(this->mutex);
+        std::FILE *f = std::fopen(path.string().c_str(), "w");
+        if(!f) {
+            return false;
+        }
+        
+        // One line per version of each tag: path, hash, whether it was saved, then every map that has it
+        for(auto &[tag_path, versions] : this->tags) {
+            for(auto &v : versions) {
+                std::fprintf(f, "%s\t%016llx\t%s", File::halo_path_to_preferred_path(tag_path).c_str(), static_cast<unsigned long long>(v.hash), v.saved ? "saved" : "conflict");
+                for(auto m : v.maps) {
+                    std::fprintf(f, "\t%s", this->map_names[m].c_str());
+                }
+                std::fprintf(f, "\n");
+            }
+        }
+        
+        return std::fclose(f) == 0;
+    }
+    
     ExtractionWorkload::ExtractionWorkload(const Map &map, ReportingLevel reporting_level) : ErrorHandler(reporting_level), map(map) {
         auto &paths = this->get_tag_paths();
         auto tag_count = map.get_tag_count();
@@ -2,16 +2,39 @@
 
 #ifdef _WIN32
 #include <windows.h>
+#include <process.h>
+#include <io.h>
+#include <share.h>
+#else
+#include <unistd.h>
 #endif
 
+#include <fcntl.h>
+#include <sys/stat.h>
+
 #include <invader/file/file.hpp>
 #include <invader/error.hpp>
 #include <invader/printf.hpp>
+#include <invader/crc/hash.hpp>
+#include "tags_manifest.hpp"
 
 #include <cstdio>
 #include <filesystem>
 #include <cstring>
 #include <climits>
+#include <cctype>
+#include <cerrno>
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#ifndef _WIN32
+#include <dirent.h>
+#endif
 
 namespace Invader::File {
     std::optional<std::vector<std::byte>> open_file(const std::filesystem::path &path) {
@@ -93,6 +116,77 @@ namespace Invader::File {
         return true;
     }
     
+    std::FILE *open_temp_file(const std::filesystem::path &path, std::filesystem::path &temp_path) {
+        #ifdef _WIN32
+        auto pid = static_cast<unsigned long>(_getpid());
+        #else
+        auto pid = static_cast<unsigned long>(getpid());
+        #endif
+
+        // Create the file exclusively through the OS (not every C runtime supports fopen's "x" mode), so if we somehow pick a name that's in use, just pick another one
+        thread_local std::mt19937_64 random(std::random_device{}() ^ std::hash<std::thread::id>()(std::this_thread::get_id()));
+        for(int attempt = 0; attempt < 16; attempt++) {
+            char suffix[64];
+            std::snprintf(suffix, sizeof(suffix), ".%lu.%016llx.tmp", pid, static_cast<unsigned long long>(random()));
+            temp_path = path;
+            temp_path += suffix;
+            
+            #ifdef _WIN32
+            int fd = -1;
+            errno = _wsopen_s(&fd, temp_path.c_str(), _O_CREAT | _O_EXCL | _O_BINARY | _O_WRONLY, _SH_DENYNO, _S_IREAD | _S_IWRITE);
+            #else
+            int fd = open(temp_path.string().c_str(), O_CREAT | O_EXCL | O_WRONLY, 0666);
+            #endif
+            
+            if(fd == -1) {
+                if(errno != EEXIST) {
+                    break;
+                }
+                continue;
+            }
+            
+            #ifdef _WIN32
+            auto *f = _fdopen(fd, "wb");
+            if(!f) {
+                _close(fd);
+            }
+            #else
+            auto *f = fdopen(fd, "wb");
+            if(!f) {
+                close(fd);
+            }
+            #endif
+            
+            if(!f) {
+                std::error_code ec;
+                std::filesystem::remove(temp_path, ec);
+            }
+            return f;
+        }
+        return nullptr;
+    }
+
+    bool save_file_atomically(const std::filesystem::path &path, const std::vector<std::byte> &data) {
+        std::filesystem::path temp_path;
+        std::FILE *f = open_temp_file(path, temp_path);
+        if(!f) {
+            return false;
+        }
+
+        bool success = data.empty() || std::fwrite(data.data(), data.size(), 1, f) == 1;
+        success = (std::fclose(f) == 0) && success;
+
+        std::error_code ec;
+        if(success) {
+            std::filesystem::rename(temp_path, path, ec);
+            success = !ec;
+        }
+        if(!success) {
+            std::filesystem::remove(temp_path, ec);
+        }
+        return success;
+    }
+
     std::optional<std::filesystem::path> tag_path_to_file_path(const std::string &tag_path, const std::vector<std::filesystem::path> &tags) {
         for(auto &i : tags) {
             auto path = tag_path_to_file_path(tag_path, i);
@@ -289,148 +383,470 @@ namespace Invader::File {
         }
     }
 
-    std::vector<TagFile> load_virtual_tag_folder(const std::vector<std::filesystem::path> &tags, bool filter_duplicates, std::pair<std::mutex, std::size_t> *status, std::size_t *errors) {
-        std::vector<TagFile> all_tags;
+    std::filesystem::path tags_manifest_path(const std::filesystem::path &tags_directory) {
+        std::error_code ec;
+        auto directory = std::filesystem::absolute(tags_directory, ec);
+        if(ec) {
+            directory = tags_directory;
+        }
+        auto path = remove_trailing_slashes(directory.lexically_normal().string());
+        if(path.empty()) {
+            path = std::filesystem::path("/").make_preferred().string();
+        }
+        return path + ".invader-manifest";
+    }
+    
+    std::optional<std::uint64_t> get_recorded_tag_file_hash(const TagFile &tag) {
+        if(!tag.content_hash.has_value()) {
+            return std::nullopt;
+        }
         
-        std::size_t new_errors = 0;
-
-        std::pair<std::mutex, std::size_t> status_r;
-        if(status == nullptr) {
-            status = &status_r;
+        std::error_code size_ec, modified_ec;
+        auto size = std::filesystem::file_size(tag.full_path, size_ec);
+        auto modified = std::filesystem::last_write_time(tag.full_path, modified_ec);
+        if(size_ec || modified_ec || size != tag.size || TagsManifest::manifest_time(modified) != tag.modified) {
+            return std::nullopt;
+        }
+        return tag.content_hash;
+    }
+    
+    std::optional<std::uint64_t> get_tag_file_hash(TagFile &tag, std::vector<std::byte> *data_read) {
+        // If we know the hash and the tag hasn't changed since, use it
+        auto recorded = get_recorded_tag_file_hash(tag);
+        if(recorded.has_value()) {
+            return recorded;
+        }
+        
+        // Otherwise, get the size and modification time before reading it so a change made while it's being read is noticed next time
+        std::error_code size_ec, modified_ec;
+        auto size = std::filesystem::file_size(tag.full_path, size_ec);
+        auto modified = std::filesystem::last_write_time(tag.full_path, modified_ec);
+        auto data = open_file(tag.full_path);
+        if(size_ec || modified_ec || !data.has_value()) {
+            return std::nullopt;
         }
-        status->first.lock();
-        status->second = 0;
-        status->first.unlock();
         
-        #define maybe_iterate_directories(file_path, ...) try { \
-            iterate_directories(__VA_ARGS__); \
-        } \
-        catch(std::exception &e) { \
-            eprintf_error("Error listing %s: %s", file_path.string().c_str(), e.what()); \
-            new_errors++; \
+        tag.size = size;
+        tag.modified = TagsManifest::manifest_time(modified);
+        tag.content_hash = fnv1a_64(*data);
+        if(data_read) {
+            *data_read = std::move(*data);
         }
+        return tag.content_hash;
+    }
+    
+    void save_tag_file_hashes(const std::vector<std::filesystem::path> &tags, const std::vector<TagFile> &tag_files) {
+        // Anything modified very recently may still be changing, so it isn't recorded (the same as when walking)
+        auto recent = TagsManifest::manifest_time(std::filesystem::file_time_type::clock::now() - std::chrono::seconds(2));
         
-        // win32 implementation because Windows I/O is AWFUL
-        #ifdef _WIN32
-        auto iterate_directories = [&all_tags, &status, &new_errors](const std::filesystem::path &dir, auto &iterate_directories, int depth, std::size_t priority, const std::vector<std::filesystem::path> &main_dir) -> void {
-            if(++depth == 256) {
-                return;
-            }
-            
-            WIN32_FIND_DATA find_data;
-            HANDLE file = FindFirstFileA((dir / "*").string().c_str(), &find_data);
-            bool found = file != nullptr;
+        for(std::size_t i = 0; i < tags.size(); i++) {
+            std::optional<TagsManifest::Manifest> manifest;
+            std::unordered_map<std::string, TagsManifest::Entry *> entries;
+            bool changed = false;
             
-            std::size_t tags_found = 0;
-            
-            while(found) {
-                if(std::strcmp(find_data.cFileName, ".") != 0 && std::strcmp(find_data.cFileName, "..") != 0) {
-                    auto file_path = dir / find_data.cFileName;
-                    if(find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
-                        maybe_iterate_directories(file_path, file_path, iterate_directories, depth, priority, main_dir);
+            for(auto &tag : tag_files) {
+                if(tag.tag_directory != i || !tag.content_hash.has_value() || tag.modified == 0 || tag.modified >= recent) {
+                    continue;
+                }
+                
+                // Load the manifest only if there is something to record
+                if(!manifest.has_value()) {
+                    manifest = TagsManifest::load_manifest(tags_manifest_path(tags[i]));
+                    if(!manifest.has_value()) {
+                        break;
                     }
-                    else {
-                        auto extension = file_path.extension().string();
-                        auto tag_fourcc = HEK::tag_extension_to_fourcc(extension.c_str() + 1);
-
-                        // First, make sure it's valid
-                        if(tag_fourcc == HEK::TagFourCC::TAG_FOURCC_NULL || tag_fourcc == HEK::TagFourCC::TAG_FOURCC_NONE) {
-                            goto spaghetti_next_tag;
+                    for(auto &[directory_path, directory] : *manifest) {
+                        for(auto &entry : directory.entries) {
+                            if(!entry.is_directory) {
+                                entries.emplace(directory_path.empty() ? entry.name : directory_path + "/" + entry.name, &entry);
+                            }
                         }
-
-                        // Next, add it
-                        TagFile file;
-                        file.full_path = file_path;
-                        file.tag_fourcc = tag_fourcc;
-                        file.tag_directory = priority;
-                        file.tag_path = Invader::File::file_path_to_tag_path(file_path.string(), main_dir).value();
-                        all_tags.emplace_back(std::move(file));
-                        
-                        tags_found++;
                     }
                 }
                 
-                spaghetti_next_tag:
-                found = FindNextFileA(file, &find_data);
+                auto entry = entries.find(std::filesystem::path(tag.tag_path).generic_string());
+                if(entry == entries.end()) {
+                    continue;
+                }
+                
+                auto &e = *entry->second;
+                if(e.size != tag.size || e.modified != tag.modified || e.content_hash != tag.content_hash) {
+                    e.size = tag.size;
+                    e.modified = tag.modified;
+                    e.content_hash = tag.content_hash;
+                    changed = true;
+                }
             }
             
-            // Update the find count
-            if(tags_found) {
-                status->first.lock();
-                status->second += tags_found;
-                status->first.unlock();
+            if(changed) {
+                auto manifest_path = tags_manifest_path(tags[i]);
+                if(!TagsManifest::save_manifest(manifest_path, *manifest)) {
+                    eprintf_warn("Failed to save the tags manifest %s", manifest_path.string().c_str());
+                }
             }
+        }
+    }
+
+    namespace {
+        // A directory being walked by load_virtual_tag_folder()
+        struct WalkDirectory {
+            std::filesystem::path path;
+            std::filesystem::path relative_path;
+            std::size_t priority;
+            int depth;
+            
+            // Manifest of the tags directory this is in, if it has one
+            const TagsManifest::Manifest *manifest = nullptr;
+            
+            // Modification time of the directory (0 if it couldn't be listed or there is no manifest)
+            std::int64_t modified = 0;
+            
+            // The directory was listed rather than taken from the manifest
+            bool listed = false;
+            
+            // Everything found in the directory in the order it was listed; a subdirectory is an entry with a directory set
+            struct Entry {
+                TagFile file;
+                std::unique_ptr<WalkDirectory> directory;
+            };
+            std::vector<Entry> entries;
         };
-        #else
-        auto iterate_directories = [&all_tags, &status, &new_errors](const std::filesystem::path &dir, auto &iterate_directories, int depth, std::size_t priority, const std::vector<std::filesystem::path> &main_dir) -> void {
-            if(++depth == 256) {
-                return;
+        
+        // Something found when listing a directory
+        struct ListedFile {
+            std::string name;
+            bool is_directory;
+            bool is_regular_file;
+        };
+        
+        // List a directory. Throws on failure.
+        std::vector<ListedFile> list_directory(const std::filesystem::path &dir) {
+            std::vector<ListedFile> files;
+            
+            // win32 implementation because Windows I/O is AWFUL
+            #ifdef _WIN32
+            WIN32_FIND_DATA find_data;
+            HANDLE file = FindFirstFileA((dir / "*").string().c_str(), &find_data);
+            if(file == INVALID_HANDLE_VALUE) {
+                throw std::filesystem::filesystem_error("directory iterator cannot open directory", dir, std::error_code(static_cast<int>(GetLastError()), std::system_category()));
             }
             
-            std::size_t tags_found = 0;
-
-            for(auto &d : std::filesystem::directory_iterator(dir)) {
-                auto file_path = d.path();
+            do {
+                if(std::strcmp(find_data.cFileName, ".") != 0 && std::strcmp(find_data.cFileName, "..") != 0) {
+                    bool is_directory = find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY;
+                    files.emplace_back(ListedFile { find_data.cFileName, is_directory, !is_directory });
+                }
+            }
+            while(FindNextFileA(file, &find_data));
+            FindClose(file);
+            
+            #else
+            DIR *d = opendir(dir.string().c_str());
+            if(!d) {
+                throw std::filesystem::filesystem_error("directory iterator cannot open directory", dir, std::error_code(errno, std::generic_category()));
+            }
+            
+            while(auto *entry = readdir(d)) {
+                if(std::strcmp(entry->d_name, ".") == 0 || std::strcmp(entry->d_name, "..") == 0) {
+                    continue;
+                }
                 
-                if(d.is_directory()) {
-                    maybe_iterate_directories(file_path, d, iterate_directories, depth, priority, main_dir);
+                // Use the type from the directory entry if we can so we don't need to stat everything; symlinks and filesystems that don't give us the type still need it, though
+                ListedFile file = { entry->d_name, false, false };
+                #ifdef _DIRENT_HAVE_D_TYPE
+                if(entry->d_type == DT_DIR) {
+                    file.is_directory = true;
                 }
-                else if(file_path.has_extension() && std::filesystem::is_regular_file(file_path)) {
-                    auto extension = file_path.extension().string();
-                    auto tag_fourcc = HEK::tag_extension_to_fourcc(extension.c_str() + 1);
-
-                    // First, make sure it's valid
-                    if(tag_fourcc == HEK::TagFourCC::TAG_FOURCC_NULL || tag_fourcc == HEK::TagFourCC::TAG_FOURCC_NONE) {
-                        continue;
-                    }
-
-                    // Next, add it
-                    TagFile file;
-                    file.full_path = file_path;
-                    file.tag_fourcc = tag_fourcc;
-                    file.tag_directory = priority;
-                    file.tag_path = Invader::File::file_path_to_tag_path(file_path.string(), main_dir).value();
-                    all_tags.emplace_back(std::move(file));
-                    tags_found++;
+                else if(entry->d_type == DT_REG) {
+                    file.is_regular_file = true;
+                }
+                else if(entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN)
+                #endif
+                {
+                    std::error_code ec;
+                    auto status = std::filesystem::status(dir / file.name, ec);
+                    file.is_directory = std::filesystem::is_directory(status);
+                    file.is_regular_file = std::filesystem::is_regular_file(status);
                 }
+                files.emplace_back(std::move(file));
             }
+            closedir(d);
+            #endif
             
-            // Update the find count
-            if(tags_found) {
-                status->first.lock();
-                status->second += tags_found;
-                status->first.unlock();
-            }
-        };
-        #endif
+            return files;
+        }
+    }
 
-        // Go through each directory
+    std::vector<TagFile> load_virtual_tag_folder(const std::vector<std::filesystem::path> &tags, bool filter_duplicates, std::pair<std::mutex, std::size_t> *status, std::size_t *errors) {
+        std::pair<std::mutex, std::size_t> status_r;
+        if(status == nullptr) {
+            status = &status_r;
+        }
+        status->first.lock();
+        status->second = 0;
+        status->first.unlock();
+        
+        // Start with each tags directory
         std::size_t dir_count = tags.size();
+        std::vector<std::unique_ptr<WalkDirectory>> roots;
+        std::vector<std::optional<TagsManifest::Manifest>> manifests(dir_count);
+        roots.reserve(dir_count);
         for(std::size_t i = 0; i < dir_count; i++) {
-            auto d = std::filesystem::path(remove_trailing_slashes(tags[i].string()));
-            maybe_iterate_directories(d, d, iterate_directories, 0, i, std::vector<std::filesystem::path>(&d, &d + 1));
+            auto &root = roots.emplace_back(std::make_unique<WalkDirectory>());
+            root->path = std::filesystem::path(remove_trailing_slashes(tags[i].string()));
+            root->priority = i;
+            root->depth = 1;
+            
+            // If there's a manifest, only directories that changed since it was saved need to be listed
+            manifests[i] = TagsManifest::load_manifest(tags_manifest_path(tags[i]));
+            if(manifests[i].has_value()) {
+                root->manifest = &*manifests[i];
+            }
         }
+        auto walk_start = std::filesystem::file_time_type::clock::now();
         
-        // Remove duplicates
-        if(filter_duplicates) {
-            for(std::size_t i = 0; i < all_tags.size(); i++) {
-                for(std::size_t j = 0; j < i; j++) {
-                    auto &tagi = all_tags[i];
-                    auto &tagj = all_tags[j];
+        // Directories are listed on all threads. Any thread can take any directory that has been found but not listed yet.
+        std::mutex queue_mutex;
+        std::condition_variable queue_cv;
+        std::vector<WalkDirectory *> queue;
+        std::size_t directories_in_progress = 0;
+        std::size_t new_errors = 0;
+        for(auto &r : roots) {
+            queue.emplace_back(r.get());
+        }
+        
+        auto walk = [&queue_mutex, &queue_cv, &queue, &directories_in_progress, &new_errors, &status]() {
+            while(true) {
+                // Take a directory, or leave if there won't be any more
+                WalkDirectory *dir;
+                {
+                    std::unique_lock lock(queue_mutex);
+                    queue_cv.wait(lock, [&queue, &directories_in_progress]() { return !queue.empty() || directories_in_progress == 0; });
+                    if(queue.empty()) {
+                        return;
+                    }
+                    dir = queue.back();
+                    queue.pop_back();
+                    directories_in_progress++;
+                }
+                
+                std::vector<WalkDirectory *> subdirectories;
+                std::size_t tags_found = 0;
+                
+                auto add_subdirectory = [&dir, &subdirectories](const std::string &name) {
+                    if(dir->depth + 1 == 256) {
+                        return;
+                    }
                     
-                    if(tagi.tag_fourcc == tagj.tag_fourcc && tagi.tag_path == tagj.tag_path) {
-                        if(tagi.tag_directory > tagj.tag_directory) {
-                            all_tags.erase(all_tags.begin() + i);
+                    auto &subdirectory = dir->entries.emplace_back().directory;
+                    subdirectory = std::make_unique<WalkDirectory>();
+                    subdirectory->path = dir->path / name;
+                    subdirectory->relative_path = dir->relative_path.empty() ? std::filesystem::path(name) : dir->relative_path / name;
+                    subdirectory->priority = dir->priority;
+                    subdirectory->depth = dir->depth + 1;
+                    subdirectory->manifest = dir->manifest;
+                    subdirectories.emplace_back(subdirectory.get());
+                };
+                
+                auto add_tag = [&dir, &tags_found](const std::string &name, HEK::TagFourCC tag_fourcc) -> TagFile & {
+                    auto &file = dir->entries.emplace_back().file;
+                    file.full_path = dir->path / name;
+                    file.tag_fourcc = tag_fourcc;
+                    file.tag_directory = dir->priority;
+                    file.tag_path = (dir->relative_path.empty() ? std::filesystem::path(name) : dir->relative_path / name).string();
+                    tags_found++;
+                    return file;
+                };
+                
+                // Check if the manifest has the directory as it is now
+                const TagsManifest::Directory *recorded = nullptr;
+                if(dir->manifest) {
+                    std::error_code ec;
+                    auto modified = std::filesystem::last_write_time(dir->path, ec);
+                    if(!ec) {
+                        dir->modified = TagsManifest::manifest_time(modified);
+                        auto found = dir->manifest->find(dir->relative_path.generic_string());
+                        if(found != dir->manifest->end()) {
+                            recorded = &found->second;
+                        }
+                    }
+                }
+                
+                if(recorded && recorded->modified != 0 && recorded->modified == dir->modified) {
+                    for(auto &e : recorded->entries) {
+                        if(e.is_directory) {
+                            add_subdirectory(e.name);
                         }
                         else {
-                            all_tags.erase(all_tags.begin() + j);
+                            auto &file = add_tag(e.name, e.tag_fourcc);
+                            file.size = e.size;
+                            file.modified = e.modified;
+                            file.content_hash = e.content_hash;
                         }
+                    }
+                }
+                else {
+                    try {
+                        dir->listed = true;
                         
-                        i--;
-                        break;
+                        // If the directory is in the manifest, we can keep hashes of tags that didn't change
+                        std::unordered_map<std::string_view, const TagsManifest::Entry *> recorded_tags;
+                        if(recorded) {
+                            for(auto &e : recorded->entries) {
+                                recorded_tags.emplace(e.name, &e);
+                            }
+                        }
+                        
+                        for(auto &f : list_directory(dir->path)) {
+                            if(f.is_directory) {
+                                add_subdirectory(f.name);
+                            }
+                            else if(f.is_regular_file) {
+                                auto extension = std::filesystem::path(f.name).extension().string();
+                                if(extension.empty()) {
+                                    continue;
+                                }
+                                auto tag_fourcc = HEK::tag_extension_to_fourcc(extension.c_str() + 1);
+                                
+                                // First, make sure it's valid
+                                if(tag_fourcc == HEK::TagFourCC::TAG_FOURCC_NULL || tag_fourcc == HEK::TagFourCC::TAG_FOURCC_NONE) {
+                                    continue;
+                                }
+                                
+                                // Next, add it
+                                auto &file = add_tag(f.name, tag_fourcc);
+                                
+                                // Record the size and modification time if we're keeping a manifest; tags are only hashed when something needs the hash
+                                if(dir->manifest) {
+                                    std::error_code size_ec, modified_ec;
+                                    auto size = std::filesystem::file_size(file.full_path, size_ec);
+                                    auto modified = std::filesystem::last_write_time(file.full_path, modified_ec);
+                                    if(size_ec || modified_ec) {
+                                        continue;
+                                    }
+                                    file.size = size;
+                                    file.modified = TagsManifest::manifest_time(modified);
+                                    
+                                    auto r = recorded_tags.find(f.name);
+                                    if(r != recorded_tags.end() && r->second->size == file.size && r->second->modified == file.modified) {
+                                        file.content_hash = r->second->content_hash;
+                                    }
+                                }
+                            }
+                        }
+                    }
+                    catch(std::exception &e) {
+                        eprintf_error("Error listing %s: %s", dir->path.string().c_str(), e.what());
+                        dir->modified = 0;
+                        std::scoped_lock lock(queue_mutex);
+                        new_errors++;
+                    }
+                }
+                
+                // Update the find count
+                if(tags_found) {
+                    status->first.lock();
+                    status->second += tags_found;
+                    status->first.unlock();
+                }
+                
+                // Hand off the subdirectories
+                {
+                    std::scoped_lock lock(queue_mutex);
+                    queue.insert(queue.end(), subdirectories.begin(), subdirectories.end());
+                    directories_in_progress--;
+                }
+                queue_cv.notify_all();
+            }
+        };
+        
+        std::size_t thread_count = std::max(std::thread::hardware_concurrency(), 1U);
+        std::vector<std::thread> threads;
+        threads.reserve(thread_count - 1);
+        for(std::size_t t = 1; t < thread_count; t++) {
+            threads.emplace_back(walk);
+        }
+        walk();
+        for(auto &t : threads) {
+            t.join();
+        }
+        
+        // Update the manifests if anything was listed or removed
+        for(std::size_t i = 0; i < dir_count; i++) {
+            if(!manifests[i].has_value()) {
+                continue;
+            }
+            
+            // Anything modified right before or during the walk may have been listed or read while it was still changing, so it isn't trusted next time
+            auto recent = TagsManifest::manifest_time(walk_start - std::chrono::seconds(2));
+            TagsManifest::Manifest new_manifest;
+            bool changed = false;
+            auto record = [&new_manifest, &changed, &recent](const WalkDirectory &dir, auto &record) -> void {
+                changed = changed || dir.listed;
+                auto &directory = new_manifest[dir.relative_path.generic_string()];
+                directory.modified = dir.modified >= recent ? 0 : dir.modified;
+                for(auto &e : dir.entries) {
+                    auto &entry = directory.entries.emplace_back();
+                    if(e.directory) {
+                        entry.name = e.directory->path.filename().string();
+                        entry.is_directory = true;
+                        record(*e.directory, record);
+                    }
+                    else {
+                        entry.name = e.file.full_path.filename().string();
+                        entry.tag_fourcc = e.file.tag_fourcc;
+                        entry.size = e.file.size;
+                        entry.modified = e.file.modified;
+                        if(e.file.modified < recent) {
+                            entry.content_hash = e.file.content_hash;
+                        }
                     }
                 }
+            };
+            record(*roots[i], record);
+            
+            if(changed || new_manifest.size() != manifests[i]->size()) {
+                auto manifest_path = tags_manifest_path(tags[i]);
+                if(!TagsManifest::save_manifest(manifest_path, new_manifest)) {
+                    eprintf_warn("Failed to save the tags manifest %s", manifest_path.string().c_str());
+                }
+            }
+        }
+        
+        // Put everything in the order a single thread walking each directory in turn would have found it
+        std::vector<TagFile> all_tags;
+        auto flatten = [&all_tags](WalkDirectory &dir, auto &flatten) -> void {
+            for(auto &e : dir.entries) {
+                if(e.directory) {
+                    flatten(*e.directory, flatten);
+                }
+                else {
+                    all_tags.emplace_back(std::move(e.file));
+                }
             }
+        };
+        for(auto &r : roots) {
+            flatten(*r, flatten);
+        }
+        
+        // Remove duplicates. Tags directories are walked in order of priority, so the first one found is the one that stays.
+        if(filter_duplicates) {
+            std::unordered_set<std::string> found_tags;
+            found_tags.reserve(all_tags.size());
+            std::size_t kept = 0;
+            for(std::size_t i = 0; i < all_tags.size(); i++) {
+                auto &tag = all_tags[i];
+                std::string key = tag.tag_path;
+                key += '\0';
+                key.append(reinterpret_cast<const char *>(&tag.tag_fourcc), sizeof(tag.tag_fourcc));
+                if(found_tags.insert(std::move(key)).second) {
+                    if(kept != i) {
+                        all_tags[kept] = std::move(tag);
+                    }
+                    kept++;
+                }
+            }
+            all_tags.resize(kept);
         }
         
         // Change error count if errors was specified
@@ -441,6 +857,101 @@ namespace Invader::File {
         return all_tags;
     }
 
+    // Turn a tag path into something that can be looked up regardless of which separators it uses
+    static std::string tag_directory_index_key(const std::string &tag_path) {
+        std::string key;
+        key.reserve(tag_path.size());
+        for(char c : tag_path) {
+            if(c == '\\' || c == '/' || c == INVADER_PREFERRED_PATH_SEPARATOR) {
+                // Skip duplicate slashes like the filesystem would
+                if(!key.empty() && key.back() == '\\') {
+                    continue;
+                }
+                c = '\\';
+            }
+            #ifdef _WIN32
+            // Windows paths are case insensitive
+            else {
+                c = static_cast<char>(std::tolower(c));
+            }
+            #endif
+            key += c;
+        }
+        return key;
+    }
+
+    TagDirectoryIndex::TagDirectoryIndex(const std::vector<std::filesystem::path> &tags, std::size_t *errors) : tags_directories(tags) {
+        // Tags directories that don't exist simply don't have any tags (this is what looking up each tag would do, too)
+        std::vector<std::filesystem::path> existing_directories;
+        std::vector<std::size_t> existing_directory_priority;
+        for(std::size_t i = 0; i < tags.size(); i++) {
+            std::error_code ec;
+            if(std::filesystem::is_directory(tags[i], ec)) {
+                existing_directories.emplace_back(tags[i]);
+                existing_directory_priority.emplace_back(i);
+            }
+        }
+
+        // Duplicates are filtered when building the lookup, so don't do it twice
+        this->tags = load_virtual_tag_folder(existing_directories, false, nullptr, errors);
+        for(auto &t : this->tags) {
+            t.tag_directory = existing_directory_priority[t.tag_directory];
+        }
+        this->build_lookup();
+    }
+
+    TagDirectoryIndex::TagDirectoryIndex(std::vector<TagFile> tags, const std::vector<std::filesystem::path> &tags_directories) : tags_directories(tags_directories), tags(std::move(tags)) {
+        this->build_lookup();
+    }
+
+    void TagDirectoryIndex::build_lookup() {
+        this->tags_by_path.reserve(this->tags.size());
+        bool duplicates = false;
+        for(std::size_t t = 0; t < this->tags.size(); t++) {
+            // If a tag is in here twice, the one in the higher priority tags directory wins
+            auto [it, inserted] = this->tags_by_path.try_emplace(tag_directory_index_key(this->tags[t].tag_path), t);
+            if(!inserted) {
+                duplicates = true;
+                if(this->tags[it->second].tag_directory > this->tags[t].tag_directory) {
+                    it->second = t;
+                }
+            }
+        }
+
+        // Drop the losers
+        if(duplicates) {
+            std::vector<TagFile> filtered_tags;
+            filtered_tags.reserve(this->tags_by_path.size());
+            for(std::size_t t = 0; t < this->tags.size(); t++) {
+                auto &index = this->tags_by_path.find(tag_directory_index_key(this->tags[t].tag_path))->second;
+                if(index == t) {
+                    index = filtered_tags.size();
+                    filtered_tags.emplace_back(std::move(this->tags[t]));
+                }
+            }
+            this->tags = std::move(filtered_tags);
+        }
+    }
+
+    const TagFile *TagDirectoryIndex::find_tag(const std::string &tag_path) const {
+        auto it = this->tags_by_path.find(tag_directory_index_key(tag_path));
+        if(it == this->tags_by_path.end()) {
+            return nullptr;
+        }
+        return &this->tags[it->second];
+    }
+
+    std::optional<std::filesystem::path> TagDirectoryIndex::find(const std::string &tag_path) const {
+        if(auto *tag = this->find_tag(tag_path)) {
+            return tag->full_path;
+        }
+        return std::nullopt;
+    }
+
+    std::optional<std::filesystem::path> TagDirectoryIndex::find(const TagFilePath &tag_path) const {
+        return this->find(tag_path.join());
+    }
+
     std::vector<std::string> TagFile::split_tag_path() {
         std::vector<std::string> elements;
         auto halo_path = preferred_path_to_halo_path(this->tag_path);
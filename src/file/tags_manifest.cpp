@@ -0,0 +1,142 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <cstring>
+#include <invader/file/file.hpp>
+#include <invader/hek/endian.hpp>
+#include "tags_manifest.hpp"
+
+namespace Invader::File::TagsManifest {
+    // Bump this whenever the format changes so old manifests get rebuilt
+    static constexpr std::uint32_t TAGS_MANIFEST_VERSION = 1;
+    static constexpr char TAGS_MANIFEST_MAGIC[8] = "invtagm";
+
+    struct ManifestHeader {
+        char magic[sizeof(TAGS_MANIFEST_MAGIC)];
+        HEK::LittleEndian<std::uint32_t> version;
+        HEK::LittleEndian<std::uint32_t> directory_count;
+    };
+    static_assert(sizeof(ManifestHeader) == 0x10);
+
+    struct ManifestDirectory {
+        HEK::LittleEndian<std::int64_t> modified;
+        HEK::LittleEndian<std::uint32_t> path_length;
+        HEK::LittleEndian<std::uint32_t> entry_count;
+    };
+    static_assert(sizeof(ManifestDirectory) == 0x10);
+
+    enum ManifestEntryFlags : std::uint32_t {
+        MANIFEST_ENTRY_DIRECTORY = 1,
+        MANIFEST_ENTRY_HASHED = 2
+    };
+
+    struct ManifestEntry {
+        HEK::LittleEndian<std::uint64_t> size;
+        HEK::LittleEndian<std::int64_t> modified;
+        HEK::LittleEndian<std::uint64_t> content_hash;
+        HEK::LittleEndian<std::uint32_t> tag_fourcc;
+        HEK::LittleEndian<std::uint32_t> flags;
+        HEK::LittleEndian<std::uint32_t> name_length;
+        HEK::LittleEndian<std::uint32_t> padding;
+    };
+    static_assert(sizeof(ManifestEntry) == 0x28);
+
+    std::optional<Manifest> load_manifest(const std::filesystem::path &path) {
+        std::error_code ec;
+        if(!std::filesystem::is_regular_file(path, ec)) {
+            return std::nullopt;
+        }
+        
+        auto data_maybe = File::open_file(path);
+        if(!data_maybe.has_value()) {
+            return std::nullopt;
+        }
+        auto &data = *data_maybe;
+
+        // Anything wrong with the manifest means everything gets listed again
+        Manifest manifest;
+        std::size_t offset = 0;
+        auto read = [&data, &offset](std::size_t size) -> const std::byte * {
+            if(data.size() - offset < size) {
+                return nullptr;
+            }
+            auto *r = data.data() + offset;
+            offset += size;
+            return r;
+        };
+
+        const auto *header = reinterpret_cast<const ManifestHeader *>(read(sizeof(ManifestHeader)));
+        if(!header || std::memcmp(header->magic, TAGS_MANIFEST_MAGIC, sizeof(header->magic)) != 0 || header->version != TAGS_MANIFEST_VERSION) {
+            return manifest;
+        }
+
+        std::uint32_t directory_count = header->directory_count;
+        for(std::uint32_t d = 0; d < directory_count; d++) {
+            const auto *directory = reinterpret_cast<const ManifestDirectory *>(read(sizeof(ManifestDirectory)));
+            const char *path_data = directory ? reinterpret_cast<const char *>(read(directory->path_length)) : nullptr;
+            if(!path_data) {
+                return Manifest();
+            }
+
+            Directory &d_entry = manifest[std::string(path_data, directory->path_length)];
+            d_entry.modified = directory->modified;
+            std::uint32_t entry_count = directory->entry_count;
+            for(std::uint32_t e = 0; e < entry_count; e++) {
+                const auto *entry = reinterpret_cast<const ManifestEntry *>(read(sizeof(ManifestEntry)));
+                const char *name_data = entry ? reinterpret_cast<const char *>(read(entry->name_length)) : nullptr;
+                if(!name_data) {
+                    return Manifest();
+                }
+
+                auto &e_entry = d_entry.entries.emplace_back();
+                std::uint32_t flags = entry->flags;
+                e_entry.name = std::string(name_data, entry->name_length);
+                e_entry.is_directory = flags & MANIFEST_ENTRY_DIRECTORY;
+                e_entry.tag_fourcc = static_cast<HEK::TagFourCC>(entry->tag_fourcc.read());
+                e_entry.size = entry->size;
+                e_entry.modified = entry->modified;
+                if(flags & MANIFEST_ENTRY_HASHED) {
+                    e_entry.content_hash = entry->content_hash;
+                }
+            }
+        }
+
+        return manifest;
+    }
+
+    bool save_manifest(const std::filesystem::path &path, const Manifest &manifest) {
+        std::vector<std::byte> data;
+        auto append = [&data](const void *what, std::size_t size) {
+            auto *bytes = reinterpret_cast<const std::byte *>(what);
+            data.insert(data.end(), bytes, bytes + size);
+        };
+
+        ManifestHeader header = {};
+        std::memcpy(header.magic, TAGS_MANIFEST_MAGIC, sizeof(header.magic));
+        header.version = TAGS_MANIFEST_VERSION;
+        header.directory_count = static_cast<std::uint32_t>(manifest.size());
+        append(&header, sizeof(header));
+
+        for(auto &[directory_path, directory] : manifest) {
+            ManifestDirectory d_entry = {};
+            d_entry.modified = directory.modified;
+            d_entry.path_length = static_cast<std::uint32_t>(directory_path.size());
+            d_entry.entry_count = static_cast<std::uint32_t>(directory.entries.size());
+            append(&d_entry, sizeof(d_entry));
+            append(directory_path.data(), directory_path.size());
+
+            for(auto &entry : directory.entries) {
+                ManifestEntry e_entry = {};
+                e_entry.size = entry.size;
+                e_entry.modified = entry.modified;
+                e_entry.content_hash = entry.content_hash.value_or(0);
+                e_entry.tag_fourcc = static_cast<std::uint32_t>(entry.tag_fourcc);
+                e_entry.flags = (entry.is_directory ? MANIFEST_ENTRY_DIRECTORY : 0U) | (entry.content_hash.has_value() ? MANIFEST_ENTRY_HASHED : 0U);
+                e_entry.name_length = static_cast<std::uint32_t>(entry.name.size());
+                append(&e_entry, sizeof(e_entry));
+                append(entry.name.data(), entry.name.size());
+            }
+        }
+
+        return File::save_file_atomically(path, data);
+    }
+}
@@ -0,0 +1,77 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__FILE__TAGS_MANIFEST_HPP
+#define INVADER__FILE__TAGS_MANIFEST_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <invader/hek/fourcc.hpp>
+
+namespace Invader::File::TagsManifest {
+    /**
+     * Something found in a tags directory the last time it was listed
+     */
+    struct Entry {
+        /** File name */
+        std::string name;
+
+        /** This is a directory rather than a tag */
+        bool is_directory = false;
+
+        /** Tag class of the tag */
+        HEK::TagFourCC tag_fourcc = {};
+
+        /** Size of the tag in bytes */
+        std::uint64_t size = 0;
+
+        /** Modification time of the tag */
+        std::int64_t modified = 0;
+
+        /** Content hash of the tag, if it has been hashed */
+        std::optional<std::uint64_t> content_hash;
+    };
+
+    /**
+     * A directory that was listed
+     */
+    struct Directory {
+        /** Modification time of the directory when it was listed; 0 if it should be listed again */
+        std::int64_t modified = 0;
+
+        /** Subdirectories and tags in the order they were listed */
+        std::vector<Entry> entries;
+    };
+
+    /** Directories by their path relative to the tags directory (using forward slashes, with the tags directory itself being "") */
+    using Manifest = std::unordered_map<std::string, Directory>;
+
+    /**
+     * Load a manifest
+     * @param path path to the manifest
+     * @return     manifest, or std::nullopt if there is no manifest; a manifest that can't be read is returned as empty
+     */
+    std::optional<Manifest> load_manifest(const std::filesystem::path &path);
+
+    /**
+     * Save a manifest
+     * @param path     path to the manifest
+     * @param manifest manifest to save
+     * @return         true if successful
+     */
+    bool save_manifest(const std::filesystem::path &path, const Manifest &manifest);
+
+    /**
+     * Get a modification time in the form stored in a manifest
+     * @param time time to convert
+     * @return     time
+     */
+    inline std::int64_t manifest_time(std::filesystem::file_time_type time) noexcept {
+        return static_cast<std::int64_t>(time.time_since_epoch().count());
+    }
+}
+
+#endif
@@ -1,6 +1,11 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
 #include <optional>
+#include <filesystem>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <algorithm>
 #include <invader/map/map.hpp>
 #include <invader/file/file.hpp>
 #include "../command_line_option.hpp"
@@ -18,12 +23,17 @@
 struct DisplayValue {
     const char * const name;
     void (* const calculate_value)(const Invader::Map &map);
+    
+    // If set, this can be shown with just the cache file header, so the map does not need to be loaded
+    void (* const calculate_header_value)(const Invader::Info::MapHeader &header);
 };
 
-#define MAKE_DISPLAY_VALUE(name) {# name, Invader::Info::name }
+#define MAKE_DISPLAY_VALUE(name) {# name, Invader::Info::name, nullptr }
+#define MAKE_HEADER_DISPLAY_VALUE(name) {# name, Invader::Info::name, Invader::Info::name }
 
-static std::byte header_cache[sizeof(Invader::HEK::NativeCacheFileHeader)];
-static std::size_t file_size = 0;
+// These are per-thread since multiple maps can be shown at once
+static thread_local std::byte header_cache[sizeof(Invader::HEK::NativeCacheFileHeader)];
+static thread_local std::size_t file_size = 0;
 
 // Calculating compression ratio:
 //
@@ -258,11 +268,11 @@ namespace Invader::Info {
 
 static DisplayValue all_values[] = {
     MAKE_DISPLAY_VALUE(overview),
-    MAKE_DISPLAY_VALUE(build),
+    MAKE_HEADER_DISPLAY_VALUE(build),
     MAKE_DISPLAY_VALUE(compression_ratio),
     MAKE_DISPLAY_VALUE(crc32),
     MAKE_DISPLAY_VALUE(crc32_mismatched),
-    MAKE_DISPLAY_VALUE(engine),
+    MAKE_HEADER_DISPLAY_VALUE(engine),
     
     MAKE_DISPLAY_VALUE(external_bitmaps),
     MAKE_DISPLAY_VALUE(external_bitmaps_count),
@@ -298,13 +308,13 @@ static DisplayValue all_values[] = {
     MAKE_DISPLAY_VALUE(internal_sounds_count),
     
     
-    MAKE_DISPLAY_VALUE(is_compressed),
+    MAKE_HEADER_DISPLAY_VALUE(is_compressed),
     MAKE_DISPLAY_VALUE(is_dirty),
     MAKE_DISPLAY_VALUE(is_protected),
     MAKE_DISPLAY_VALUE(languages),
     MAKE_DISPLAY_VALUE(map_type),
     MAKE_DISPLAY_VALUE(protection_issues),
-    MAKE_DISPLAY_VALUE(scenario),
+    MAKE_HEADER_DISPLAY_VALUE(scenario),
     MAKE_DISPLAY_VALUE(scenario_path),
     MAKE_DISPLAY_VALUE(stub_count),
     MAKE_DISPLAY_VALUE(tag_order_match),
@@ -314,6 +324,173 @@ static DisplayValue all_values[] = {
     MAKE_DISPLAY_VALUE(uses_external_pointers)
 };
 
+static bool show_map_value(const std::filesystem::path &path, const DisplayValue &type) {
+    using namespace Invader;
+    
+    // If we only need the header, don't bother loading the rest of the map
+    if(type.calculate_header_value) {
+        std::byte header[sizeof(HEK::CacheFileHeader)];
+        std::size_t header_size = 0;
+        if(auto *f = std::fopen(path.string().c_str(), "rb")) {
+            header_size = std::fread(header, 1, sizeof(header), f);
+            std::fclose(f);
+        }
+        
+        // If the header is bad, load the map anyway so the error is shown
+        if(auto map_header = Info::read_map_header(header, header_size)) {
+            type.calculate_header_value(*map_header);
+            return true;
+        }
+    }
+    
+    // Load it
+    try {
+        auto file = File::open_file(path).value();
+        file_size = file.size();
+        if(file_size >= sizeof(header_cache)) {
+            std::memcpy(header_cache, file.data(), sizeof(header_cache));
+        }
+        
+        auto map = Map::map_with_move(std::move(file));
+        type.calculate_value(map);
+    }
+    catch (std::exception &e) {
+        eprintf_error("Failed to parse %s: %s", path.string().c_str(), e.what());
+        return false;
+    }
+    
+    return true;
+}
+
+static void append_json_string(std::string &output, const std::string &string) {
+    output += '"';
+    for(char c : string) {
+        switch(c) {
+            case '"':
+                output += "\\\"";
+                break;
+            case '\\':
+                output += "\\\\";
+                break;
+            case '\n':
+                output += "\\n";
+                break;
+            default:
+                if(static_cast<unsigned char>(c) < 0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04X", static_cast<unsigned char>(c));
+                    output += escaped;
+                }
+                else {
+                    output += c;
+                }
+                break;
+        }
+    }
+    output += '"';
+}
+
+static bool show_directory_values(const std::filesystem::path &directory, const DisplayValue &type, std::size_t max_threads) {
+    using namespace Invader;
+    
+    // Find all of the maps, sorted so the output is always in the same order
+    std::vector<std::filesystem::path> maps;
+    try {
+        for(auto &entry : std::filesystem::recursive_directory_iterator(directory)) {
+            if(entry.is_regular_file() && entry.path().extension() == ".map") {
+                maps.emplace_back(entry.path());
+            }
+        }
+    }
+    catch(std::exception &e) {
+        eprintf_error("Failed to list %s: %s", directory.string().c_str(), e.what());
+        return false;
+    }
+    std::sort(maps.begin(), maps.end());
+    
+    // Each map is shown on its own thread, but they're printed in order
+    struct MapResult {
+        std::string output;
+        bool success = false;
+        bool done = false;
+    };
+    std::vector<MapResult> results(maps.size());
+    std::mutex mutex;
+    std::condition_variable result_done;
+    std::size_t next_map = 0;
+    
+    auto thread_function = [&]() {
+        while(true) {
+            std::size_t m;
+            {
+                std::scoped_lock lock(mutex);
+                if(next_map == maps.size()) {
+                    return;
+                }
+                m = next_map++;
+            }
+            
+            std::string output;
+            Info::set_output_capture(&output);
+            bool success = show_map_value(maps[m], type);
+            Info::set_output_capture(nullptr);
+            
+            {
+                std::scoped_lock lock(mutex);
+                results[m].output = std::move(output);
+                results[m].success = success;
+                results[m].done = true;
+            }
+            result_done.notify_all();
+        }
+    };
+    
+    std::size_t thread_count = std::min(max_threads, maps.size());
+    std::vector<std::thread> threads;
+    threads.reserve(thread_count);
+    for(std::size_t t = 0; t < thread_count; t++) {
+        threads.emplace_back(thread_function);
+    }
+    
+    // Print one JSON object per line
+    bool all_succeeded = true;
+    for(std::size_t m = 0; m < maps.size(); m++) {
+        MapResult result;
+        {
+            std::unique_lock lock(mutex);
+            result_done.wait(lock, [&results, &m]() { return results[m].done; });
+            result = std::move(results[m]);
+        }
+        
+        // Remove the trailing newline since it's a single value
+        if(!result.output.empty() && result.output.back() == '\n') {
+            result.output.pop_back();
+        }
+        
+        std::string line = "{\"map\":";
+        append_json_string(line, maps[m].string());
+        if(result.success) {
+            line += ",\"";
+            line += type.name;
+            line += "\":";
+            append_json_string(line, result.output);
+        }
+        else {
+            line += ",\"error\":true";
+            all_succeeded = false;
+        }
+        line += "}\n";
+        std::fwrite(line.data(), line.size(), 1, stdout);
+        oflush();
+    }
+    
+    for(auto &t : threads) {
+        t.join();
+    }
+    
+    return all_succeeded;
+}
+
 int main(int argc, const char **argv) {
     set_up_color_term();
     
@@ -322,6 +499,7 @@ int main(int argc, const char **argv) {
     // Options struct
     struct MapInfoOptions {
         const DisplayValue *type = &all_values[0];
+        std::size_t max_threads = std::thread::hardware_concurrency() < 1 ? 1 : std::thread::hardware_concurrency();
     } map_info_options;
     
     // Form the options list
@@ -341,11 +519,12 @@ int main(int argc, const char **argv) {
     // Command line options
     const CommandLineOption options[] = {
         CommandLineOption("type", 'T', 1, options_list.c_str(), "<type>"),
-        CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_INFO)
+        CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_INFO),
+        CommandLineOption("threads", 'j', 1, "Set the number of threads to use for showing maps in a directory. Default: CPU thread count")
     };
 
-    static constexpr char DESCRIPTION[] = "Display map metadata.";
-    static constexpr char USAGE[] = "[option] <map>";
+    static constexpr char DESCRIPTION[] = "Display map metadata. If a directory is given, the data is shown for every .map file in it (including subdirectories) as one JSON object per line.";
+    static constexpr char USAGE[] = "[options] <map | directory>";
 
     // Do it!
     auto remaining_arguments = Invader::CommandLineOption::parse_arguments<MapInfoOptions &>(argc, argv, options, USAGE, DESCRIPTION, 1, 1, map_info_options, [](char opt, const auto &args, auto &map_info_options) {
@@ -370,27 +549,32 @@ int main(int argc, const char **argv) {
             case 'i':
                 Invader::show_version_info();
                 std::exit(EXIT_SUCCESS);
+            case 'j':
+                try {
+                    int threads = std::stoi(args[0]);
+                    if(threads < 1) {
+                        throw std::exception();
+                    }
+                    map_info_options.max_threads = static_cast<std::size_t>(threads);
+                }
+                catch(std::exception &) {
+                    eprintf_error("Invalid number of threads %s\n", args[0]);
+                    std::exit(EXIT_FAILURE);
+                }
+                break;
         }
     });
 
-    // Load it
-    std::unique_ptr<Map> map;
-    try {
-        auto file = File::open_file(remaining_arguments[0]).value();
-        file_size = file.size();
-        if(file_size >= sizeof(header_cache)) {
-            std::memcpy(header_cache, file.data(), sizeof(header_cache));
-        }
-        
-        map = std::make_unique<Map>(Map::map_with_move(std::move(file)));
+    // Do it!
+    std::filesystem::path path = remaining_arguments[0];
+    std::error_code ec;
+    bool success;
+    if(std::filesystem::is_directory(path, ec)) {
+        success = show_directory_values(path, *map_info_options.type, map_info_options.max_threads);
     }
-    catch (std::exception &e) {
-        eprintf_error("Failed to parse %s: %s", remaining_arguments[0], e.what());
-        return EXIT_FAILURE;
+    else {
+        success = show_map_value(path, *map_info_options.type);
     }
     
-    // Do it!
-    map_info_options.type->calculate_value(*map);
-    
-    return EXIT_SUCCESS;
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
 }
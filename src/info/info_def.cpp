@@ -1,5 +1,6 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <cstdarg>
 #include <invader/map/map.hpp>
 #include <invader/printf.hpp>
 #include <invader/file/file.hpp>
@@ -10,6 +11,79 @@
 #include "info_def.hpp"
 
 namespace Invader::Info {
+    static thread_local std::string *output_capture = nullptr;
+
+    void set_output_capture(std::string *output) noexcept {
+        output_capture = output;
+    }
+
+    bool output_is_captured() noexcept {
+        return output_capture != nullptr;
+    }
+
+    void info_printf(const char *format, ...) {
+        va_list args;
+        va_start(args, format);
+        if(output_capture == nullptr) {
+            std::vfprintf(stdout, format, args);
+        }
+        else {
+            va_list args_copy;
+            va_copy(args_copy, args);
+            int length = std::vsnprintf(nullptr, 0, format, args_copy);
+            va_end(args_copy);
+            if(length > 0) {
+                auto offset = output_capture->size();
+                output_capture->resize(offset + static_cast<std::size_t>(length) + 1);
+                std::vsnprintf(output_capture->data() + offset, static_cast<std::size_t>(length) + 1, format, args);
+                output_capture->resize(offset + static_cast<std::size_t>(length));
+            }
+        }
+        va_end(args);
+    }
+
+    std::optional<MapHeader> read_map_header(const std::byte *data, std::size_t size) noexcept {
+        using namespace HEK;
+
+        if(size < sizeof(CacheFileHeader)) {
+            return std::nullopt;
+        }
+
+        // Same checks as when loading the map
+        auto read_header = [](const auto &header) -> std::optional<MapHeader> {
+            if(header.build.overflows() || header.name.overflows()) {
+                return std::nullopt;
+            }
+            const auto *game_engine_info = GameEngineInfo::get_game_engine_info(header.engine, header.build.string);
+            if(game_engine_info == nullptr) {
+                return std::nullopt;
+            }
+
+            MapHeader map_header;
+            map_header.cache_version = header.engine;
+            map_header.game_engine = game_engine_info->engine;
+            map_header.scenario_name = header.name;
+            map_header.build = header.build;
+            map_header.compressed = map_header.cache_version == CacheFileEngine::CACHE_FILE_XBOX;
+            return map_header;
+        };
+
+        const auto *header = reinterpret_cast<const CacheFileHeader *>(data);
+        if(!header->valid()) {
+            const auto *demo_header = reinterpret_cast<const CacheFileDemoHeader *>(data);
+            if(!demo_header->valid()) {
+                return std::nullopt;
+            }
+            return read_header(*demo_header);
+        }
+        else if(header->engine == CacheFileEngine::CACHE_FILE_NATIVE) {
+            return read_header(*reinterpret_cast<const NativeCacheFileHeader *>(data));
+        }
+        else {
+            return read_header(*header);
+        }
+    }
+
     static void print_all_indices(const Invader::Map &map, const std::vector<std::size_t> &indices) {
         for(auto i : indices) {
             auto &tag = map.get_tag(i);
@@ -321,6 +395,9 @@ namespace Invader::Info {
     void build(const Invader::Map &map) {
         oprintf("%s\n", map.get_build());
     }
+    void build(const MapHeader &header) {
+        oprintf("%s\n", header.build.string);
+    }
     
     void crc32(const Invader::Map &map) {
         oprintf("0x%08X\n", map.get_crc32());
@@ -332,6 +409,9 @@ namespace Invader::Info {
     void engine(const Invader::Map &map) {
         oprintf("%s\n", HEK::GameEngineInfo::get_game_engine_info(map.get_game_engine()).name);
     }
+    void engine(const MapHeader &header) {
+        oprintf("%s\n", HEK::GameEngineInfo::get_game_engine_info(header.game_engine).name);
+    }
     
     void external_bitmap_indices_count(const Invader::Map &map) {
         oprintf("%zu\n", find_external_tags_indices(map, Map::DataMapType::DATA_MAP_BITMAP, true, false).size());
@@ -434,6 +514,9 @@ namespace Invader::Info {
     void is_compressed(const Invader::Map &map) {
         oprintf("%i\n", map.get_compression_algorithm());
     }
+    void is_compressed(const MapHeader &header) {
+        oprintf("%i\n", header.compressed);
+    }
     void is_dirty(const Invader::Map &map) {
         oprintf("%i\n", !map.is_clean());
     }
@@ -452,6 +535,9 @@ namespace Invader::Info {
     void scenario(const Invader::Map &map) {
         oprintf("%s\n", map.get_scenario_name());
     }
+    void scenario(const MapHeader &header) {
+        oprintf("%s\n", header.scenario_name.string);
+    }
     
     void scenario_path(const Invader::Map &map) {
         oprintf("%s\n", File::halo_path_to_preferred_path(map.get_tag(map.get_scenario_tag_id()).get_path()).c_str());
@@ -5,12 +5,64 @@
 
 #include <vector>
 #include <optional>
+#include <string>
+#include <invader/printf.hpp>
+#include <invader/hek/map.hpp>
 
 namespace Invader {
     class Map;
 }
 
 namespace Invader::Info {
+    /**
+     * Metadata that can be read from the cache file header without loading the rest of the map
+     */
+    struct MapHeader {
+        /** Cache version */
+        HEK::CacheFileEngine cache_version;
+
+        /** Engine */
+        HEK::GameEngine game_engine;
+
+        /** Name */
+        HEK::TagString scenario_name;
+
+        /** Build */
+        HEK::TagString build;
+
+        /** Map is compressed */
+        bool compressed;
+    };
+
+    /**
+     * Read the cache file header
+     * @param data beginning of the cache file
+     * @param size size of the data (this only needs to be the size of the header)
+     * @return     the header, or std::nullopt if it is not a valid header (loading the whole map will say why)
+     */
+    std::optional<MapHeader> read_map_header(const std::byte *data, std::size_t size) noexcept;
+
+    /**
+     * Set where output on the current thread goes
+     * @param output string to append output to, or nullptr to write it to stdout
+     */
+    void set_output_capture(std::string *output) noexcept;
+
+    /**
+     * Get whether output on the current thread is being captured
+     * @return true if being captured
+     */
+    bool output_is_captured() noexcept;
+
+    /**
+     * Print to stdout or, if output is being captured on this thread, to the capture string
+     * @param format printf format
+     */
+    void info_printf(const char *format, ...)
+    #ifdef __GNUC__
+    __attribute__((format(printf, 1, 2)))
+    #endif
+    ;
     /**
      * Check if the indices are valid for stock Halo Custom Edition
      * @param map map to check
@@ -73,9 +125,11 @@ namespace Invader::Info {
     
     void overview(const Invader::Map &);
     void build(const Invader::Map &);
+    void build(const MapHeader &);
     void crc32(const Invader::Map &);
     void crc32_mismatched(const Invader::Map &);
     void engine(const Invader::Map &);
+    void engine(const MapHeader &);
     void external_bitmap_indices(const Invader::Map &);
     void external_bitmap_indices_count(const Invader::Map &);
     void external_bitmap_pointers(const Invader::Map &);
@@ -99,12 +153,14 @@ namespace Invader::Info {
     void internal_sounds(const Invader::Map &);
     void internal_sounds_count(const Invader::Map &);
     void is_compressed(const Invader::Map &);
+    void is_compressed(const MapHeader &);
     void is_dirty(const Invader::Map &);
     void is_protected(const Invader::Map &);
     void languages(const Invader::Map &);
     void map_type(const Invader::Map &);
     void protection_issues(const Invader::Map &);
     void scenario(const Invader::Map &);
+    void scenario(const MapHeader &);
     void scenario_path(const Invader::Map &);
     void stub_count(const Invader::Map &);
     void tags(const Invader::Map &);
@@ -114,4 +170,10 @@ namespace Invader::Info {
     void uses_external_pointers(const Invader::Map &);
 }
 
+// Send everything printed to stdout through info_printf so each map's output can be captured when showing multiple maps
+#undef oprintf
+#define oprintf(...) Invader::Info::info_printf(__VA_ARGS__)
+#undef ON_COLOR_TERM
+#define ON_COLOR_TERM(fd) (((fd) != stdout || !Invader::Info::output_is_captured()) && is_on_color_term())
+
 #endif
@@ -16,6 +16,7 @@ set(INVADER_PARSER_FILES
     "${CMAKE_CURRENT_BINARY_DIR}/parser-normalize.cpp"
     "${CMAKE_CURRENT_BINARY_DIR}/parser-read-hek-file.cpp"
     "${CMAKE_CURRENT_BINARY_DIR}/parser-scan-padding.cpp"
+    "${CMAKE_CURRENT_BINARY_DIR}/parser-scan-dependencies.cpp"
     "${CMAKE_CURRENT_BINARY_DIR}/bitfield.cpp"
     "${CMAKE_CURRENT_BINARY_DIR}/enum.cpp"
 )
@@ -42,6 +43,7 @@ set(INVADER_SOURCE_FILES
     "${CMAKE_CURRENT_BINARY_DIR}/parser-normalize.cpp"
     "${CMAKE_CURRENT_BINARY_DIR}/parser-read-hek-file.cpp"
     "${CMAKE_CURRENT_BINARY_DIR}/parser-scan-padding.cpp"
+    "${CMAKE_CURRENT_BINARY_DIR}/parser-scan-dependencies.cpp"
     "${CMAKE_CURRENT_BINARY_DIR}/bitfield.cpp"
     "${CMAKE_CURRENT_BINARY_DIR}/enum.cpp"
 
@@ -63,9 +65,12 @@ set(INVADER_SOURCE_FILES
     src/hek/map.cpp
     src/resource/resource_map.cpp
     src/dependency/found_tag_dependency.cpp
+    src/dependency/dependency_index.cpp
     src/map/map.cpp
     src/map/tag.cpp
     src/file/file.cpp
+    src/file/tags_manifest.cpp
+    src/build/build_profile.cpp
     src/build/build_workload.cpp
     src/build/build_workload_dedupe.cpp
     src/bitmap/swizzle.cpp
@@ -121,6 +126,7 @@ set(INVADER_SOURCE_FILES
     src/crc/crc32.c
     src/crc/crc_spoof.c
     src/crc/hek/crc.cpp
+    src/crc/hash.cpp
 
     src/version.cpp
 )
@@ -185,6 +185,7 @@ namespace Invader {
             throw OutOfBoundsException();
         }
         else {
+            this->populate_tag_path(index);
             return this->tags[index];
         }
     }
@@ -193,6 +194,14 @@ namespace Invader {
         return const_cast<Map *>(this)->get_tag(index);
     }
 
+    Map::TagIterator Map::begin() const noexcept {
+        return TagIterator(this, 0);
+    }
+
+    Map::TagIterator Map::end() const noexcept {
+        return TagIterator(this, this->get_tag_count());
+    }
+
     std::size_t Map::get_scenario_tag_id() const noexcept {
         return this->scenario_tag_id;
     }
@@ -306,9 +315,13 @@ namespace Invader {
             set_model_stuff(*reinterpret_cast<const CacheFileTagDataHeaderPC *>(this->get_tag_data_at_offset(0, sizeof(CacheFileTagDataHeaderPC))));
         }
 
+        // Paths are read from the tag array when the tag is first accessed, so getting one tag doesn't mean reading every path.
+        this->tag_state = std::make_unique<TagState[]>(tag_count);
+        this->tag_lookup_built = std::make_unique<std::once_flag>();
+        this->tag_lookup.clear();
+
         auto do_populate_the_array = [&map, &tag_count](auto *tags) {
-            // Have a pointer for the end of the tag data so we can check to make sure things aren't null terminated
-            const char *tag_data_end = reinterpret_cast<const char *>(map.tag_data) + map.tag_data_length;
+            map.tag_array_offset = reinterpret_cast<const std::byte *>(tags) - map.tag_data;
 
             for(std::size_t i = 0; i < tag_count; i++) {
                 map.tags.push_back(Tag(map));
@@ -316,26 +329,68 @@ namespace Invader {
                 tag.tag_fourcc = tags[i].primary_class;
                 tag.tag_data_index_offset = reinterpret_cast<const std::byte *>(tags + i) - map.tag_data;
                 tag.tag_index = i;
-                
-                // Set the map type
-                if(i == map.scenario_tag_id) {
-                    map.type = reinterpret_cast<Scenario<LittleEndian> *>(map.resolve_tag_data_pointer(tags[i].tag_data, sizeof(Scenario<LittleEndian>)))->type;
-                }
+            }
+
+            // Set the map type
+            map.type = reinterpret_cast<Scenario<LittleEndian> *>(map.resolve_tag_data_pointer(tags[map.scenario_tag_id].tag_data, sizeof(Scenario<LittleEndian>)))->type;
+
+            // Locate each tag's data now so a bad tag fails loading the map rather than whatever accesses the tag later
+            for(std::size_t i = 0; i < tag_count; i++) {
+                map.populate_tag_data(i);
+            }
+        };
+
+        if(this->cache_version == HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
+            try {
+                do_populate_the_array(reinterpret_cast<const NativeCacheFileTagDataTag *>(this->resolve_tag_data_pointer(header.tag_array_address, sizeof(CacheFileTagDataTag) * tag_count)));
+            }
+            catch(std::exception &) {
+                eprintf_error("Failed to populate the tag array");
+                throw;
+            }
+        }
+        else {
+            try {
+                do_populate_the_array(reinterpret_cast<const CacheFileTagDataTag *>(this->resolve_tag_data_pointer(header.tag_array_address, sizeof(CacheFileTagDataTag) * tag_count)));
+            }
+            catch(std::exception &) {
+                eprintf_error("Failed to populate the tag array");
+                throw;
+            }
+            try {
+                this->get_bsps();
+            }
+            catch(std::exception &) {
+                eprintf_error("Failed to read BSPs");
+                throw;
+            }
+        }
+    }
+
+    void Map::populate_tag_path(std::size_t index) const {
+        using namespace Invader::HEK;
+
+        auto &map = *const_cast<Map *>(this);
+        std::call_once(map.tag_state[index].path, [&map, &index]() {
+            auto read_path = [&map, &index](auto *tags) {
+                // Have a pointer for the end of the tag data so we can check to make sure things aren't null terminated
+                const char *tag_data_end = reinterpret_cast<const char *>(map.tag_data) + map.tag_data_length;
+                auto &tag = map.tags[index];
 
                 try {
-                    const auto *path = reinterpret_cast<const char *>(map.resolve_tag_data_pointer(tags[i].tag_path));
+                    const auto *path = reinterpret_cast<const char *>(map.resolve_tag_data_pointer(tags[index].tag_path));
 
                     // Make sure the path is null-terminated and it doesn't contain whitespace that isn't an ASCII space (0x20) or forward slash characters
                     bool null_terminated = false;
                     for(auto *path_test = path; path < tag_data_end; path_test++) {
                         if(*path_test == 0) {
                             null_terminated = true;
-                            
+
                             // Did we even start?
                             if(path_test == path) {
                                 throw InvalidTagPathException();
                             }
-                            
+
                             break;
                         }
                         else if(*path_test == '/') {
@@ -357,7 +412,7 @@ namespace Invader {
                     else {
                         throw InvalidTagPathException();
                     }
-                    
+
                     // Lowercase everything
                     for(char &c : tag.path) {
                         c = std::tolower(c);
@@ -365,166 +420,179 @@ namespace Invader {
                 }
                 catch (std::exception &) {
                     char new_path[64];
-                    std::snprintf(new_path, sizeof(new_path), "corrupted\\tag_%zu", i);
+                    std::snprintf(new_path, sizeof(new_path), "corrupted\\tag_%zu", index);
                     map.invalid_paths_detected = true;
                     tag.path = new_path;
                 }
+            };
 
-                if(tag.tag_fourcc == TagFourCC::TAG_FOURCC_SCENARIO_STRUCTURE_BSP && map.cache_version != HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
-                    continue;
+            if(map.cache_version == HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
+                read_path(reinterpret_cast<const NativeCacheFileTagDataTag *>(map.tag_data + map.tag_array_offset));
+            }
+            else {
+                read_path(reinterpret_cast<const CacheFileTagDataTag *>(map.tag_data + map.tag_array_offset));
+            }
+        });
+    }
+
+    void Map::populate_tag_data(std::size_t index) {
+        using namespace Invader::HEK;
+
+        auto &map = *this;
+        auto read_data = [&map, &index](auto *tags) {
+            auto &tag = map.tags[index];
+
+            if(tag.tag_fourcc == TagFourCC::TAG_FOURCC_SCENARIO_STRUCTURE_BSP && map.cache_version != HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
+                return;
+            }
+            else if(sizeof(tags->tag_data) == sizeof(HEK::Pointer) && reinterpret_cast<const CacheFileTagDataTag *>(tags)[index].indexed) {
+                tag.indexed = true;
+
+                // Indexed sound tags still use tag data (until you use reflexives)
+                if(tag.tag_fourcc == TagFourCC::TAG_FOURCC_SOUND) {
+                    tag.base_struct_pointer = tags[index].tag_data;
+                }
+                else {
+                    tag.base_struct_pointer = 0;
+                    tag.resource_index = tags[index].tag_data;
                 }
-                else if(sizeof(tags->tag_data) == sizeof(HEK::Pointer) && reinterpret_cast<const CacheFileTagDataTag *>(tags)[i].indexed) {
-                    tag.indexed = true;
 
-                    // Indexed sound tags still use tag data (until you use reflexives)
-                    if(tag.tag_fourcc == TagFourCC::TAG_FOURCC_SOUND) {
-                        tag.base_struct_pointer = tags[i].tag_data;
-                    }
-                    else {
-                        tag.base_struct_pointer = 0;
-                        tag.resource_index = tags[i].tag_data;
-                    }
+                // Find where it's located
+                DataMapType type;
+                bool unavailable = false;
+                switch(tag.tag_fourcc) {
+                    case TagFourCC::TAG_FOURCC_BITMAP:
+                        type = DataMapType::DATA_MAP_BITMAP;
+                        unavailable = map.bitmap_data.size() == 0;
+                        break;
+                    case TagFourCC::TAG_FOURCC_SOUND:
+                        type = DataMapType::DATA_MAP_SOUND;
+                        unavailable = map.sound_data.size() == 0;
+                        break;
+                    default:
+                        type = DataMapType::DATA_MAP_LOC;
+                        unavailable = map.loc_data.size() == 0;
+                        break;
+                }
 
-                    // Find where it's located
-                    DataMapType type;
-                    bool unavailable = false;
-                    switch(tag.tag_fourcc) {
-                        case TagFourCC::TAG_FOURCC_BITMAP:
-                            type = DataMapType::DATA_MAP_BITMAP;
-                            unavailable = map.bitmap_data.size() == 0;
-                            break;
-                        case TagFourCC::TAG_FOURCC_SOUND:
-                            type = DataMapType::DATA_MAP_SOUND;
-                            unavailable = map.sound_data.size() == 0;
-                            break;
-                        default:
-                            type = DataMapType::DATA_MAP_LOC;
-                            unavailable = map.loc_data.size() == 0;
-                            break;
-                    }
-                    
-                    // If we don't have the corresponding map, continue
-                    if(unavailable) {
-                        continue;
-                    }
+                // If we don't have the corresponding map, continue
+                if(unavailable) {
+                    return;
+                }
 
-                    // Let's begin.
-                    auto &header = *reinterpret_cast<ResourceMapHeader *>(map.get_data_at_offset(0, sizeof(ResourceMapHeader), type));
-                    auto count = header.resource_count.read();
-                    auto *indices = reinterpret_cast<ResourceMapResource *>(map.get_data_at_offset(header.resources, count * sizeof(ResourceMapResource), type));
-
-                    // Find that index if we're a sounds.map file
-                    if(!tag.resource_index.has_value()) {
-                        auto *paths = reinterpret_cast<const char *>(map.get_data_at_offset(header.paths, 0, type));
-                        for(std::uint32_t i = 1; i < count; i+=2) {
-                            auto *path = paths + indices[i].path_offset;
-                            if(tag.path == path) {
-                                tag.resource_index = i;
-                                break;
-                            }
+                // Let's begin.
+                auto &header = *reinterpret_cast<ResourceMapHeader *>(map.get_data_at_offset(0, sizeof(ResourceMapHeader), type));
+                auto count = header.resource_count.read();
+                auto *indices = reinterpret_cast<ResourceMapResource *>(map.get_data_at_offset(header.resources, count * sizeof(ResourceMapResource), type));
+
+                // Find that index if we're a sounds.map file (these are found by path, so the path is needed now)
+                if(!tag.resource_index.has_value()) {
+                    map.populate_tag_path(index);
+                    auto *paths = reinterpret_cast<const char *>(map.get_data_at_offset(header.paths, 0, type));
+                    for(std::uint32_t i = 1; i < count; i+=2) {
+                        auto *path = paths + indices[i].path_offset;
+                        if(tag.path == path) {
+                            tag.resource_index = i;
+                            break;
                         }
                     }
-                    
-                    // Do we even have an index?
-                    if(!tag.resource_index.has_value()) {
-                        eprintf_error("Tag %s.%s could not be found in the resource map file", File::halo_path_to_preferred_path(tag.path).c_str(), HEK::tag_fourcc_to_extension(tag.tag_fourcc));
-                        throw OutOfBoundsException();
-                    }
+                }
 
-                    // Make sure it's valid
-                    if(*tag.resource_index >= count) {
-                        eprintf_error("Tag %s.%s is out-of-bounds for the resource map(s) provided (%zu >= %zu)", File::halo_path_to_preferred_path(tag.path).c_str(), HEK::tag_fourcc_to_extension(tag.tag_fourcc), *tag.resource_index, static_cast<std::size_t>(count));
-                        throw OutOfBoundsException();
-                    }
+                // Do we even have an index?
+                if(!tag.resource_index.has_value()) {
+                    map.populate_tag_path(index);
+                    eprintf_error("Tag %s.%s could not be found in the resource map file", File::halo_path_to_preferred_path(tag.path).c_str(), HEK::tag_fourcc_to_extension(tag.tag_fourcc));
+                    throw OutOfBoundsException();
+                }
 
-                    // Set it all
-                    auto &index = indices[*tag.resource_index];
-                    tag.tag_data_size = index.size;
-                    if(tag.tag_fourcc == TagFourCC::TAG_FOURCC_SOUND) {
-                        tag.base_struct_offset = index.data_offset + sizeof(HEK::Sound<HEK::LittleEndian>);
-                    }
-                    else {
-                        tag.base_struct_offset = index.data_offset;
-                    }
+                // Make sure it's valid
+                if(*tag.resource_index >= count) {
+                    map.populate_tag_path(index);
+                    eprintf_error("Tag %s.%s is out-of-bounds for the resource map(s) provided (%zu >= %zu)", File::halo_path_to_preferred_path(tag.path).c_str(), HEK::tag_fourcc_to_extension(tag.tag_fourcc), *tag.resource_index, static_cast<std::size_t>(count));
+                    throw OutOfBoundsException();
+                }
+
+                // Set it all
+                auto &resource = indices[*tag.resource_index];
+                tag.tag_data_size = resource.size;
+                if(tag.tag_fourcc == TagFourCC::TAG_FOURCC_SOUND) {
+                    tag.base_struct_offset = resource.data_offset + sizeof(HEK::Sound<HEK::LittleEndian>);
                 }
                 else {
-                    tag.base_struct_pointer = tags[i].tag_data;
-                    
-                    // Check if there are external pointers
-                    switch(tag.tag_fourcc) {
-                        case TagFourCC::TAG_FOURCC_BITMAP: {
-                            auto &base_struct = tag.get_base_struct<HEK::Bitmap>();
-                            std::size_t bitmap_data_count = base_struct.bitmap_data.count;
-                            if(bitmap_data_count) {
-                                auto *bitmaps = tag.resolve_reflexive(base_struct.bitmap_data);
-                                for(std::size_t b = 0; b < bitmap_data_count; b++) {
-                                    if(bitmaps[b].flags & BitmapDataFlagsFlag::BITMAP_DATA_FLAGS_FLAG_EXTERNAL) {
-                                        tag.external_pointers = true;
-                                        break;
-                                    }
+                    tag.base_struct_offset = resource.data_offset;
+                }
+            }
+            else {
+                tag.base_struct_pointer = tags[index].tag_data;
+
+                // Check if there are external pointers
+                switch(tag.tag_fourcc) {
+                    case TagFourCC::TAG_FOURCC_BITMAP: {
+                        auto &base_struct = tag.get_base_struct<HEK::Bitmap>();
+                        std::size_t bitmap_data_count = base_struct.bitmap_data.count;
+                        if(bitmap_data_count) {
+                            auto *bitmaps = tag.resolve_reflexive(base_struct.bitmap_data);
+                            for(std::size_t b = 0; b < bitmap_data_count; b++) {
+                                if(bitmaps[b].flags & BitmapDataFlagsFlag::BITMAP_DATA_FLAGS_FLAG_EXTERNAL) {
+                                    tag.external_pointers = true;
+                                    break;
                                 }
                             }
-                            break;
                         }
-                        case TagFourCC::TAG_FOURCC_SOUND: {
-                            auto &base_struct = tag.get_base_struct<HEK::Sound>();
-                            std::size_t pitch_range_count = base_struct.pitch_ranges.count;
-                            if(pitch_range_count) {
-                                auto *pitch_ranges = tag.resolve_reflexive(base_struct.pitch_ranges);
-                                for(std::size_t pr = 0; pr < pitch_range_count && !tag.external_pointers; pr++) {
-                                    auto &pitch_range = pitch_ranges[pr];
-                                    std::size_t permutation_count = pitch_range.permutations.count;
-                                    if(permutation_count) {
-                                        auto *permutations = tag.resolve_reflexive(pitch_range.permutations);
-                                        for(std::size_t p = 0; p < permutation_count; p++) {
-                                            if(permutations[p].samples.external & 1) {
-                                                tag.external_pointers = true;
-                                                break; // breaks out of outer loop too due to the check
-                                            }
+                        break;
+                    }
+                    case TagFourCC::TAG_FOURCC_SOUND: {
+                        auto &base_struct = tag.get_base_struct<HEK::Sound>();
+                        std::size_t pitch_range_count = base_struct.pitch_ranges.count;
+                        if(pitch_range_count) {
+                            auto *pitch_ranges = tag.resolve_reflexive(base_struct.pitch_ranges);
+                            for(std::size_t pr = 0; pr < pitch_range_count && !tag.external_pointers; pr++) {
+                                auto &pitch_range = pitch_ranges[pr];
+                                std::size_t permutation_count = pitch_range.permutations.count;
+                                if(permutation_count) {
+                                    auto *permutations = tag.resolve_reflexive(pitch_range.permutations);
+                                    for(std::size_t p = 0; p < permutation_count; p++) {
+                                        if(permutations[p].samples.external & 1) {
+                                            tag.external_pointers = true;
+                                            break; // breaks out of outer loop too due to the check
                                         }
                                     }
                                 }
                             }
-                            break;
                         }
-                        default:
-                            break;
+                        break;
                     }
+                    default:
+                        break;
                 }
             }
         };
 
-        if(this->cache_version == HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
-            try {
-                do_populate_the_array(reinterpret_cast<const NativeCacheFileTagDataTag *>(this->resolve_tag_data_pointer(header.tag_array_address, sizeof(CacheFileTagDataTag) * tag_count)));
-            }
-            catch(std::exception &) {
-                eprintf_error("Failed to populate the tag array");
-                throw;
-            }
+        if(map.cache_version == HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
+            read_data(reinterpret_cast<const NativeCacheFileTagDataTag *>(map.tag_data + map.tag_array_offset));
         }
         else {
-            try {
-                do_populate_the_array(reinterpret_cast<const CacheFileTagDataTag *>(this->resolve_tag_data_pointer(header.tag_array_address, sizeof(CacheFileTagDataTag) * tag_count)));
-            }
-            catch(std::exception &) {
-                eprintf_error("Failed to populate the tag array");
-                throw;
-            }
-            try {
-                this->get_bsps();
-            }
-            catch(std::exception &) {
-                eprintf_error("Failed to read BSPs");
-                throw;
-            }
+            read_data(reinterpret_cast<const CacheFileTagDataTag *>(map.tag_data + map.tag_array_offset));
         }
     }
 
+    void Map::populate_tag_lookup() const {
+        auto &map = *const_cast<Map *>(this);
+        std::call_once(*map.tag_lookup_built, [&map]() {
+            // Index the tags by path and class. If more than one tag has the same path and class, the first one is used.
+            map.tag_lookup.reserve(map.tags.size());
+            for(std::size_t i = 0; i < map.tags.size(); i++) {
+                map.populate_tag_path(i);
+                auto &tag = map.tags[i];
+                map.tag_lookup.emplace(TagLookupKey { tag.get_path(), tag.get_tag_fourcc() }, i);
+            }
+        });
+    }
+
     void Map::get_bsps() {
         using namespace Invader::HEK;
 
-        auto &scenario_tag = this->tags[this->scenario_tag_id];
+        auto &scenario_tag = this->get_tag(this->scenario_tag_id);
         auto &tag = scenario_tag.get_base_struct<Scenario>();
         std::size_t bsp_count = tag.structure_bsps.count;
         auto *bsps = scenario_tag.resolve_reflexive(tag.structure_bsps);
@@ -532,12 +600,9 @@ namespace Invader {
         for(std::size_t i = 0; i < bsp_count; i++) {
             auto &bsp = bsps[i];
             std::size_t bsp_id = bsp.structure_bsp.tag_id.read().index;
-            if(bsp_id >= this->tags.size()) {
-                throw OutOfBoundsException();
-            }
 
-            // Add the BSP stuff here
-            auto &bsp_tag = this->tags[bsp_id];
+            // Add the BSP stuff here (after the tag is read so this isn't overwritten)
+            auto &bsp_tag = this->get_tag(bsp_id);
             bsp_tag.tag_data_size = bsp.bsp_size;
             bsp_tag.base_struct_offset = bsp.bsp_start;
             bsp_tag.base_struct_pointer = bsp.bsp_address;
@@ -557,6 +622,12 @@ namespace Invader {
         using namespace HEK;
         
         reasons.clear();
+
+        // Read every tag's path first so invalid paths are detected
+        auto tag_count = this->get_tag_count();
+        for(std::size_t t = 0; t < tag_count; t++) {
+            this->populate_tag_path(t);
+        }
         
         // Invalid paths?
         if(this->invalid_paths_detected) {
@@ -574,7 +645,6 @@ namespace Invader {
         }
 
         // Go through each tag
-        auto tag_count = this->get_tag_count();
         for(std::size_t t = 0; t < tag_count; t++) {
             auto &tag = this->get_tag(t);
             auto tag_class = tag.get_tag_fourcc();
@@ -612,26 +682,66 @@ namespace Invader {
         return !reasons.empty();
     }
 
-    std::optional<std::size_t> Map::find_tag(const char *tag_path, TagFourCC tag_fourcc) const noexcept {
-        for(auto &tag : tags) {
-            if(tag.get_tag_fourcc() == tag_fourcc && tag.get_path() == tag_path) {
-                return &tag - tags.data();
-            }
+    std::optional<std::size_t> Map::find_tag(const char *tag_path, TagFourCC tag_fourcc) const {
+        this->populate_tag_lookup();
+        auto found = this->tag_lookup.find(TagLookupKey { tag_path, tag_fourcc });
+        if(found == this->tag_lookup.end()) {
+            return std::nullopt;
         }
-        return std::nullopt;
+        return found->second;
     }
 
-    Map::Map(Map &&move) {
-        this->data = std::move(move.data);
-        this->bitmap_data = std::move(move.bitmap_data);
-        this->loc_data = std::move(move.loc_data);
-        this->sound_data = std::move(move.sound_data);
-        this->cache_version = move.cache_version;
-        this->load_map();
-        this->compressed = move.compressed;
+    std::vector<std::optional<std::size_t>> Map::find_tags(const std::vector<std::pair<std::string, TagFourCC>> &tags) const {
+        this->populate_tag_lookup();
+        std::vector<std::optional<std::size_t>> found;
+        found.reserve(tags.size());
+        for(auto &t : tags) {
+            auto f = this->tag_lookup.find(TagLookupKey { t.first, t.second });
+            found.emplace_back(f == this->tag_lookup.end() ? std::nullopt : std::optional<std::size_t>(f->second));
+        }
+        return found;
+    }
+
+    Map::Map(Map &&move) :
+        data(std::move(move.data)),
+        bitmap_data(std::move(move.bitmap_data)),
+        loc_data(std::move(move.loc_data)),
+        sound_data(std::move(move.sound_data)),
+        model_data_offset(move.model_data_offset),
+        model_index_offset(move.model_index_offset),
+        model_data_size(move.model_data_size),
+        tags(std::move(move.tags)),
+        tag_lookup(std::move(move.tag_lookup)),
+        tag_lookup_built(std::move(move.tag_lookup_built)),
+        tag_state(std::move(move.tag_state)),
+        tag_array_offset(move.tag_array_offset),
+        scenario_tag_id(move.scenario_tag_id),
+        tag_data(move.tag_data),
+        tag_data_length(move.tag_data_length),
+        base_memory_address(move.base_memory_address),
+        invalid_paths_detected(move.invalid_paths_detected.load()),
+        compressed(move.compressed),
+        game_engine(move.game_engine),
+        cache_version(move.cache_version),
+        type(move.type),
+        scenario_name(move.scenario_name),
+        build(move.build),
+        crc32(move.crc32),
+        header_crc32(move.header_crc32),
+        asset_indices_offset(move.asset_indices_offset),
+        header_decompressed_file_size(move.header_decompressed_file_size),
+        header_type(move.header_type) {
+        
+        // Moving the vectors keeps their buffers, so tag_data and the tag lookup (which points to the tags' paths) are still valid. The tags just need to point to this map now.
+        for(auto &tag : this->tags) {
+            tag.map = this;
+        }
         
         // Clear tags from old version
+        move.tag_lookup.clear();
         move.tags.clear();
+        move.tag_data = nullptr;
+        move.tag_data_length = 0;
     }
 
     std::byte *Map::get_internal_asset(std::size_t offset, std::size_t minimum_size) {
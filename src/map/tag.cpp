@@ -12,11 +12,11 @@ namespace Invader {
         if(this->is_indexed()) {
             switch(this->tag_fourcc) {
                 case TagFourCC::TAG_FOURCC_BITMAP:
-                    return !this->map.bitmap_data.empty();
+                    return !this->map->bitmap_data.empty();
                 case TagFourCC::TAG_FOURCC_SOUND:
-                    return !this->map.sound_data.empty();
+                    return !this->map->sound_data.empty();
                 default:
-                    return !this->map.loc_data.empty();
+                    return !this->map->loc_data.empty();
             }
         }
 
@@ -60,10 +60,10 @@ namespace Invader {
         // Indexed sound tags can use data in both the sound tag in the cache file and the sound tag in sounds.map
         if(this->tag_fourcc == TagFourCC::TAG_FOURCC_SOUND && this->indexed) {
             if(pointer == this->base_struct_pointer) {
-                return this->map.resolve_tag_data_pointer(pointer, minimum);
+                return this->map->resolve_tag_data_pointer(pointer, minimum);
             }
             else {
-                return this->map.get_data_at_offset(pointer + this->base_struct_offset, minimum, Map::DataMapType::DATA_MAP_SOUND);
+                return this->map->get_data_at_offset(pointer + this->base_struct_offset, minimum, Map::DataMapType::DATA_MAP_SOUND);
             }
         }
 
@@ -93,10 +93,10 @@ namespace Invader {
                 type = Map::DataMapType::DATA_MAP_CACHE;
             }
 
-            return this->map.get_data_at_offset(offset, minimum, type);
+            return this->map->get_data_at_offset(offset, minimum, type);
         }
         else {
-            return this->map.resolve_tag_data_pointer(pointer, minimum);
+            return this->map->resolve_tag_data_pointer(pointer, minimum);
         }
     }
 
@@ -105,12 +105,12 @@ namespace Invader {
     }
 
     HEK::CacheFileTagDataTag &Tag::get_tag_data_index() noexcept {
-        return *reinterpret_cast<HEK::CacheFileTagDataTag *>(this->map.get_tag_data_at_offset(this->tag_data_index_offset, sizeof(HEK::CacheFileTagDataTag)));
+        return *reinterpret_cast<HEK::CacheFileTagDataTag *>(this->map->get_tag_data_at_offset(this->tag_data_index_offset, sizeof(HEK::CacheFileTagDataTag)));
     }
 
     const HEK::CacheFileTagDataTag &Tag::get_tag_data_index() const noexcept {
         return const_cast<Tag *>(this)->get_tag_data_index();
     }
 
-    Tag::Tag(Map &map) : map(map) {}
+    Tag::Tag(Map &map) : map(&map) {}
 }
@@ -3,6 +3,7 @@
 #include <vector>
 #include <string>
 #include <filesystem>
+#include <unordered_set>
 #include <invader/printf.hpp>
 #include <invader/version.hpp>
 #include <invader/tag/hek/header.hpp>
@@ -10,6 +11,7 @@
 #include "../command_line_option.hpp"
 #include <invader/tag/parser/parser.hpp>
 #include <invader/file/file.hpp>
+#include <invader/dependency/dependency_index.hpp>
 
 using namespace Invader;
 using namespace Invader::File;
@@ -76,6 +78,7 @@ int main(int argc, char * const *argv) {
         CommandLineOption("tag", 'T', 2, "Refactor an individual tag. This can be specified multiple times but cannot be used with --recursive.", "<f> <t>"),
         CommandLineOption("groups", 'g', 2, "Refactor all tags of a given group to another group. All tags in the destination group must exist. This can be specified multiple times but cannot be used with --recursive or -M move.", "<f> <t>"),
         CommandLineOption("single-tag", 's', 1, "Make changes to a single tag, only, rather than the whole tags directory.", "<path>"),
+        CommandLineOption("rebuild-index", 'I', 0, "Parse every tag again rather than only the tags that changed since the dependency index was last saved."),
         CommandLineOption("replace-string", 'R', 2, "Replaces all instances in a path of <a> with <b>. This can be used multiple times for multiple replacements. If --groups or --recursive are used, this applies to the output of those. Otherwise, it applies to all tags.", "<a> <b>")
     };
 
@@ -88,6 +91,7 @@ int main(int argc, char * const *argv) {
         std::optional<RefactorMode> mode;
         const char *single_tag = nullptr;
         bool unsafe = false;
+        bool rebuild_index = false;
 
         std::vector<std::pair<std::string, std::string>> string_replacements;
         std::vector<std::pair<TagFilePath, TagFilePath>> replacements;
@@ -117,6 +121,9 @@ int main(int argc, char * const *argv) {
             case 'U':
                 refactor_options.unsafe = true;
                 break;
+            case 'I':
+                refactor_options.rebuild_index = true;
+                break;
             case 'M':
                 if(std::strcmp(arguments[0], "move") == 0) {
                     refactor_options.mode = RefactorMode::REFACTOR_MODE_MOVE;
@@ -196,6 +203,7 @@ int main(int argc, char * const *argv) {
     // Figure out what we need to do
     std::vector<TagFile *> replacements_files;
     std::vector<TagFile> all_tags = load_virtual_tag_folder(refactor_options.tags);
+    File::TagDirectoryIndex tags_index(all_tags, refactor_options.tags);
     std::vector<TagFile> single_tag;
     std::vector<TagFile> *tag_to_modify;
     
@@ -203,14 +211,7 @@ int main(int argc, char * const *argv) {
     if(refactor_options.mode == RefactorMode::REFACTOR_MODE_NO_MOVE && !refactor_options.unsafe) {
         bool failed = false;
         for(auto &i : refactor_options.replacements) {
-            bool nonexistant = true;
-            for(auto &t : refactor_options.tags) {
-                if(std::filesystem::exists(std::filesystem::path(t) / (File::halo_path_to_preferred_path(i.second.path) + "." + HEK::tag_fourcc_to_extension(i.second.fourcc)))) {
-                    nonexistant = false;
-                    break;
-                }
-            }
-            if(nonexistant) {
+            if(!tags_index.find(i.second).has_value()) {
                 eprintf_error("Cannot safely refactor %s.%s to %s.%s (destination doesn't exist)", File::halo_path_to_preferred_path(i.first.path).c_str(), HEK::tag_fourcc_to_extension(i.first.fourcc), File::halo_path_to_preferred_path(i.second.path).c_str(), HEK::tag_fourcc_to_extension(i.second.fourcc));
                 failed = true;
             }
@@ -272,7 +273,7 @@ int main(int argc, char * const *argv) {
         tag.tag_path = single_tag_maybe->path + "." + tag_fourcc_to_extension(single_tag_maybe->fourcc);
 
         // Find it
-        auto file_path_maybe = File::tag_path_to_file_path(tag.tag_path, refactor_options.tags);
+        auto file_path_maybe = tags_index.find(tag.tag_path);
         if(!file_path_maybe.has_value()) {
             eprintf_error("Error: %s was not found in any tags directory", refactor_options.single_tag);
             return EXIT_FAILURE;
@@ -476,6 +477,28 @@ int main(int argc, char * const *argv) {
         all_tags = load_virtual_tag_folder(refactor_options.tags);
     }
 
+    // Use the dependency index to skip tags that don't reference anything being replaced. Tags that aren't indexed (e.g. they couldn't be parsed) are still checked.
+    std::optional<DependencyIndex> dependency_index;
+    std::unordered_set<std::string> replaced_paths;
+    if(!refactor_options.single_tag) {
+        dependency_index.emplace(refactor_options.tags, refactor_options.rebuild_index);
+        for(auto &r : replacements) {
+            replaced_paths.insert(r.first.join());
+        }
+    }
+    auto may_reference_replacements = [&dependency_index, &replaced_paths](const TagFile &tag) -> bool {
+        auto *indexed = dependency_index.has_value() ? dependency_index->find_tag(tag.full_path) : nullptr;
+        if(!indexed) {
+            return true;
+        }
+        for(auto &d : indexed->dependencies) {
+            if(replaced_paths.contains(d.join())) {
+                return true;
+            }
+        }
+        return false;
+    };
+
     // Go through all the tags and see what needs edited
     std::size_t total_tags = 0;
     std::size_t total_replaced = 0;
@@ -519,7 +542,7 @@ int main(int argc, char * const *argv) {
                 break;
         }
         
-        if(!skip && refactor_tags(tag.full_path.string().c_str(), replacements, true, refactor_options.dry_run)) {
+        if(!skip && may_reference_replacements(tag) && refactor_tags(tag.full_path.string().c_str(), replacements, true, refactor_options.dry_run)) {
             tags_to_do.emplace_back(&tag);
         }
     }
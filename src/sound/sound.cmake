@@ -7,6 +7,7 @@ endif()
 if(${INVADER_SOUND})
     add_executable(invader-sound
         src/sound/sound.cpp
+        src/sound/sound_cache.cpp
     )
 
     target_link_libraries(invader-sound invader ${INVADER_CRT_NOGLOB})
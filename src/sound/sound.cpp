@@ -8,10 +8,13 @@
 #include <invader/sound/sound_encoder.hpp>
 #include <invader/sound/sound_reader.hpp>
 #include <invader/version.hpp>
+#include <invader/crc/hash.hpp>
+#include <invader/error.hpp>
 #include <vorbis/vorbisenc.h>
 #include <samplerate.h>
 #include <atomic>
 #include <thread>
+#include "sound_cache.hpp"
 
 using namespace Invader;
 using namespace Invader::HEK;
@@ -28,10 +31,63 @@ struct SoundOptions {
     std::optional<std::uint32_t> sample_rate;
     std::optional<std::uint16_t> bitrate;
     std::size_t max_threads = std::thread::hardware_concurrency() < 1 ? 1 : std::thread::hardware_concurrency();
+    std::size_t adpcm_segment_count = 1;
+    bool adpcm_report = false;
+    int resample_quality = SRC_SINC_BEST_QUALITY;
+    std::optional<std::filesystem::path> cache;
 };
 
-static void populate_pitch_range(std::vector<SoundReader::Sound> &permutations, const std::filesystem::path &directory, std::uint32_t &highest_sample_rate, std::uint16_t &highest_channel_count);
-static void process_permutation_thread(SoundReader::Sound *permutation, std::uint16_t highest_sample_rate, SoundFormat format, std::uint16_t highest_channel_count, std::atomic<std::size_t> *thread_count, bool fit_adpcm_block_size);
+// A permutation along with where it came from
+struct SourceSound : SoundReader::Sound {
+    /** Path to the source file */
+    std::filesystem::path source_path;
+
+    /** Hash of the source file (only set if caching) */
+    std::uint64_t source_hash = 0;
+
+    /** PCM has been decoded (if false, only the format was loaded from the cache) */
+    bool decoded = true;
+};
+
+struct AdpcmQualityReport {
+    double signal_energy = 0.0;
+    double serial_noise_energy = 0.0;
+    double segmented_noise_energy = 0.0;
+};
+
+// Resampler that holds onto its libsamplerate state so it can be reused for every permutation a worker processes
+class Resampler {
+public:
+    Resampler(int converter_type) noexcept : converter_type(converter_type) {}
+    Resampler(const Resampler &) = delete;
+    Resampler &operator=(const Resampler &) = delete;
+    ~Resampler() {
+        for(auto *state : this->states) {
+            if(state) {
+                src_delete(state);
+            }
+        }
+    }
+
+    /**
+     * Resample the interleaved samples, blocking until all of the output is generated.
+     * @param samples       samples to resample
+     * @param channel_count number of channels (1 or 2)
+     * @param ratio         output sample rate divided by input sample rate
+     * @return              resampled samples
+     */
+    std::vector<float> resample(const std::vector<float> &samples, std::size_t channel_count, double ratio);
+
+private:
+    int converter_type;
+    SRC_STATE *states[2] = {};
+};
+
+static void populate_pitch_range(std::vector<SourceSound> &permutations, const std::filesystem::path &directory, std::uint32_t &highest_sample_rate, std::uint16_t &highest_channel_count, const SoundOptions &sound_options);
+static SoundReader::Sound decode_sound(const std::filesystem::path &path, const std::vector<std::byte> &data);
+static void process_permutation_thread(std::vector<SourceSound *> *permutations, std::atomic<std::size_t> *permutation_index, std::uint16_t highest_sample_rate, SoundFormat format, std::uint16_t highest_channel_count, bool fit_adpcm_block_size, const SoundOptions *sound_options);
+static void process_permutation(SourceSound *permutation, std::uint16_t highest_sample_rate, SoundFormat format, std::uint16_t highest_channel_count, bool fit_adpcm_block_size, const SoundOptions &sound_options, Resampler &resampler);
+static void measure_xbox_adpcm_noise(const std::vector<std::byte> &pcm, const std::vector<std::byte> &adpcm, std::size_t channel_count, std::uint32_t sample_rate, double &signal_energy, double &noise_energy);
 
 template<typename T> static std::vector<std::byte> make_sound_tag(const std::filesystem::path &tag_path, const std::filesystem::path &data_path, SoundOptions &sound_options) {
     static constexpr std::size_t XBOX_ADPCM_SPLIT_SIZE = 65520;
@@ -152,15 +208,15 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
 
     std::uint16_t highest_channel_count = 0;
     std::uint32_t highest_sample_rate = 0;
-    std::vector<std::pair<std::vector<SoundReader::Sound>, std::string>> pitch_ranges;
+    std::vector<std::pair<std::vector<SourceSound>, std::string>> pitch_ranges;
 
     oprintf("Loading sounds...\n");
     oflush();
 
     // Load the sounds
     if(contains_files) {
-        auto &pitch_range = pitch_ranges.emplace_back(std::vector<SoundReader::Sound>(), "default");
-        populate_pitch_range(pitch_range.first, data_path, highest_sample_rate, highest_channel_count);
+        auto &pitch_range = pitch_ranges.emplace_back(std::vector<SourceSound>(), "default");
+        populate_pitch_range(pitch_range.first, data_path, highest_sample_rate, highest_channel_count, sound_options);
     }
     else if(contains_directories) {
         std::size_t i = 0;
@@ -170,8 +226,8 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
                 eprintf_error("Unexpected file %s", path.string().c_str());
                 std::exit(EXIT_FAILURE);
             }
-            auto &pitch_range = pitch_ranges.emplace_back(std::vector<SoundReader::Sound>(), path.filename().string());
-            populate_pitch_range(pitch_range.first, path, highest_sample_rate, highest_channel_count);
+            auto &pitch_range = pitch_ranges.emplace_back(std::vector<SourceSound>(), path.filename().string());
+            populate_pitch_range(pitch_range.first, path, highest_sample_rate, highest_channel_count, sound_options);
             if(i == NULL_INDEX) {
                 eprintf_error("%u or more pitch ranges are present", NULL_INDEX);
                 std::exit(EXIT_FAILURE);
@@ -241,24 +297,33 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
     };
 
     // Wait until we have room for more threads
-    auto wait_until_threads_are_open = [&thread_count, &sound_options]() {
-        while(thread_count >= sound_options.max_threads) {
+    auto wait_until_threads_are_open = [&thread_count, &sound_options](std::size_t threads_needed) {
+        while(thread_count + threads_needed > sound_options.max_threads) {
             std::this_thread::sleep_for(std::chrono::microseconds(1000));
         }
     };
 
     // Process things!
+    std::vector<SourceSound *> all_permutations;
     for(auto &pitch_range : pitch_ranges) {
         for(auto &permutation : pitch_range.first) {
-            total_sound_count++;
-            wait_until_threads_are_open();
-            thread_count++;
-            std::thread(process_permutation_thread, &permutation, highest_sample_rate, format, highest_channel_count, &thread_count, sound_tag.flags & SoundFlagsFlag::SOUND_FLAGS_FLAG_FIT_TO_ADPCM_BLOCKSIZE).detach();
+            all_permutations.emplace_back(&permutation);
         }
     }
+    total_sound_count = all_permutations.size();
+
+    std::atomic<std::size_t> permutation_index = 0;
+    std::vector<std::thread> threads;
+    std::size_t process_thread_count = std::min(sound_options.max_threads, total_sound_count);
+    threads.reserve(process_thread_count);
+    for(std::size_t t = 0; t < process_thread_count; t++) {
+        threads.emplace_back(process_permutation_thread, &all_permutations, &permutation_index, highest_sample_rate, format, highest_channel_count, sound_tag.flags & SoundFlagsFlag::SOUND_FLAGS_FLAG_FIT_TO_ADPCM_BLOCKSIZE, &sound_options);
+    }
 
     // Wait until done
-    wait_until_threads_are_done();
+    for(auto &t : threads) {
+        t.join();
+    }
 
     // Remove pitch ranges that are present in the tag but not in what we found
     while(true) {
@@ -314,19 +379,15 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
 
     // Make the sound tag
     const char *output_name = nullptr;
-    bool enable_threading_split_permutation_encoding = true;
     switch(format) {
         case SoundFormat::SOUND_FORMAT_16_BIT_PCM:
             output_name = "16-bit PCM";
-            enable_threading_split_permutation_encoding = false;
             break;
         case SoundFormat::SOUND_FORMAT_IMA_ADPCM:
             output_name = "IMA ADPCM";
-            enable_threading_split_permutation_encoding = false;
             break;
         case SoundFormat::SOUND_FORMAT_XBOX_ADPCM:
             output_name = "Xbox ADPCM";
-            enable_threading_split_permutation_encoding = false;
             break;
         case SoundFormat::SOUND_FORMAT_OGG_VORBIS:
             output_name = "Ogg Vorbis";
@@ -360,6 +421,10 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
 
     // Make sure we don't completely blow things up
     std::mutex encoding_mutex;
+    AdpcmQualityReport adpcm_quality_report;
+    
+    // Xbox ADPCM segments are encoded on their own threads, so they come out of the same budget as the permutations
+    std::size_t segment_count = format == SoundFormat::SOUND_FORMAT_XBOX_ADPCM ? std::min(sound_options.adpcm_segment_count, sound_options.max_threads) : 1;
 
     // Encode this
     for(std::size_t pr = 0; pr < pitch_range_count; pr++) {
@@ -386,7 +451,7 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
             std::size_t bytes_per_sample_all_channels = bytes_per_sample_one_channel * permutation.channel_count;
 
             // Encode a permutation
-            auto encode_permutation = [](auto *sound_tag, std::size_t pitch_range, std::size_t pitch_range_permutation, std::mutex *mutex, std::vector<std::byte> pcm, const SoundReader::Sound *permutation, bool is_dialogue, SoundFormat format, SoundOptions *sound_options, std::atomic<std::size_t> *thread_count) {
+            auto encode_permutation = [](auto *sound_tag, std::size_t pitch_range, std::size_t pitch_range_permutation, std::mutex *mutex, std::vector<std::byte> pcm, std::vector<std::byte> preceding_pcm, const SoundReader::Sound *permutation, bool is_dialogue, SoundFormat format, SoundOptions *sound_options, AdpcmQualityReport *adpcm_quality_report, std::size_t segment_count, std::atomic<std::size_t> *thread_count) {
                 auto generate_mouth_data = [&permutation](const std::vector<std::uint8_t> &pcm_8_bit) -> std::vector<std::byte> {
                     // Basically, take the sample rate, multiply by channel count, divide by tick rate (30 Hz), and round the result
                     std::size_t samples_per_tick = static_cast<std::size_t>((permutation->sample_rate * permutation->channel_count) / TICK_RATE + 0.5);
@@ -509,7 +574,21 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
 
                     // Encode to Xbox ADPCMeme
                     case SoundFormat::SOUND_FORMAT_XBOX_ADPCM:
-                        samples = Invader::SoundEncoder::encode_to_xbox_adpcm(pcm, permutation->bits_per_sample, permutation->channel_count);
+                        samples = Invader::SoundEncoder::encode_to_xbox_adpcm(pcm, permutation->bits_per_sample, permutation->channel_count, segment_count, preceding_pcm);
+
+                        // Compare against the serial encoder if we want to know how much quality we lost
+                        if(sound_options->adpcm_report) {
+                            auto serial_samples = Invader::SoundEncoder::encode_to_xbox_adpcm(pcm, permutation->bits_per_sample, permutation->channel_count, 1, preceding_pcm);
+                            double signal_energy, serial_noise_energy, segmented_noise_energy;
+                            measure_xbox_adpcm_noise(pcm, serial_samples, permutation->channel_count, permutation->sample_rate, signal_energy, serial_noise_energy);
+                            measure_xbox_adpcm_noise(pcm, samples, permutation->channel_count, permutation->sample_rate, signal_energy, segmented_noise_energy);
+
+                            mutex->lock();
+                            adpcm_quality_report->serial_noise_energy += serial_noise_energy;
+                            adpcm_quality_report->segmented_noise_energy += segmented_noise_energy;
+                            adpcm_quality_report->signal_energy += signal_energy;
+                            mutex->unlock();
+                        }
                         break;
 
                     default:
@@ -528,30 +607,48 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
                 mutex->unlock();
 
                 // Finish up
-                (*thread_count)--;
+                (*thread_count) -= segment_count;
             };
 
-            // Split things we can't trivially split losslessly
-            if(split && enable_threading_split_permutation_encoding) {
-                std::size_t max_split_size = SPLIT_BUFFER_SIZE - (SPLIT_BUFFER_SIZE % bytes_per_sample_all_channels);
+            // Split the PCM into chunks and encode each chunk on its own thread
+            if(split) {
+                std::size_t max_split_size;
+
+                // Xbox ADPCM chunks are cut on block boundaries so each chunk encodes to at most XBOX_ADPCM_SPLIT_SIZE bytes
+                if(format == SoundFormat::SOUND_FORMAT_XBOX_ADPCM) {
+                    std::size_t pcm_block_size = SoundEncoder::calculate_adpcm_pcm_block_size(permutation.channel_count) * bytes_per_sample_one_channel;
+                    max_split_size = XBOX_ADPCM_SPLIT_SIZE / SoundEncoder::calculate_adpcm_block_size(permutation.channel_count) * pcm_block_size;
+
+                    // Incomplete blocks are discarded by the encoder anyway, so drop them now rather than making an empty permutation at the end
+                    permutation.pcm.resize(permutation.pcm.size() - permutation.pcm.size() % pcm_block_size);
+                }
+                else {
+                    max_split_size = SPLIT_BUFFER_SIZE - (SPLIT_BUFFER_SIZE % bytes_per_sample_all_channels);
+                }
 
+                std::size_t total_size = permutation.pcm.size();
                 std::size_t digested = 0;
-                while(permutation.pcm.size() > 0) {
+                do {
                     // Basically, if we haven't encoded anything, use the i-th permutation, otherwise make a new one as a copy
                     encoding_mutex.lock();
                     auto &p = digested == 0 ? pitch_range.permutations[i] : pitch_range.permutations.emplace_back(pitch_range.permutations[i]);
                     encoding_mutex.unlock();
-                    std::size_t remaining_size = permutation.pcm.size();
+                    std::size_t remaining_size = total_size - digested;
                     std::size_t permutation_size = remaining_size > max_split_size ? max_split_size : remaining_size;
 
                     // Encode it
-                    auto *sample_data_start = permutation.pcm.data();
+                    auto *sample_data_start = permutation.pcm.data() + digested;
                     auto sample_data = std::vector<std::byte>(sample_data_start, sample_data_start + permutation_size);
-                    permutation.pcm = std::vector<std::byte>(permutation.pcm.begin() + permutation_size, permutation.pcm.end());
-                    permutation.pcm.shrink_to_fit();
+
+                    // Xbox ADPCM chunks also get the blocks before them so the encoder continues from where the previous chunk left off rather than starting over
+                    std::vector<std::byte> preceding_data;
+                    if(format == SoundFormat::SOUND_FORMAT_XBOX_ADPCM) {
+                        std::size_t preceding_size = std::min(digested, SoundEncoder::XBOX_ADPCM_WARM_UP_BLOCK_COUNT * SoundEncoder::calculate_adpcm_pcm_block_size(permutation.channel_count) * bytes_per_sample_one_channel);
+                        preceding_data = std::vector<std::byte>(sample_data_start - preceding_size, sample_data_start);
+                    }
                     digested += permutation_size;
 
-                    if(permutation.pcm.size() == 0) {
+                    if(digested == total_size) {
                         p.next_permutation_index = NULL_INDEX;
                     }
                     else {
@@ -565,22 +662,23 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
                     }
 
                     // Wait until we have threads cleared up
-                    wait_until_threads_are_open();
+                    wait_until_threads_are_open(segment_count);
 
                     // Punch it
-                    thread_count++;
-                    std::thread(encode_permutation, &sound_tag, pr, &p - pitch_range.permutations.data(), &encoding_mutex, std::move(sample_data), &permutation, is_dialogue, format, &sound_options, &thread_count).detach();
+                    thread_count += segment_count;
+                    std::thread(encode_permutation, &sound_tag, pr, &p - pitch_range.permutations.data(), &encoding_mutex, std::move(sample_data), std::move(preceding_data), &permutation, is_dialogue, format, &sound_options, &adpcm_quality_report, segment_count, &thread_count).detach();
                 }
+                while(digested < total_size);
             }
             else {
                 // Wait until we have threads cleared up
-                wait_until_threads_are_open();
+                wait_until_threads_are_open(segment_count);
 
                 // Punch it
-                thread_count++;
+                thread_count += segment_count;
                 auto &p = pitch_range.permutations[i];
                 p.next_permutation_index = NULL_INDEX;
-                std::thread(encode_permutation, &sound_tag, pr, &p - pitch_range.permutations.data(), &encoding_mutex, std::move(permutation.pcm), &permutation, is_dialogue, format, &sound_options, &thread_count).detach();
+                std::thread(encode_permutation, &sound_tag, pr, &p - pitch_range.permutations.data(), &encoding_mutex, std::move(permutation.pcm), std::vector<std::byte>(), &permutation, is_dialogue, format, &sound_options, &adpcm_quality_report, segment_count, &thread_count).detach();
             }
 
             // Print sound info
@@ -594,36 +692,24 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
     // Wait until we have 0 threads left
     wait_until_threads_are_done();
 
-    // Next, if we can split losslessly, do it
-    if(split && !enable_threading_split_permutation_encoding) {
-        auto split_size = format == SoundFormat::SOUND_FORMAT_XBOX_ADPCM ? XBOX_ADPCM_SPLIT_SIZE : SPLIT_BUFFER_SIZE;
-
-        for(std::size_t pr = 0; pr < pitch_range_count; pr++) {
-            auto &pitch_range = sound_tag.pitch_ranges[pr];
-            for(std::size_t ap = 0; ap < pitch_range.actual_permutation_count; ap++) {
-                auto *next_permutation = &pitch_range.permutations[ap];
-                auto samples = std::move(next_permutation->samples);
-                next_permutation->samples.clear();
-                auto permutation_template = *next_permutation;
-                permutation_template.next_permutation_index = NULL_INDEX;
-                std::size_t samples_offset = 0;
-
-                while(true) {
-                    auto subpermutation_size = std::min(split_size, samples.size() - samples_offset);
-                    next_permutation->samples = std::vector<std::byte>(samples.data() + samples_offset, samples.data() + samples_offset + subpermutation_size);
-                    samples_offset += subpermutation_size;
-
-                    // If we've hit the end, we're done
-                    if(samples_offset == samples.size()) {
-                        break;
-                    }
-
-                    // Add the next permutation
-                    next_permutation->next_permutation_index = pitch_range.permutations.size();
-                    next_permutation = &pitch_range.permutations.emplace_back(permutation_template);
-                }
+    // Show how the segmented encoder did
+    if(sound_options.adpcm_report && format == SoundFormat::SOUND_FORMAT_XBOX_ADPCM) {
+        // If there is no noise at all (e.g. silence), there's no ratio to show
+        auto snr = [&adpcm_quality_report](double noise_energy) -> std::string {
+            if(noise_energy == 0.0) {
+                return "lossless";
             }
+            char snr_text[64];
+            std::snprintf(snr_text, sizeof(snr_text), "%.03f dB", 10.0 * std::log10(adpcm_quality_report.signal_energy / noise_energy));
+            return snr_text;
+        };
+        auto serial_snr = snr(adpcm_quality_report.serial_noise_energy);
+        auto segmented_snr = snr(adpcm_quality_report.segmented_noise_energy);
+        oprintf("Xbox ADPCM SNR: %s serial, %s with %zu segment%s", serial_snr.c_str(), segmented_snr.c_str(), segment_count, segment_count == 1 ? "" : "s");
+        if(adpcm_quality_report.serial_noise_energy != 0.0 && adpcm_quality_report.segmented_noise_energy != 0.0) {
+            oprintf(" (%+.03f dB)", 10.0 * std::log10(adpcm_quality_report.serial_noise_energy / adpcm_quality_report.segmented_noise_energy));
         }
+        oprintf("\n");
     }
 
     auto sound_tag_data = sound_tag.generate_hek_tag_data(TagFourCC::TAG_FOURCC_SOUND, true);
@@ -651,7 +737,11 @@ int main(int argc, const char **argv) {
         CommandLineOption("compress-level", 'l', 1, "Set the compression level. This can be between 0.0 and 1.0. For Ogg Vorbis, higher levels result in better quality but worse sizes. Default: 0.8", "<lvl>"),
         CommandLineOption("bitrate", 'R', 1, "Set the bitrate in kilobits per second. This only applies to vorbis.", "<br>"),
         CommandLineOption("class", 'c', 1, "Set the class. This is required when generating new sounds. Can be: ambient_computers, ambient_machinery, ambient_nature, device_computers, device_door, device_force_field, device_machinery, device_nature, first_person_damage, game_event, music, object_impacts, particle_impacts, projectile_impact, projectile_detonation, scripted_dialog_force_unspatialized, scripted_dialog_other, scripted_dialog_player, scripted_effect, slow_particle_impacts, unit_dialog, unit_footsteps, vehicle_collision, vehicle_engine, weapon_charge, weapon_empty, weapon_fire, weapon_idle, weapon_overheat, weapon_ready, weapon_reload", "<class>"),
-        CommandLineOption("threads", 'j', 1, "Set the number of threads to use for parallel resampling and encoding. Default: CPU thread count")
+        CommandLineOption("threads", 'j', 1, "Set the number of threads to use for parallel resampling and encoding. Default: CPU thread count"),
+        CommandLineOption("adpcm-segments", 'a', 1, "Split each Xbox ADPCM permutation into this many segments on block boundaries and encode them in parallel. Each segment is primed with the blocks before it, so the output is nearly identical to serial encoding. Segments count toward the number of threads set with -j. Default: 1", "<#>"),
+        CommandLineOption("adpcm-report", 'q', 0, "Also encode Xbox ADPCM serially and show the signal-to-noise ratio of both encoders. This is slower."),
+        CommandLineOption("resample-quality", 'Q', 1, "Set the resampler quality. Can be: fastest, medium, or best. Default: best", "<q>"),
+        CommandLineOption("cache", 'K', 1, "Cache decoded and resampled audio in this directory. Later runs with the same source files and settings skip straight to encoding.", "<dir>")
     };
 
     static constexpr char DESCRIPTION[] = "Create or modify a sound tag.";
@@ -689,6 +779,44 @@ int main(int argc, const char **argv) {
                 sound_options.split = false;
                 break;
 
+            case 'a':
+                try {
+                    sound_options.adpcm_segment_count = std::stoul(arguments[0]);
+                }
+                catch(std::exception &) {
+                    eprintf_error("Invalid number of segments %s\n", arguments[0]);
+                    std::exit(EXIT_FAILURE);
+                }
+                if(sound_options.adpcm_segment_count < 1) {
+                    eprintf_error("At least one segment is required");
+                    std::exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'q':
+                sound_options.adpcm_report = true;
+                break;
+
+            case 'K':
+                sound_options.cache = arguments[0];
+                break;
+
+            case 'Q':
+                if(std::strcmp(arguments[0], "fastest") == 0) {
+                    sound_options.resample_quality = SRC_SINC_FASTEST;
+                }
+                else if(std::strcmp(arguments[0], "medium") == 0) {
+                    sound_options.resample_quality = SRC_SINC_MEDIUM_QUALITY;
+                }
+                else if(std::strcmp(arguments[0], "best") == 0) {
+                    sound_options.resample_quality = SRC_SINC_BEST_QUALITY;
+                }
+                else {
+                    eprintf_error("Unknown resample quality %s (should be \"fastest\", \"medium\", or \"best\")", arguments[0]);
+                    std::exit(EXIT_FAILURE);
+                }
+                break;
+
             case 'R':
                 try {
                     sound_options.bitrate = static_cast<std::uint16_t>(std::stol(arguments[0]));
@@ -802,7 +930,7 @@ int main(int argc, const char **argv) {
     }
 }
 
-static void populate_pitch_range(std::vector<SoundReader::Sound> &permutations, const std::filesystem::path &directory, std::uint32_t &highest_sample_rate, std::uint16_t &highest_channel_count) {
+static void populate_pitch_range(std::vector<SourceSound> &permutations, const std::filesystem::path &directory, std::uint32_t &highest_sample_rate, std::uint16_t &highest_channel_count, const SoundOptions &sound_options) {
     for(auto &wav : std::filesystem::directory_iterator(directory)) {
         // Skip directories
         auto path = wav.path();
@@ -816,17 +944,37 @@ static void populate_pitch_range(std::vector<SoundReader::Sound> &permutations,
         }
 
         // Get the sound
-        SoundReader::Sound sound = {};
+        SourceSound sound = {};
+        sound.source_path = path;
         try {
-            if(extension == ".wav" || extension == ".wave") {
-                sound = SoundReader::sound_from_wav_file(path);
+            if(extension != ".wav" && extension != ".wave" && extension != ".flac") {
+                eprintf_error("Unsupported input file %s.\nSupported input formats are Free Lossless Audio Codec (.flac) or Waveform Audio (.wav, .wave).", path.string().c_str());
+                std::exit(EXIT_FAILURE);
+            }
+
+            if(sound_options.cache.has_value()) {
+                auto source_data = File::open_file(path);
+                if(!source_data.has_value()) {
+                    throw FailedToOpenFileException();
+                }
+                sound.source_hash = fnv1a_64(*source_data);
+
+                // If we've seen this file before, we only need its format for now; the PCM may not even be needed if the processed sound is cached
+                auto cached_sound = SoundCache::load_sound(*sound_options.cache, SoundCache::source_sound_key(sound.source_hash));
+                if(cached_sound.has_value()) {
+                    static_cast<SoundReader::Sound &>(sound) = std::move(*cached_sound);
+                    sound.decoded = false;
+                }
+                else {
+                    static_cast<SoundReader::Sound &>(sound) = decode_sound(path, *source_data);
+                    SoundCache::save_sound(*sound_options.cache, SoundCache::source_sound_key(sound.source_hash), sound, false);
+                }
             }
             else if(extension == ".flac") {
-                sound = SoundReader::sound_from_flac_file(path);
+                static_cast<SoundReader::Sound &>(sound) = SoundReader::sound_from_flac_file(path);
             }
             else {
-                eprintf_error("Unsupported input file %s.\nSupported input formats are Free Lossless Audio Codec (.flac) or Waveform Audio (.wav, .wave).", path.string().c_str());
-                std::exit(EXIT_FAILURE);
+                static_cast<SoundReader::Sound &>(sound) = SoundReader::sound_from_wav_file(path);
             }
         }
         catch(std::exception &e) {
@@ -883,16 +1031,115 @@ static void populate_pitch_range(std::vector<SoundReader::Sound> &permutations,
     }
 }
 
-static void process_permutation_thread(SoundReader::Sound *permutation, std::uint16_t highest_sample_rate, SoundFormat format, std::uint16_t highest_channel_count, std::atomic<std::size_t> *thread_count, bool fit_adpcm_block_size) {
-    // Calculate some stuff
-    std::size_t bytes_per_sample = permutation->bits_per_sample / 8;
-    std::size_t sample_count = permutation->pcm.size() / bytes_per_sample;
+std::vector<float> Resampler::resample(const std::vector<float> &samples, std::size_t channel_count, double ratio) {
+    // Mutex for errors
+    static std::mutex error_mutex;
+
+    // Make a state for this channel count if we don't have one yet; otherwise reset it so it's as good as new
+    auto *&state = this->states[channel_count - 1];
+    int res = 0;
+    if(state == nullptr) {
+        state = src_new(this->converter_type, static_cast<int>(channel_count), &res);
+        if(state == nullptr) {
+            error_mutex.lock();
+            eprintf_error("Failed to create resampler: %s", src_strerror(res));
+            std::exit(EXIT_FAILURE);
+        }
+    }
+    else {
+        src_reset(state);
+    }
+
+    std::vector<float> new_samples(samples.size() * ratio);
+
+    // Resample it (this is the same as src_simple() but without making a new state each time)
+    SRC_DATA data = {};
+    data.data_in = samples.data();
+    data.data_out = new_samples.data();
+    data.input_frames = samples.size() / channel_count;
+    data.output_frames = new_samples.size() / channel_count;
+    data.src_ratio = ratio;
+    data.end_of_input = 1;
+    res = src_process(state, &data);
+    if(res) {
+        error_mutex.lock();
+        eprintf_error("Failed to resample: %s", src_strerror(res));
+        std::exit(EXIT_FAILURE);
+    }
+
+    new_samples.resize(data.output_frames_gen * channel_count);
+    return new_samples;
+}
+
+static SoundReader::Sound decode_sound(const std::filesystem::path &path, const std::vector<std::byte> &data) {
+    auto extension = path.extension().string();
+    for(auto &c : extension) {
+        c = std::tolower(c);
+    }
+    if(extension == ".flac") {
+        return SoundReader::sound_from_flac(data.data(), data.size());
+    }
+    else {
+        return SoundReader::sound_from_wav(data.data(), data.size());
+    }
+}
+
+static void process_permutation_thread(std::vector<SourceSound *> *permutations, std::atomic<std::size_t> *permutation_index, std::uint16_t highest_sample_rate, SoundFormat format, std::uint16_t highest_channel_count, bool fit_adpcm_block_size, const SoundOptions *sound_options) {
+    Resampler resampler(sound_options->resample_quality);
+    while(true) {
+        std::size_t i = (*permutation_index)++;
+        if(i >= permutations->size()) {
+            return;
+        }
+        process_permutation((*permutations)[i], highest_sample_rate, format, highest_channel_count, fit_adpcm_block_size, *sound_options, resampler);
+    }
+}
 
+static void process_permutation(SourceSound *permutation, std::uint16_t highest_sample_rate, SoundFormat format, std::uint16_t highest_channel_count, bool fit_adpcm_block_size, const SoundOptions &sound_options, Resampler &resampler) {
     // Mutex for errors
     static std::mutex error_mutex;
 
+    bool force_16_bit = format == SoundFormat::SOUND_FORMAT_16_BIT_PCM || format == SoundFormat::SOUND_FORMAT_XBOX_ADPCM;
+    fit_adpcm_block_size = fit_adpcm_block_size && format == SoundFormat::SOUND_FORMAT_XBOX_ADPCM;
+
+    // See if we already did this
+    std::optional<std::uint64_t> cache_key;
+    if(sound_options.cache.has_value()) {
+        cache_key = SoundCache::processed_sound_key(permutation->source_hash, highest_sample_rate, highest_channel_count, force_16_bit ? 16 : 0, sound_options.resample_quality, fit_adpcm_block_size);
+        auto cached_sound = SoundCache::load_sound(*sound_options.cache, *cache_key);
+        if(cached_sound.has_value()) {
+            cached_sound->name = std::move(permutation->name);
+            static_cast<SoundReader::Sound &>(*permutation) = std::move(*cached_sound);
+            permutation->decoded = true;
+            return;
+        }
+
+        // Only the format came from the cache, so we need to decode it now
+        if(!permutation->decoded) {
+            try {
+                auto source_data = File::open_file(permutation->source_path);
+                if(!source_data.has_value()) {
+                    throw FailedToOpenFileException();
+                }
+                auto sound = decode_sound(permutation->source_path, *source_data);
+                sound.name = std::move(permutation->name);
+                static_cast<SoundReader::Sound &>(*permutation) = std::move(sound);
+                permutation->decoded = true;
+            }
+            catch(std::exception &e) {
+                error_mutex.lock();
+                eprintf_error("Failed to load %s: %s", permutation->source_path.string().c_str(), e.what());
+                std::exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    // Calculate some stuff
+    std::size_t bytes_per_sample = permutation->bits_per_sample / 8;
+    std::size_t sample_count = permutation->pcm.size() / bytes_per_sample;
+
     // Bits per sample doesn't match; we can fix that though
-    if(bytes_per_sample != sizeof(std::uint16_t) && (format == SoundFormat::SOUND_FORMAT_16_BIT_PCM || format == SoundFormat::SOUND_FORMAT_XBOX_ADPCM)) {
+    if(bytes_per_sample != sizeof(std::uint16_t) && force_16_bit) {
         std::size_t new_bytes_per_sample = sizeof(std::uint16_t);
         permutation->pcm = SoundEncoder::convert_int_to_int(permutation->pcm, permutation->bits_per_sample, new_bytes_per_sample * 8);
         bytes_per_sample = new_bytes_per_sample;
@@ -944,23 +1191,10 @@ static void process_permutation_thread(SoundReader::Sound *permutation, std::uin
     if(static_cast<double>(highest_sample_rate) != permutation->sample_rate) {
         double ratio = static_cast<double>(highest_sample_rate) / permutation->sample_rate;
         std::vector<float> float_samples = SoundEncoder::convert_int_to_float(permutation->pcm, permutation->bits_per_sample);
-        std::vector<float> new_samples(float_samples.size() * ratio);
         permutation->sample_rate = highest_sample_rate;
 
         // Resample it
-        SRC_DATA data = {};
-        data.data_in = float_samples.data();
-        data.data_out = new_samples.data();
-        data.input_frames = float_samples.size() / permutation->channel_count;
-        data.output_frames = new_samples.size() / permutation->channel_count;
-        data.src_ratio = ratio;
-        int res = src_simple(&data, SRC_SINC_BEST_QUALITY, permutation->channel_count);
-        if(res) {
-            error_mutex.lock();
-            eprintf_error("Failed to resample: %s", src_strerror(res));
-            std::exit(EXIT_FAILURE);
-        }
-        new_samples.resize(data.output_frames_gen * permutation->channel_count);
+        std::vector<float> new_samples = resampler.resample(float_samples, permutation->channel_count, ratio);
 
         // Set stuff
         if(format == SoundFormat::SOUND_FORMAT_16_BIT_PCM) {
@@ -978,29 +1212,15 @@ static void process_permutation_thread(SoundReader::Sound *permutation, std::uin
     auto trip_adpcm_block_size = adpcm_block_size * 123;
     auto quad_adpcm_block_size = adpcm_block_size * 124;
 
-    if(fit_adpcm_block_size && format == SoundFormat::SOUND_FORMAT_XBOX_ADPCM && sample_count > quad_adpcm_block_size) {
+    if(fit_adpcm_block_size && sample_count > quad_adpcm_block_size) {
         std::size_t delta = trip_adpcm_block_size + (adpcm_block_size - (sample_count % adpcm_block_size));
         if(delta > 0) {
             double ratio = delta / static_cast<double>(quad_adpcm_block_size);
             std::vector<float> float_samples = SoundEncoder::convert_int_to_float(permutation->pcm, permutation->bits_per_sample);
-            std::vector<float> new_samples(float_samples.size() * ratio);
             auto new_quad = static_cast<std::size_t>(quad_adpcm_block_size * ratio);
 
             // Resample it
-            SRC_DATA data = {};
-            data.data_in = float_samples.data();
-            data.data_out = new_samples.data();
-            data.input_frames = float_samples.size() / permutation->channel_count;
-            data.output_frames = new_samples.size() / permutation->channel_count;
-            data.src_ratio = ratio;
-            int res = src_simple(&data, SRC_SINC_BEST_QUALITY, permutation->channel_count);
-            if(res) {
-                error_mutex.lock();
-                eprintf_error("Failed to resample: %s", src_strerror(res));
-                std::exit(EXIT_FAILURE);
-            }
-
-            new_samples.resize(data.output_frames_gen * permutation->channel_count);
+            std::vector<float> new_samples = resampler.resample(float_samples, permutation->channel_count, ratio);
             auto new_int_samples = SoundEncoder::convert_float_to_int(new_samples, permutation->bits_per_sample);
 
             permutation->pcm.erase(permutation->pcm.begin(), permutation->pcm.begin() + quad_adpcm_block_size * bytes_per_sample);
@@ -1011,5 +1231,23 @@ static void process_permutation_thread(SoundReader::Sound *permutation, std::uin
         }
     }
 
-    (*thread_count)--;
+    // Save it for next time
+    if(cache_key.has_value()) {
+        SoundCache::save_sound(*sound_options.cache, *cache_key, *permutation);
+    }
+}
+
+static void measure_xbox_adpcm_noise(const std::vector<std::byte> &pcm, const std::vector<std::byte> &adpcm, std::size_t channel_count, std::uint32_t sample_rate, double &signal_energy, double &noise_energy) {
+    // Only compare the samples that were actually encoded (incomplete blocks get dropped)
+    auto decoded = SoundReader::sound_from_xbox_adpcm(adpcm.data(), adpcm.size(), channel_count, sample_rate).pcm;
+    std::size_t sample_count = std::min(decoded.size(), pcm.size()) / sizeof(std::int16_t);
+
+    signal_energy = 0.0;
+    noise_energy = 0.0;
+    for(std::size_t i = 0; i < sample_count; i++) {
+        double original = SoundEncoder::read_sample(pcm.data() + i * sizeof(std::int16_t), 16);
+        double difference = original - SoundEncoder::read_sample(decoded.data() + i * sizeof(std::int16_t), 16);
+        signal_energy += original * original;
+        noise_energy += difference * difference;
+    }
 }
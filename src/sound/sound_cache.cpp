@@ -0,0 +1,109 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <invader/crc/hash.hpp>
+#include <invader/file/file.hpp>
+#include <invader/hek/endian.hpp>
+#include <invader/printf.hpp>
+#include "sound_cache.hpp"
+
+namespace Invader::SoundCache {
+    // Bump this whenever the format or the way sounds get processed changes so old entries get ignored
+    static constexpr std::uint32_t SOUND_CACHE_VERSION = 2;
+
+    // What kind of entry a key is for, so a source sound and a processed sound can never have the same key
+    enum SoundCacheKeyKind : std::uint64_t {
+        SOUND_CACHE_KEY_SOURCE = 1,
+        SOUND_CACHE_KEY_PROCESSED = 2
+    };
+    static constexpr char SOUND_CACHE_MAGIC[8] = "invsndc";
+
+    struct SoundCacheHeader {
+        char magic[sizeof(SOUND_CACHE_MAGIC)];
+        HEK::LittleEndian<std::uint32_t> version;
+        HEK::LittleEndian<std::uint32_t> sample_rate;
+        HEK::LittleEndian<std::uint32_t> channel_count;
+        HEK::LittleEndian<std::uint32_t> bits_per_sample;
+        HEK::LittleEndian<std::uint32_t> input_sample_rate;
+        HEK::LittleEndian<std::uint32_t> input_channel_count;
+        HEK::LittleEndian<std::uint32_t> input_bits_per_sample;
+        HEK::LittleEndian<std::uint32_t> pcm_size;
+    };
+    static_assert(sizeof(SoundCacheHeader) == 0x28);
+
+    static std::filesystem::path path_for_key(const std::filesystem::path &cache_directory, std::uint64_t key) {
+        char file_name[32];
+        std::snprintf(file_name, sizeof(file_name), "%016llx.bin", static_cast<unsigned long long>(key));
+        return cache_directory / file_name;
+    }
+
+    std::uint64_t source_sound_key(std::uint64_t source_hash) noexcept {
+        HEK::LittleEndian<std::uint64_t> parameters[] = { SOUND_CACHE_KEY_SOURCE, source_hash, SOUND_CACHE_VERSION };
+        return fnv1a_64(reinterpret_cast<const std::byte *>(parameters), sizeof(parameters));
+    }
+
+    std::uint64_t processed_sound_key(std::uint64_t source_hash, std::uint32_t sample_rate, std::uint16_t channel_count, std::uint32_t bits_per_sample, int resample_quality, bool fit_block_size) noexcept {
+        HEK::LittleEndian<std::uint64_t> parameters[] = { SOUND_CACHE_KEY_PROCESSED, source_hash, sample_rate, channel_count, bits_per_sample, static_cast<std::uint64_t>(resample_quality), fit_block_size, SOUND_CACHE_VERSION };
+        return fnv1a_64(reinterpret_cast<const std::byte *>(parameters), sizeof(parameters));
+    }
+
+    std::optional<SoundReader::Sound> load_sound(const std::filesystem::path &cache_directory, std::uint64_t key) {
+        // Nothing cached yet is not an error
+        auto path = path_for_key(cache_directory, key);
+        std::error_code ec;
+        if(!std::filesystem::is_regular_file(path, ec)) {
+            return std::nullopt;
+        }
+
+        auto data_maybe = File::open_file(path);
+        if(!data_maybe.has_value()) {
+            return std::nullopt;
+        }
+        auto &data = *data_maybe;
+
+        // Make sure it's valid
+        if(data.size() < sizeof(SoundCacheHeader)) {
+            return std::nullopt;
+        }
+        const auto &header = *reinterpret_cast<const SoundCacheHeader *>(data.data());
+        if(std::memcmp(header.magic, SOUND_CACHE_MAGIC, sizeof(header.magic)) != 0 || header.version != SOUND_CACHE_VERSION || data.size() - sizeof(header) != header.pcm_size) {
+            return std::nullopt;
+        }
+
+        SoundReader::Sound sound = {};
+        sound.sample_rate = header.sample_rate;
+        sound.channel_count = static_cast<std::uint16_t>(header.channel_count.read());
+        sound.bits_per_sample = header.bits_per_sample;
+        sound.input_sample_rate = header.input_sample_rate;
+        sound.input_channel_count = header.input_channel_count;
+        sound.input_bits_per_sample = header.input_bits_per_sample;
+        sound.pcm = std::vector<std::byte>(data.begin() + sizeof(header), data.end());
+        return sound;
+    }
+
+    void save_sound(const std::filesystem::path &cache_directory, std::uint64_t key, const SoundReader::Sound &sound, bool save_pcm) {
+        std::size_t pcm_size = save_pcm ? sound.pcm.size() : 0;
+        if(pcm_size > UINT32_MAX) {
+            return;
+        }
+
+        std::vector<std::byte> data(sizeof(SoundCacheHeader) + pcm_size);
+        auto &header = *reinterpret_cast<SoundCacheHeader *>(data.data());
+        std::memcpy(header.magic, SOUND_CACHE_MAGIC, sizeof(header.magic));
+        header.version = SOUND_CACHE_VERSION;
+        header.sample_rate = sound.sample_rate;
+        header.channel_count = sound.channel_count;
+        header.bits_per_sample = sound.bits_per_sample;
+        header.input_sample_rate = sound.input_sample_rate;
+        header.input_channel_count = sound.input_channel_count;
+        header.input_bits_per_sample = sound.input_bits_per_sample;
+        header.pcm_size = static_cast<std::uint32_t>(pcm_size);
+        if(pcm_size) {
+            std::memcpy(data.data() + sizeof(header), sound.pcm.data(), pcm_size);
+        }
+
+        std::error_code ec;
+        std::filesystem::create_directories(cache_directory, ec);
+        auto path = path_for_key(cache_directory, key);
+        File::save_file_atomically(path, data);
+    }
+}
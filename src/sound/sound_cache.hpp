@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__SOUND__SOUND_CACHE_HPP
+#define INVADER__SOUND__SOUND_CACHE_HPP
+
+#include <filesystem>
+#include <optional>
+#include <cstdint>
+#include <invader/sound/sound_reader.hpp>
+
+namespace Invader::SoundCache {
+    /**
+     * Get the key for a decoded source sound
+     * @param source_hash hash of the source file
+     * @return            key
+     */
+    std::uint64_t source_sound_key(std::uint64_t source_hash) noexcept;
+
+    /**
+     * Get the key for a processed sound
+     * @param source_hash      hash of the source file
+     * @param sample_rate      sample rate it was resampled to
+     * @param channel_count    channel count it was mixed to
+     * @param bits_per_sample  bits per sample it was converted to, or 0 if the source bit depth was kept
+     * @param resample_quality libsamplerate converter used for resampling
+     * @param fit_block_size   the sound was resampled to fit Xbox ADPCM blocks
+     * @return                 key
+     */
+    std::uint64_t processed_sound_key(std::uint64_t source_hash, std::uint32_t sample_rate, std::uint16_t channel_count, std::uint32_t bits_per_sample, int resample_quality, bool fit_block_size) noexcept;
+
+    /**
+     * Load a sound from the cache. The name of the sound is not stored.
+     * @param cache_directory cache directory
+     * @param key             key of the sound (a source sound key or a processed sound key)
+     * @return                sound if found and valid
+     */
+    std::optional<SoundReader::Sound> load_sound(const std::filesystem::path &cache_directory, std::uint64_t key);
+
+    /**
+     * Save a sound to the cache. Failing to save is not an error; it'll just be slower next time.
+     * @param cache_directory cache directory
+     * @param key             key of the sound (a source sound key or a processed sound key)
+     * @param sound           sound to save
+     * @param save_pcm        save the PCM data (if false, only the format is saved)
+     */
+    void save_sound(const std::filesystem::path &cache_directory, std::uint64_t key, const SoundReader::Sound &sound, bool save_pcm = true);
+}
+
+#endif
@@ -3,8 +3,10 @@
 #include <invader/sound/sound_encoder.hpp>
 #include <invader/printf.hpp>
 #include <invader/error.hpp>
+#include <algorithm>
 #include <memory>
 #include <cstdint>
+#include <thread>
 
 extern "C" {
 #include "adpcm_xq/adpcm-lib.h"
@@ -21,14 +23,71 @@ namespace Invader::SoundEncoder {
         return calculate_samples_per_block() * channel_count;
     }
     
+    std::size_t calculate_adpcm_block_size(std::size_t channel_count) noexcept {
+        return (code_chunks_count * 4 + 4) * channel_count;
+    }
+    
+    // Encode block_count blocks, first running warm_up_block_count blocks (which directly precede pcm_stream) through the encoder so the step indices match what a serial encode would have at this point
+    static void encode_xbox_adpcm_blocks(const std::int16_t *pcm_stream, std::uint8_t *adpcm_stream, std::size_t block_count, std::size_t warm_up_block_count, std::size_t channel_count) {
+        std::size_t samples_per_block = calculate_samples_per_block();
+        std::size_t pcm_block_size   = calculate_adpcm_pcm_block_size(channel_count);  // number of pcm sint16 per block
+        std::size_t adpcm_block_size = calculate_adpcm_block_size(channel_count);  // number of adpcm bytes per block
+        std::size_t num_bytes_decoded = 0;
+
+        std::int32_t average_deltas[2];
+        void *adpcm_context = NULL;
+
+        // Start from the warm-up blocks if we have any
+        pcm_stream -= warm_up_block_count * pcm_block_size;
+
+        // calculate initial adpcm predictors using decaying average
+        for (std::size_t c = 0; c < channel_count; c++) {
+            average_deltas[c] = 0;
+            for (std::size_t i = c + pcm_block_size - channel_count; i >= channel_count; i -= channel_count) {
+                average_deltas[c] = (average_deltas[c] / 8) + std::abs(static_cast<std::int32_t>(pcm_stream[i]) - pcm_stream[i - channel_count]);
+            }
+            average_deltas[c] /= 8;
+        }
+
+        adpcm_context = adpcm_create_context(channel_count, 3, 0, average_deltas);
+
+        // Warm up! The output here is thrown away.
+        std::uint8_t warm_up_block[MAX_AUDIO_CHANNEL_COUNT * (code_chunks_count * 4 + 4)];
+        for (std::size_t b = 0; b < warm_up_block_count; b++) {
+            adpcm_encode_block(adpcm_context, warm_up_block, &num_bytes_decoded, pcm_stream, samples_per_block);
+            pcm_stream += pcm_block_size;
+        }
+
+        // Encode!
+        for (std::size_t b = 0; b < block_count; b++) {
+            adpcm_encode_block(adpcm_context, adpcm_stream, &num_bytes_decoded, pcm_stream, samples_per_block);
+            adpcm_stream += adpcm_block_size;
+            pcm_stream += pcm_block_size;
+        }
+        adpcm_free_context(adpcm_context);
+    }
+
     // From the MEK - I have no clue how to do this
-    std::vector<std::byte> encode_to_xbox_adpcm(const std::vector<std::byte> &pcm, std::size_t bits_per_sample, std::size_t channel_count) {
+    std::vector<std::byte> encode_to_xbox_adpcm(const std::vector<std::byte> &pcm, std::size_t bits_per_sample, std::size_t channel_count, std::size_t segment_count, const std::vector<std::byte> &preceding_pcm) {
         // Set some parameters
         std::unique_ptr<std::vector<std::byte>> pcm_16_bit_data_ptr;
         const std::int16_t *pcm_stream;
         std::size_t bytes_per_sample = bits_per_sample / 8;
         std::size_t sample_count = pcm.size() / bytes_per_sample / channel_count;
-        if(bits_per_sample != 16) {
+        std::size_t pcm_block_size   = calculate_adpcm_pcm_block_size(channel_count);
+        std::size_t adpcm_block_size = calculate_adpcm_block_size(channel_count);
+
+        // If we're continuing from earlier PCM, use its last few blocks to warm up the encoder
+        std::size_t preceding_block_count = std::min(preceding_pcm.size() / bytes_per_sample / pcm_block_size, XBOX_ADPCM_WARM_UP_BLOCK_COUNT);
+        if(preceding_block_count > 0) {
+            std::vector<std::byte> joined_pcm(preceding_pcm.end() - preceding_block_count * pcm_block_size * bytes_per_sample, preceding_pcm.end());
+            joined_pcm.insert(joined_pcm.end(), pcm.begin(), pcm.end());
+            pcm_16_bit_data_ptr = std::make_unique<std::vector<std::byte>>(bits_per_sample != 16 ? convert_int_to_int(joined_pcm, bits_per_sample, 16) : std::move(joined_pcm));
+            bytes_per_sample = 2;
+            bits_per_sample = 16;
+            pcm_stream = reinterpret_cast<const std::int16_t *>(pcm_16_bit_data_ptr->data()) + preceding_block_count * pcm_block_size;
+        }
+        else if(bits_per_sample != 16) {
             pcm_16_bit_data_ptr = std::make_unique<std::vector<std::byte>>(convert_int_to_int(pcm, bits_per_sample, 16));
             bytes_per_sample = 2;
             bits_per_sample = 16;
@@ -38,40 +97,42 @@ namespace Invader::SoundEncoder {
             pcm_stream = reinterpret_cast<const std::int16_t *>(pcm.data());
         }
 
+        std::size_t block_count = sample_count / calculate_samples_per_block();
+
+        // Nothing to encode if we don't have a full block
+        if(block_count == 0) {
+            return std::vector<std::byte>();
+        }
+
         // Set our output
-        std::vector<std::byte> adpcm_stream_buffer(sample_count * bytes_per_sample);
+        std::vector<std::byte> adpcm_stream_buffer(block_count * adpcm_block_size);
         std::uint8_t *adpcm_stream = reinterpret_cast<std::uint8_t *>(adpcm_stream_buffer.data());
 
-        std::size_t samples_per_block = code_chunks_count * 8;
-        std::size_t block_count = sample_count / samples_per_block;
-        std::size_t num_bytes_decoded = 0;
-
-        std::size_t pcm_block_size   = calculate_adpcm_pcm_block_size(channel_count);  // number of pcm sint16 per block
-        std::size_t adpcm_block_size = (code_chunks_count * 4 + 4) * channel_count;  // number of adpcm bytes per block
+        // Don't make segments smaller than the warm-up
+        std::size_t max_segment_count = block_count / XBOX_ADPCM_WARM_UP_BLOCK_COUNT;
+        if(segment_count > max_segment_count) {
+            segment_count = max_segment_count;
+        }
 
-        std::int32_t average_deltas[2];
-        void *adpcm_context = NULL;
+        if(segment_count <= 1) {
+            encode_xbox_adpcm_blocks(pcm_stream, adpcm_stream, block_count, preceding_block_count, channel_count);
+        }
+        else {
+            std::size_t blocks_per_segment = (block_count + segment_count - 1) / segment_count;
+            std::vector<std::thread> threads;
+            threads.reserve(segment_count);
 
-        // calculate initial adpcm predictors using decaying average
-        for (std::size_t c = 0; c < channel_count; c++) {
-            average_deltas[c] = 0;
-            for (std::size_t i = c + pcm_block_size - channel_count; i >= channel_count; i -= channel_count) {
-                average_deltas[c] = (average_deltas[c] / 8) + std::abs(static_cast<std::int32_t>(pcm_stream[i]) - pcm_stream[i - channel_count]);
+            for(std::size_t first_block = 0; first_block < block_count; first_block += blocks_per_segment) {
+                std::size_t segment_block_count = std::min(blocks_per_segment, block_count - first_block);
+                std::size_t warm_up_block_count = std::min(first_block + preceding_block_count, XBOX_ADPCM_WARM_UP_BLOCK_COUNT);
+                threads.emplace_back(encode_xbox_adpcm_blocks, pcm_stream + first_block * pcm_block_size, adpcm_stream + first_block * adpcm_block_size, segment_block_count, warm_up_block_count, channel_count);
             }
-            average_deltas[c] /= 8;
-        }
 
-        // Encode!
-        adpcm_context = adpcm_create_context(channel_count, 3, 0, average_deltas);
-        for (std::size_t b = 0; b < block_count; b++) {
-            adpcm_encode_block(adpcm_context, adpcm_stream, &num_bytes_decoded, pcm_stream, samples_per_block);
-            adpcm_stream += adpcm_block_size;
-            pcm_stream += pcm_block_size;
+            for(auto &t : threads) {
+                t.join();
+            }
         }
-        adpcm_free_context(adpcm_context);
 
-        // Resize to fit the buffer
-        adpcm_stream_buffer.resize(reinterpret_cast<std::byte *>(adpcm_stream) - adpcm_stream_buffer.data());
         return adpcm_stream_buffer;
     }
 }
@@ -26,6 +26,7 @@ def make_cache_format_data(struct_name, s, pre_compile, post_compile, all_used_s
     cpp_cache_format_data.write("        workload.structs[struct_index].unsafe_to_dedupe = {};\n".format("true" if ("unsafe_to_dedupe" in s and s["unsafe_to_dedupe"]) else "false"))
     if pre_compile:
         cpp_cache_format_data.write("        if(!this->cache_formatted) {\n")
+        cpp_cache_format_data.write("            BuildProfile::Scope pre_compile_scope(workload.get_build_parameters()->profile, \"pre-compile\", \"{}\");\n".format(struct_name))
         cpp_cache_format_data.write("            this->pre_compile(workload, tag_index, struct_index, offset);\n")
         cpp_cache_format_data.write("        }\n")
         cpp_cache_format_data.write("        this->cache_formatted = true;\n")
@@ -259,7 +260,10 @@ def make_cache_format_data(struct_name, s, pre_compile, post_compile, all_used_s
                 cpp_cache_format_data.write("        }\n")
             cpp_cache_format_data.write("        r.{} = this->{};\n".format(name, name))
     if post_compile:
-        cpp_cache_format_data.write("        this->post_compile(workload, tag_index, struct_index, offset);\n".format(name, name))
+        cpp_cache_format_data.write("        {\n")
+        cpp_cache_format_data.write("            BuildProfile::Scope post_compile_scope(workload.get_build_parameters()->profile, \"post-compile\", \"{}\");\n".format(struct_name))
+        cpp_cache_format_data.write("            this->post_compile(workload, tag_index, struct_index, offset);\n")
+        cpp_cache_format_data.write("        }\n")
 
     ## Remove our struct from the top of the stack
     cpp_cache_format_data.write("        stack->erase(stack->begin());\n")
@@ -0,0 +1,109 @@
+# SPDX-License-Identifier: GPL-3.0-only
+
+def make_scan_hek_dependencies(all_used_structs, struct_name, hpp, cpp_scan_dependencies):
+    hpp.write("\n        /**\n")
+    hpp.write("         * Find all dependencies in the HEK tag file without parsing it. Only dependency paths are read; everything else is skipped.\n")
+    hpp.write("         * @param data      Tag file data to read from\n")
+    hpp.write("         * @param data_size Size of the tag file\n")
+    hpp.write("         * @param callback  Called for each dependency that has a path\n")
+    hpp.write("         */\n")
+    hpp.write("        static void scan_hek_dependencies(const std::byte *data, std::size_t data_size, const DependencyCallback &callback);\n")
+    hpp.write("\n        /**\n")
+    hpp.write("         * Find all dependencies in the HEK tag data without parsing it.\n")
+    hpp.write("         * @param data      Data to read from for structs, tag references, and reflexives; if data_this is nullptr, this must point to the struct\n")
+    hpp.write("         * @param data_size Size of the buffer\n")
+    hpp.write("         * @param data_read This will be set to the amount of data read. If data_this is null, then the initial struct will also be added\n")
+    hpp.write("         * @param callback  Called for each dependency that has a path; if this is null, the data is only checked and skipped\n")
+    hpp.write("         * @param data_this Pointer to the struct; if this is null, then data will be used instead\n")
+    hpp.write("         */\n")
+    hpp.write("        static void scan_hek_dependencies_data(const std::byte *data, std::size_t data_size, std::size_t &data_read, const DependencyCallback *callback, const std::byte *data_this = nullptr);\n")
+
+    cpp_scan_dependencies.write("    void {}::scan_hek_dependencies(const std::byte *data, std::size_t data_size, const DependencyCallback &callback) {{\n".format(struct_name))
+    cpp_scan_dependencies.write("        HEK::TagFileHeader::validate_header(reinterpret_cast<const HEK::TagFileHeader *>(data), data_size);\n")
+    cpp_scan_dependencies.write("        std::size_t data_read = 0;\n")
+    cpp_scan_dependencies.write("        std::size_t expected_data_read = data_size - sizeof(HEK::TagFileHeader);\n")
+    cpp_scan_dependencies.write("        scan_hek_dependencies_data(data + sizeof(HEK::TagFileHeader), expected_data_read, data_read, &callback);\n")
+    cpp_scan_dependencies.write("        if(data_read != expected_data_read) {\n")
+    cpp_scan_dependencies.write("            eprintf_error(\"invalid tag file; tag data was left over\");\n")
+    cpp_scan_dependencies.write("            throw InvalidTagDataException();\n")
+    cpp_scan_dependencies.write("        }\n")
+    cpp_scan_dependencies.write("    }\n")
+
+    cpp_scan_dependencies.write("    void {}::scan_hek_dependencies_data(const std::byte *data, std::size_t data_size, std::size_t &data_read, [[maybe_unused]] const DependencyCallback *callback, const std::byte *data_this) {{\n".format(struct_name))
+    cpp_scan_dependencies.write("        data_read = 0;\n")
+    cpp_scan_dependencies.write("        if(data_this == nullptr) {\n")
+    cpp_scan_dependencies.write("            if(sizeof(struct_big) > data_size) {\n")
+    cpp_scan_dependencies.write("                eprintf_error(\"Failed to read {} base struct: %zu bytes needed > %zu bytes available\", sizeof(struct_big), data_size);\n".format(struct_name))
+    cpp_scan_dependencies.write("                throw OutOfBoundsException();\n")
+    cpp_scan_dependencies.write("            }\n")
+    cpp_scan_dependencies.write("            data_this = data;\n")
+    cpp_scan_dependencies.write("            data_size -= sizeof(struct_big);\n")
+    cpp_scan_dependencies.write("            data_read += sizeof(struct_big);\n")
+    cpp_scan_dependencies.write("            data += sizeof(struct_big);\n")
+    cpp_scan_dependencies.write("        }\n")
+
+    # Only dependencies, reflexives, and data blocks have anything after the struct, so nothing else needs to be looked at
+    scanned_structs = [s for s in all_used_structs if s["type"] == "TagDependency" or s["type"] == "TagReflexive" or s["type"] == "TagDataOffset"]
+    if len(scanned_structs) > 0:
+        cpp_scan_dependencies.write("        const auto &h = *reinterpret_cast<const HEK::{}<HEK::BigEndian> *>(data_this);\n".format(struct_name))
+
+    for struct in scanned_structs:
+        name = struct["member_name"]
+
+        # Anything not read by parse_hek_tag_data is not reported here, either
+        unread = ("cache_only" in struct and struct["cache_only"]) or ("unused" in struct and struct["unused"])
+
+        if struct["type"] == "TagDependency":
+            cpp_scan_dependencies.write("        std::size_t h_{}_expected_length = h.{}.path_size;\n".format(name, name))
+            cpp_scan_dependencies.write("        if(h_{}_expected_length > 0) {{\n".format(name))
+            cpp_scan_dependencies.write("            if(h_{}_expected_length + 1 > data_size) {{\n".format(name))
+            cpp_scan_dependencies.write("                eprintf_error(\"Failed to read dependency {}::{}: %zu bytes needed > %zu bytes available\", h_{}_expected_length, data_size);\n".format(struct_name, name, name))
+            cpp_scan_dependencies.write("                throw OutOfBoundsException();\n")
+            cpp_scan_dependencies.write("            }\n")
+            cpp_scan_dependencies.write("            const char *h_{}_char = reinterpret_cast<const char *>(data);\n".format(name))
+            cpp_scan_dependencies.write("            if(std::memchr(h_{}_char, 0, h_{}_expected_length) != nullptr) {{\n".format(name, name))
+            cpp_scan_dependencies.write("                eprintf_error(\"Failed to read dependency {}::{}: size is smaller than expected (%zu expected > %zu actual)\", h_{}_expected_length, std::strlen(h_{}_char));\n".format(struct_name, name, name, name))
+            cpp_scan_dependencies.write("                throw InvalidTagDataException();\n")
+            cpp_scan_dependencies.write("            }\n")
+            cpp_scan_dependencies.write("            if(h_{}_char[h_{}_expected_length] != 0) {{\n".format(name, name))
+            cpp_scan_dependencies.write("                eprintf_error(\"Failed to read dependency {}::{}: missing null terminator\");\n".format(struct_name, name))
+            cpp_scan_dependencies.write("                throw InvalidTagDataException();\n")
+            cpp_scan_dependencies.write("            }\n")
+            if not unread:
+                cpp_scan_dependencies.write("            if(callback) {\n")
+                cpp_scan_dependencies.write("                (*callback)(h_{}_char, h.{}.tag_fourcc);\n".format(name, name))
+                cpp_scan_dependencies.write("            }\n")
+            cpp_scan_dependencies.write("            data_size -= h_{}_expected_length + 1;\n".format(name))
+            cpp_scan_dependencies.write("            data_read += h_{}_expected_length + 1;\n".format(name))
+            cpp_scan_dependencies.write("            data += h_{}_expected_length + 1;\n".format(name))
+            cpp_scan_dependencies.write("        }\n")
+        elif struct["type"] == "TagReflexive":
+            cpp_scan_dependencies.write("        std::size_t h_{}_count = h.{}.count;\n".format(name, name))
+            cpp_scan_dependencies.write("        if(h_{}_count > 0) {{\n".format(name))
+            cpp_scan_dependencies.write("            const auto *array = reinterpret_cast<const HEK::{}<HEK::BigEndian> *>(data);\n".format(struct["struct"]))
+            cpp_scan_dependencies.write("            std::size_t total_size = sizeof(*array) * h_{}_count;\n".format(name))
+            cpp_scan_dependencies.write("            if(total_size > data_size) {\n")
+            cpp_scan_dependencies.write("                eprintf_error(\"Failed to read reflexive {}::{}: %zu bytes needed > %zu bytes available\", total_size, data_size);\n".format(struct_name, name))
+            cpp_scan_dependencies.write("                throw OutOfBoundsException();\n")
+            cpp_scan_dependencies.write("            }\n")
+            cpp_scan_dependencies.write("            data_size -= total_size;\n")
+            cpp_scan_dependencies.write("            data_read += total_size;\n")
+            cpp_scan_dependencies.write("            data += total_size;\n")
+            cpp_scan_dependencies.write("            for(std::size_t ref = 0; ref < h_{}_count; ref++) {{\n".format(name))
+            cpp_scan_dependencies.write("                std::size_t ref_data_read = 0;\n")
+            cpp_scan_dependencies.write("                {}::scan_hek_dependencies_data(data, data_size, ref_data_read, {}, reinterpret_cast<const std::byte *>(array + ref));\n".format(struct["struct"], "nullptr" if unread else "callback"))
+            cpp_scan_dependencies.write("                data += ref_data_read;\n")
+            cpp_scan_dependencies.write("                data_read += ref_data_read;\n")
+            cpp_scan_dependencies.write("                data_size -= ref_data_read;\n")
+            cpp_scan_dependencies.write("            }\n")
+            cpp_scan_dependencies.write("        }\n")
+        elif struct["type"] == "TagDataOffset":
+            cpp_scan_dependencies.write("        std::size_t h_{}_size = h.{}.size;\n".format(name, name))
+            cpp_scan_dependencies.write("        if(h_{}_size > data_size) {{\n".format(name))
+            cpp_scan_dependencies.write("            eprintf_error(\"Failed to read tag data block {}::{}: %zu bytes needed > %zu bytes available\", h_{}_size, data_size);\n".format(struct_name, name, name))
+            cpp_scan_dependencies.write("            throw OutOfBoundsException();\n")
+            cpp_scan_dependencies.write("        }\n")
+            cpp_scan_dependencies.write("        data_size -= h_{}_size;\n".format(name))
+            cpp_scan_dependencies.write("        data_read += h_{}_size;\n".format(name))
+            cpp_scan_dependencies.write("        data += h_{}_size;\n".format(name))
+    cpp_scan_dependencies.write("    }\n")
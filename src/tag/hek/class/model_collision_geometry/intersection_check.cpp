@@ -11,9 +11,9 @@ namespace Invader::HEK {
         return point.distance_from_plane(planes[plane_index].plane) >= 0;
     }
 
-    FlaggedInt<std::uint32_t> leaf_for_point_of_bsp_tree(const Point3D<LittleEndian> &point, const ModelCollisionGeometryBSP3DNode<LittleEndian> *bsp3d_nodes, std::uint32_t bsp3d_node_count, const ModelCollisionGeometryBSPPlane<LittleEndian> *planes, std::uint32_t plane_count) {
-        // Start with an initial index of 0
-        FlaggedInt<std::uint32_t> node_index = {0};
+    FlaggedInt<std::uint32_t> leaf_for_point_of_bsp_tree(const Point3D<LittleEndian> &point, const ModelCollisionGeometryBSP3DNode<LittleEndian> *bsp3d_nodes, std::uint32_t bsp3d_node_count, const ModelCollisionGeometryBSPPlane<LittleEndian> *planes, std::uint32_t plane_count, FlaggedInt<std::uint32_t> start_node) {
+        // Start with the given node (usually 0)
+        FlaggedInt<std::uint32_t> node_index = start_node;
 
         // Loop until we have a leaf or nothing
         while(!node_index.flag_value() && !node_index.is_null()) {
@@ -32,30 +32,23 @@ namespace Invader::HEK {
     }
 
     bool IntersectionCheck::check_for_intersection(
+        const BSPData &bsp,
+        std::vector<BSPIntersectionStackFrame> &stack,
         const Point3D<LittleEndian> &point_a,
         const Point3D<LittleEndian> &point_b,
-        const ModelCollisionGeometryBSP3DNode<LittleEndian> *bsp3d_nodes,
-        std::uint32_t bsp3d_node_count,
-        const ModelCollisionGeometryBSPPlane<LittleEndian> *planes,
-        std::uint32_t plane_count,
-        const ModelCollisionGeometryBSPLeaf<LittleEndian> *leaves,
-        std::uint32_t leaf_count,
-        const ModelCollisionGeometryBSP2DNode<LittleEndian> *bsp2d_nodes,
-        std::uint32_t bsp2d_node_count,
-        const ModelCollisionGeometryBSP2DReference<LittleEndian> *bsp2d_references,
-        std::uint32_t bsp2d_reference_count,
-        const ModelCollisionGeometryBSPSurface<LittleEndian> *surfaces,
-        std::uint32_t surface_count,
-        const ModelCollisionGeometryBSPEdge<LittleEndian> *edges,
-        std::uint32_t edge_count,
-        const ModelCollisionGeometryBSPVertex<LittleEndian> *vertices,
-        std::uint32_t vertex_count,
         Point3D<LittleEndian> &intersection_point,
         std::uint32_t &surface_index,
         std::uint32_t &leaf_index
     ) {
-        IntersectionCheck check(point_a, point_b, bsp3d_nodes, bsp3d_node_count, planes, plane_count, leaves, leaf_count, bsp2d_nodes, bsp2d_node_count, bsp2d_references, bsp2d_reference_count, surfaces, surface_count, edges, edge_count, vertices, vertex_count);
-        return check.check_for_intersection_recursion(point_a, point_b, surface_index, leaf_index, intersection_point, {0});
+        IntersectionCheck check(point_a, point_b, bsp);
+        BSPIntersectionStackFrame::Result result;
+        if(!check.check_for_intersection_tree(stack, result)) {
+            return false;
+        }
+        intersection_point = result.intersection_point;
+        surface_index = result.surface_index;
+        leaf_index = result.leaf_index;
+        return true;
     }
 
     bool IntersectionCheck::check_for_intersection_bsp2d_node (
@@ -70,12 +63,12 @@ namespace Invader::HEK {
 
         // Until it's a surface, search
         while(!node_index.flag_value() && !node_index.is_null()) {
-            if(node_index.int_value() >= this->bsp2d_node_count) {
-                eprintf_error("Invalid BSP2D node %u / %u in BSP.\n", node_index.int_value(), this->bsp2d_node_count);
+            if(node_index.int_value() >= this->bsp.bsp2d_node_count) {
+                eprintf_error("Invalid BSP2D node %u / %u in BSP.\n", node_index.int_value(), this->bsp.bsp2d_node_count);
                 throw OutOfBoundsException();
             }
 
-            auto &bsp2d_node = this->bsp2d_nodes[node_index.int_value()];
+            auto &bsp2d_node = this->bsp.bsp2d_nodes[node_index.int_value()];
             if(point.distance_from_plane(bsp2d_node.plane) > 0.0F) {
                 node_index = bsp2d_node.right_child.read();
             }
@@ -89,8 +82,8 @@ namespace Invader::HEK {
             return false;
         }
 
-        if(node_index.int_value() >= this->surface_count) {
-            eprintf_error("Invalid surface %u / %u in BSP.\n", node_index.int_value(), this->surface_count);
+        if(node_index.int_value() >= this->bsp.surface_count) {
+            eprintf_error("Invalid surface %u / %u in BSP.\n", node_index.int_value(), this->bsp.surface_count);
             throw OutOfBoundsException();
         }
 
@@ -99,80 +92,103 @@ namespace Invader::HEK {
         return true;
     }
 
-    bool IntersectionCheck::check_for_intersection_recursion (
-        const Point3D<LittleEndian> &point_a,
-        const Point3D<LittleEndian> &point_b,
-        std::uint32_t &surface_index,
-        std::uint32_t &leaf_index,
-        Point3D<LittleEndian> &intersection_point,
-        FlaggedInt<std::uint32_t> node_index)
+    bool IntersectionCheck::check_for_intersection_tree (
+        std::vector<BSPIntersectionStackFrame> &stack,
+        BSPIntersectionStackFrame::Result &result)
     {
-        // Check if they're equal. If so, there's no intersection
-        if(point_a == point_b) {
-            return false;
-        }
+        // This walks the tree like a recursive descent would, but keeps the pending halves of each split on our own stack
+        stack.clear();
 
-        while(!node_index.flag_value() && !node_index.is_null()) {
-            // Make sure it's a valid index
-            if(node_index >= bsp3d_node_count) {
-                eprintf_error("Invalid BSP3D node %u / %u in BSP.\n", node_index.int_value(), this->bsp3d_node_count);
-                throw OutOfBoundsException();
-            }
+        Point3D<LittleEndian> point_a = this->original_point_a;
+        Point3D<LittleEndian> point_b = this->original_point_b;
+        FlaggedInt<std::uint32_t> node_index = {0};
 
-            // Get the node as well as front/back child info for each point
-            auto &node = bsp3d_nodes[node_index];
-            bool a_in_front_of_plane = point_in_front_of_plane(point_a, this->planes, plane_count, node.plane);
-            bool b_in_front_of_plane = point_in_front_of_plane(point_b, this->planes, plane_count, node.plane);
+        while(true) {
+            bool intersected = false;
+            bool split = false;
 
-            FlaggedInt<std::uint32_t> node_index_a = a_in_front_of_plane ? node.front_child : node.back_child;
-            FlaggedInt<std::uint32_t> node_index_b = b_in_front_of_plane ? node.front_child : node.back_child;
+            // Check if they're equal. If so, there's no intersection
+            if(!(point_a == point_b)) {
+                bool fell_out = false;
 
-            // If they're the same, set node_index to one of them and keep going
-            if(node_index_a == node_index_b) {
-                node_index = node_index_a;
+                while(!node_index.flag_value() && !node_index.is_null()) {
+                    // Make sure it's a valid index
+                    if(node_index >= this->bsp.bsp3d_node_count) {
+                        eprintf_error("Invalid BSP3D node %u / %u in BSP.\n", node_index.int_value(), this->bsp.bsp3d_node_count);
+                        throw OutOfBoundsException();
+                    }
+
+                    // Get the node as well as front/back child info for each point
+                    auto &node = this->bsp.bsp3d_nodes[node_index];
+                    bool a_in_front_of_plane = point_in_front_of_plane(point_a, this->bsp.planes, this->bsp.plane_count, node.plane);
+                    bool b_in_front_of_plane = point_in_front_of_plane(point_b, this->bsp.planes, this->bsp.plane_count, node.plane);
+
+                    FlaggedInt<std::uint32_t> node_index_a = a_in_front_of_plane ? node.front_child : node.back_child;
+                    FlaggedInt<std::uint32_t> node_index_b = b_in_front_of_plane ? node.front_child : node.back_child;
+
+                    // If they're the same, set node_index to one of them and keep going
+                    if(node_index_a == node_index_b) {
+                        node_index = node_index_a;
+                        continue;
+                    }
+
+                    // Calculate a point that's almost on the plane
+                    auto &plane = this->bsp.planes[node.plane.read()].plane;
+                    Point3D<LittleEndian> intersection_front;
+                    if(!intersect_plane_with_points(plane, point_a, point_b, &intersection_front)) {
+                        fell_out = true;
+                        break;
+                    }
+
+                    // Check point_a to the plane first, then come back for the plane to point_b
+                    auto &frame = stack.emplace_back();
+                    frame.point_a = point_a;
+                    frame.point_b = point_b;
+                    frame.split_point = intersection_front;
+                    frame.node_index_b = node_index_b;
+                    frame.first_half_done = false;
+
+                    point_b = intersection_front;
+                    node_index = node_index_a;
+                    split = true;
+                    break;
+                }
+
+                if(split) {
+                    continue;
+                }
+
+                // If we didn't fall out of the BSP, check the leaf
+                if(!fell_out && !node_index.is_null()) {
+                    intersected = check_for_intersection_leaf(point_a, node_index.int_value(), result);
+                }
             }
-            else {
-                // Calculate a point that's almost on the plane
-                auto &plane = planes[node.plane.read()].plane;
-                Point3D<LittleEndian> intersection_front;
-                bool p = intersect_plane_with_points(plane, point_a, point_b, &intersection_front);
-                if(!p) {
-                    return false;
+
+            // Go back up until we have a half we haven't checked yet
+            while(true) {
+                if(stack.empty()) {
+                    return intersected;
                 }
 
-                Point3D<LittleEndian> point_a_intersection;
-                Point3D<LittleEndian> point_b_intersection;
-
-                std::uint32_t leaf_a_intersection, leaf_b_intersection, surface_a_intersection, surface_b_intersection;
-
-                // Can we get anything closer?
-                bool point_a_intersected = check_for_intersection_recursion(
-                    point_a,
-                    intersection_front,
-                    surface_a_intersection,
-                    leaf_a_intersection,
-                    point_a_intersection,
-                    node_index_a
-                );
-
-                bool point_b_intersected = check_for_intersection_recursion(
-                    intersection_front,
-                    point_b,
-                    surface_b_intersection,
-                    leaf_b_intersection,
-                    point_b_intersection,
-                    node_index_b
-                );
-
-                // If neither intersected, we don't have an intersection.
-                if(!point_a_intersected && !point_b_intersected) {
-                    return false;
+                auto &frame = stack.back();
+                if(!frame.first_half_done) {
+                    frame.first_half_done = true;
+                    frame.first_half_intersected = intersected;
+                    frame.first_half_result = result;
+
+                    point_a = frame.split_point;
+                    point_b = frame.point_b;
+                    node_index = frame.node_index_b;
+                    break;
                 }
 
+                bool point_a_intersected = frame.first_half_intersected;
+                bool point_b_intersected = intersected;
+
                 // If both intersected, invalidate the furthest one
                 if(point_a_intersected && point_b_intersected) {
-                    float a_distance_squared = point_a_intersection.distance_from_point_squared(point_a);
-                    float b_distance_squared = point_b_intersection.distance_from_point_squared(point_a);
+                    float a_distance_squared = frame.first_half_result.intersection_point.distance_from_point_squared(frame.point_a);
+                    float b_distance_squared = result.intersection_point.distance_from_point_squared(frame.point_a);
 
                     if(a_distance_squared > b_distance_squared) {
                         point_a_intersected = false;
@@ -182,36 +198,30 @@ namespace Invader::HEK {
                     }
                 }
 
-                // Now that we have one, return it
+                // Now that we have one (if any), return it
                 if(point_a_intersected) {
-                    intersection_point = point_a_intersection;
-                    leaf_index = leaf_a_intersection;
-                    surface_index = surface_a_intersection;
-                }
-                else {
-                    intersection_point = point_b_intersection;
-                    leaf_index = leaf_b_intersection;
-                    surface_index = surface_b_intersection;
+                    result = frame.first_half_result;
                 }
+                intersected = point_a_intersected || point_b_intersected;
 
-                return true;
+                stack.pop_back();
             }
-        };
-
-        // Fell out of the BSP; null
-        if(node_index.is_null()) {
-            return false;
         }
+    }
 
+    bool IntersectionCheck::check_for_intersection_leaf (
+        const Point3D<LittleEndian> &point_a,
+        std::uint32_t leaf_index,
+        BSPIntersectionStackFrame::Result &result)
+    {
         // Make sure the leaf is valid
-        std::uint32_t leaf_index_t = node_index.int_value();
-        if(leaf_index_t >= leaf_count) {
-            eprintf_error("invalid leaf index #%u / %u\n", leaf_index_t, leaf_count);
+        if(leaf_index >= this->bsp.leaf_count) {
+            eprintf_error("invalid leaf index #%u / %u\n", leaf_index, this->bsp.leaf_count);
             throw OutOfBoundsException();
         }
 
         // Get the leaf
-        auto &leaf = this->leaves[leaf_index_t];
+        auto &leaf = this->bsp.leaves[leaf_index];
 
         // Check if we have nil BSP2D references
         std::uint32_t leaf_bsp2d_reference_count = leaf.bsp2d_reference_count.read();
@@ -222,8 +232,8 @@ namespace Invader::HEK {
 
         // Make sure the BSP2D references are valid
         std::uint64_t bsp2d_end = static_cast<std::uint64_t>(leaf_bsp2d_reference_index + leaf_bsp2d_reference_count);
-        if(bsp2d_end > this->bsp2d_reference_count) {
-            eprintf_error("invalid bsp2d reference range #%u - %zu / %u\n", leaf_bsp2d_reference_count, static_cast<std::size_t>(leaf_bsp2d_reference_index + leaf_bsp2d_reference_count), this->bsp2d_reference_count);
+        if(bsp2d_end > this->bsp.bsp2d_reference_count) {
+            eprintf_error("invalid bsp2d reference range #%u - %zu / %u\n", leaf_bsp2d_reference_count, static_cast<std::size_t>(leaf_bsp2d_reference_index + leaf_bsp2d_reference_count), this->bsp.bsp2d_reference_count);
             throw OutOfBoundsException();
         }
 
@@ -231,19 +241,19 @@ namespace Invader::HEK {
         bool ever_intersected = false;
         float closest_intersection_distance = 0.0F;
         for(std::uint32_t b = leaf_bsp2d_reference_index; b < bsp2d_end; b++) {
-            auto &reference = this->bsp2d_references[b];
+            auto &reference = this->bsp.bsp2d_references[b];
             auto node_index = reference.bsp2d_node.read();
 
             // Make sure the plane is valid
             auto plane = reference.plane.read();
-            if(plane >= this->plane_count) {
-                eprintf_error("invalid plane range for BSP #%u / %u\n", plane.int_value(), this->plane_count);
+            if(plane >= this->bsp.plane_count) {
+                eprintf_error("invalid plane range for BSP #%u / %u\n", plane.int_value(), this->bsp.plane_count);
                 throw OutOfBoundsException();
             }
 
             // Make sure point a is in front and point b is behind
             Point3D<LittleEndian> intersection;
-            if(!intersect_plane_with_points(this->planes[plane].plane, this->original_point_a, this->original_point_b, &intersection)) {
+            if(!intersect_plane_with_points(this->bsp.planes[plane].plane, this->original_point_a, this->original_point_b, &intersection)) {
                 continue;
             }
 
@@ -254,7 +264,7 @@ namespace Invader::HEK {
             }
 
             // Okay, now let's see if we can get this going
-            auto plane_ref = this->planes[plane].plane;
+            auto plane_ref = this->bsp.planes[plane].plane;
             float x = std::fabs(plane_ref.vector.i);
             float y = std::fabs(plane_ref.vector.j);
             float z = std::fabs(plane_ref.vector.k);
@@ -301,10 +311,10 @@ namespace Invader::HEK {
             point.x = (&intersection.x)[PLANE_INDICES[sign][axis][0]];
             point.y = (&intersection.x)[PLANE_INDICES[sign][axis][1]];
 
-            if(check_for_intersection_bsp2d_node(node_index, point, surface_index)) {
+            if(check_for_intersection_bsp2d_node(node_index, point, result.surface_index)) {
                 ever_intersected = true;
-                intersection_point = intersection;
-                leaf_index = leaf_index_t;
+                result.intersection_point = intersection;
+                result.leaf_index = leaf_index;
                 closest_intersection_distance = intersection_distance;
             }
         }
@@ -315,39 +325,9 @@ namespace Invader::HEK {
     IntersectionCheck::IntersectionCheck(
         const Point3D<LittleEndian> &original_point_a,
         const Point3D<LittleEndian> &original_point_b,
-        const ModelCollisionGeometryBSP3DNode<LittleEndian> *bsp3d_nodes,
-        std::uint32_t bsp3d_node_count,
-        const ModelCollisionGeometryBSPPlane<LittleEndian> *planes,
-        std::uint32_t plane_count,
-        const ModelCollisionGeometryBSPLeaf<LittleEndian> *leaves,
-        std::uint32_t leaf_count,
-        const ModelCollisionGeometryBSP2DNode<LittleEndian> *bsp2d_nodes,
-        std::uint32_t bsp2d_node_count,
-        const ModelCollisionGeometryBSP2DReference<LittleEndian> *bsp2d_references,
-        std::uint32_t bsp2d_reference_count,
-        const ModelCollisionGeometryBSPSurface<LittleEndian> *surfaces,
-        std::uint32_t surface_count,
-        const ModelCollisionGeometryBSPEdge<LittleEndian> *edges,
-        std::uint32_t edge_count,
-        const ModelCollisionGeometryBSPVertex<LittleEndian> *vertices,
-        std::uint32_t vertex_count
+        const BSPData &bsp
     ) :
     original_point_a(original_point_a),
     original_point_b(original_point_b),
-    bsp3d_nodes(bsp3d_nodes),
-    bsp3d_node_count(bsp3d_node_count),
-    planes(planes),
-    plane_count(plane_count),
-    leaves(leaves),
-    leaf_count(leaf_count),
-    bsp2d_nodes(bsp2d_nodes),
-    bsp2d_node_count(bsp2d_node_count),
-    bsp2d_references(bsp2d_references),
-    bsp2d_reference_count(bsp2d_reference_count),
-    surfaces(surfaces),
-    surface_count(surface_count),
-    edges(edges),
-    edge_count(edge_count),
-    vertices(vertices),
-    vertex_count(vertex_count) {}
+    bsp(bsp) {}
 }
@@ -3,30 +3,28 @@
 #ifndef INVADER__TAG__HEK__CLASS__MODEL_COLLISION_GEOMETRY__INTERSECTION_CHECK_HPP
 #define INVADER__TAG__HEK__CLASS__MODEL_COLLISION_GEOMETRY__INTERSECTION_CHECK_HPP
 
+#include <vector>
 #include <invader/tag/hek/class/model_collision_geometry.hpp>
 
 namespace Invader::HEK {
     class IntersectionCheck {
     public:
+        /**
+         * Check for an intersection between point_a and point_b
+         * @param bsp                BSP to check
+         * @param stack              stack to use for traversing the BSP (this is reused so we don't need to allocate every time)
+         * @param point_a            start of the line
+         * @param point_b            end of the line
+         * @param intersection_point set to the closest intersection to point_a if found
+         * @param surface_index      set to the surface index of the intersection if found
+         * @param leaf_index         set to the leaf index of the intersection if found
+         * @return                   true if found
+         */
         static bool check_for_intersection(
+            const BSPData &bsp,
+            std::vector<BSPIntersectionStackFrame> &stack,
             const Point3D<LittleEndian> &point_a,
             const Point3D<LittleEndian> &point_b,
-            const ModelCollisionGeometryBSP3DNode<LittleEndian> *bsp3d_nodes,
-            std::uint32_t bsp3d_node_count,
-            const ModelCollisionGeometryBSPPlane<LittleEndian> *planes,
-            std::uint32_t plane_count,
-            const ModelCollisionGeometryBSPLeaf<LittleEndian> *leaves,
-            std::uint32_t leaf_count,
-            const ModelCollisionGeometryBSP2DNode<LittleEndian> *bsp2d_nodes,
-            std::uint32_t bsp2d_node_count,
-            const ModelCollisionGeometryBSP2DReference<LittleEndian> *bsp2d_references,
-            std::uint32_t bsp2d_reference_count,
-            const ModelCollisionGeometryBSPSurface<LittleEndian> *surfaces,
-            std::uint32_t surface_count,
-            const ModelCollisionGeometryBSPEdge<LittleEndian> *edges,
-            std::uint32_t edge_count,
-            const ModelCollisionGeometryBSPVertex<LittleEndian> *vertices,
-            std::uint32_t vertex_count,
             Point3D<LittleEndian> &intersection_point,
             std::uint32_t &surface_index,
             std::uint32_t &leaf_index
@@ -35,22 +33,7 @@ namespace Invader::HEK {
     private:
         const Point3D<LittleEndian> &original_point_a;
         const Point3D<LittleEndian> &original_point_b;
-        const ModelCollisionGeometryBSP3DNode<LittleEndian> *bsp3d_nodes;
-        std::uint32_t bsp3d_node_count;
-        const ModelCollisionGeometryBSPPlane<LittleEndian> *planes;
-        std::uint32_t plane_count;
-        const ModelCollisionGeometryBSPLeaf<LittleEndian> *leaves;
-        std::uint32_t leaf_count;
-        const ModelCollisionGeometryBSP2DNode<LittleEndian> *bsp2d_nodes;
-        std::uint32_t bsp2d_node_count;
-        const ModelCollisionGeometryBSP2DReference<LittleEndian> *bsp2d_references;
-        std::uint32_t bsp2d_reference_count;
-        const ModelCollisionGeometryBSPSurface<LittleEndian> *surfaces;
-        std::uint32_t surface_count;
-        const ModelCollisionGeometryBSPEdge<LittleEndian> *edges;
-        std::uint32_t edge_count;
-        const ModelCollisionGeometryBSPVertex<LittleEndian> *vertices;
-        std::uint32_t vertex_count;
+        const BSPData &bsp;
 
         bool check_for_intersection_bsp2d_node (
             FlaggedInt<std::uint32_t> node_index,
@@ -58,38 +41,25 @@ namespace Invader::HEK {
             std::uint32_t &surface_index
         );
 
-        bool check_for_intersection_recursion (
+        bool check_for_intersection_leaf (
             const Point3D<LittleEndian> &point_a,
-            const Point3D<LittleEndian> &point_b,
-            std::uint32_t &surface_index,
-            std::uint32_t &leaf_index,
-            Point3D<LittleEndian> &intersection_point,
-            FlaggedInt<std::uint32_t> node_index
+            std::uint32_t leaf_index,
+            BSPIntersectionStackFrame::Result &result
+        );
+
+        bool check_for_intersection_tree (
+            std::vector<BSPIntersectionStackFrame> &stack,
+            BSPIntersectionStackFrame::Result &result
         );
 
         IntersectionCheck(
             const Point3D<LittleEndian> &original_point_a,
             const Point3D<LittleEndian> &original_point_b,
-            const ModelCollisionGeometryBSP3DNode<LittleEndian> *bsp3d_nodes,
-            std::uint32_t bsp3d_node_count,
-            const ModelCollisionGeometryBSPPlane<LittleEndian> *planes,
-            std::uint32_t plane_count,
-            const ModelCollisionGeometryBSPLeaf<LittleEndian> *leaves,
-            std::uint32_t leaf_count,
-            const ModelCollisionGeometryBSP2DNode<LittleEndian> *bsp2d_nodes,
-            std::uint32_t bsp2d_node_count,
-            const ModelCollisionGeometryBSP2DReference<LittleEndian> *bsp2d_references,
-            std::uint32_t bsp2d_reference_count,
-            const ModelCollisionGeometryBSPSurface<LittleEndian> *surfaces,
-            std::uint32_t surface_count,
-            const ModelCollisionGeometryBSPEdge<LittleEndian> *edges,
-            std::uint32_t edge_count,
-            const ModelCollisionGeometryBSPVertex<LittleEndian> *vertices,
-            std::uint32_t vertex_count
+            const BSPData &bsp
         );
     };
     
-    FlaggedInt<std::uint32_t> leaf_for_point_of_bsp_tree(const Point3D<LittleEndian> &point, const ModelCollisionGeometryBSP3DNode<LittleEndian> *bsp3d_nodes, std::uint32_t bsp3d_node_count, const ModelCollisionGeometryBSPPlane<LittleEndian> *planes, std::uint32_t plane_count);
+    FlaggedInt<std::uint32_t> leaf_for_point_of_bsp_tree(const Point3D<LittleEndian> &point, const ModelCollisionGeometryBSP3DNode<LittleEndian> *bsp3d_nodes, std::uint32_t bsp3d_node_count, const ModelCollisionGeometryBSPPlane<LittleEndian> *planes, std::uint32_t plane_count, FlaggedInt<std::uint32_t> start_node = {0});
 }
 
 #endif
@@ -1,5 +1,7 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <algorithm>
+#include <cmath>
 #include <invader/tag/hek/class/model_collision_geometry.hpp>
 #include "intersection_check.hpp"
 
@@ -8,20 +10,9 @@ namespace Invader::HEK {
         // Set our variables up
         Point3D<LittleEndian> new_intersection_point;
         std::uint32_t new_surface_index, new_leaf_index;
+        std::vector<BSPIntersectionStackFrame> stack;
         
-        if(IntersectionCheck::check_for_intersection(
-            point_a,
-            point_b,
-            this->bsp3d_nodes, this->bsp3d_node_count,
-            this->planes, this->plane_count,
-            this->leaves, this->leaf_count,
-            this->bsp2d_nodes, this->bsp2d_node_count,
-            this->bsp2d_references, this->bsp2d_reference_count,
-            this->surfaces, this->surface_count,
-            this->edges, this->edge_count, 
-            this->vertices, this->vertex_count,
-            new_intersection_point, new_surface_index, new_leaf_index
-        )) {
+        if(IntersectionCheck::check_for_intersection(*this, stack, point_a, point_b, new_intersection_point, new_surface_index, new_leaf_index)) {
             if(intersection_point) *intersection_point = new_intersection_point;
             if(surface_index) *surface_index = new_surface_index;
             if(leaf_index) *leaf_index = new_leaf_index;
@@ -32,80 +23,98 @@ namespace Invader::HEK {
     }
     
     bool BSPData::check_for_intersection(const Point3D<LittleEndian> &point, float range, Point3D<LittleEndian> *intersection_point, std::uint32_t *surface_index, std::uint32_t *leaf_index) const {
+        Point3D<LittleEndian> new_intersection_point;
+        std::uint32_t new_surface_index, new_leaf_index;
+        std::vector<BSPIntersectionStackFrame> stack;
+        
+        if(this->check_for_intersection(stack, point, range, new_intersection_point, new_surface_index, new_leaf_index)) {
+            if(intersection_point) *intersection_point = new_intersection_point;
+            if(surface_index) *surface_index = new_surface_index;
+            if(leaf_index) *leaf_index = new_leaf_index;
+            return true;
+        }
+        
+        return false;
+    }
+    
+    std::size_t BSPData::check_for_intersections(float range, BSPIntersectionBatch &batch) const {
+        std::size_t point_count = batch.points.size();
+        batch.found.resize(point_count);
+        batch.intersection_points.resize(point_count);
+        batch.surface_indices.resize(point_count);
+        batch.leaf_indices.resize(point_count);
+        
+        std::size_t hits = 0;
+        for(std::size_t p = 0; p < point_count; p++) {
+            bool found = this->check_for_intersection(batch.stack, batch.points[p], range, batch.intersection_points[p], batch.surface_indices[p], batch.leaf_indices[p]);
+            batch.found[p] = found;
+            hits += found;
+        }
+        
+        return hits;
+    }
+    
+    bool BSPData::check_for_intersection(std::vector<BSPIntersectionStackFrame> &stack, const Point3D<LittleEndian> &point, float range, Point3D<LittleEndian> &intersection_point, std::uint32_t &surface_index, std::uint32_t &leaf_index) const {
         // Plus or minus distance it
         auto position_above = point;
         position_above.z = position_above.z + range;
         auto position_below = point;
         position_below.z = position_below.z - range;
         
-        // Hold any results in a struct
-        struct PositionFound {
-            std::uint32_t leaf_index_found;
-            std::uint32_t surface_index_found;
-            HEK::Point3D<HEK::LittleEndian> intersection_point_found;
-        };
-        std::vector<PositionFound> positions_found;
-        
-        // Start with the top position and work our way down
+        // Start with the top position and work our way down, keeping the closest intersection to our input point
         auto current_position = position_above;
+        bool found = false;
+        float closest_distance_squared = range;
         
         // Keep doing this until we can't anymore
         while(current_position.z.read() > position_below.z.read()) {
             std::uint32_t leaf_index_found;
             std::uint32_t surface_index_found;
             HEK::Point3D<HEK::LittleEndian> intersection_point_found;
-            auto val = this->check_for_intersection(
-                current_position,
-                position_below,
-                &intersection_point_found,
-                &surface_index_found,
-                &leaf_index_found
-            );
-            
-            // We got it!
-            if(val) {
-                positions_found.emplace_back(PositionFound { leaf_index_found, surface_index_found, intersection_point_found });
-                current_position.z = intersection_point_found.z - 0.01F; // subtract a lil' bit so we don't loop forever
-            }
             
             // No intersection found; no point continuing then
-            else {
+            if(!IntersectionCheck::check_for_intersection(*this, stack, current_position, position_below, intersection_point_found, surface_index_found, leaf_index_found)) {
                 break;
             }
-        }
-        
-        // Find the closest intersection to our input point
-        PositionFound *closest = nullptr;
-        float closest_distance_squared = range;
-        for(auto &i : positions_found) {
-            float new_distance = i.intersection_point_found.distance_from_point_squared(point);
-            if(!closest || new_distance < closest_distance_squared) {
-                closest_distance_squared = new_distance;
-                closest = &i;
-            }
-        }
-        
-        // If we found the closest point, keep going
-        if(closest) {
-            if(intersection_point) {
-                *intersection_point = closest->intersection_point_found;
-            }
             
-            if(surface_index) {
-                *surface_index = closest->surface_index_found;
-            }
-            
-            if(leaf_index) {
-                *leaf_index = closest->leaf_index_found;
+            // We got it! Is it closer?
+            float new_distance = intersection_point_found.distance_from_point_squared(point);
+            if(!found || new_distance < closest_distance_squared) {
+                closest_distance_squared = new_distance;
+                intersection_point = intersection_point_found;
+                surface_index = surface_index_found;
+                leaf_index = leaf_index_found;
+                found = true;
             }
             
-            return true;
+            current_position.z = intersection_point_found.z - 0.01F; // subtract a lil' bit so we don't loop forever
         }
-        return false;
+        
+        return found;
     }
     
     bool BSPData::check_if_point_inside_bsp(const Point3D<LittleEndian> &point, std::uint32_t *leaf_index) const {
-        auto result = HEK::leaf_for_point_of_bsp_tree(point, this->bsp3d_nodes, this->bsp3d_node_count, this->planes, this->plane_count);
+        // If we have a grid, start from whatever node the point's cell is in
+        FlaggedInt<std::uint32_t> start_node = {0};
+        auto &grid = this->leaf_grid;
+        if(!grid.start_nodes.empty()) {
+            const float coordinates[3] = { point.x, point.y, point.z };
+            std::size_t cell_index = 0;
+            bool in_grid = true;
+            for(std::size_t a = 3; a > 0; a--) {
+                float offset = (coordinates[a - 1] - grid.minimum[a - 1]) / grid.cell_size[a - 1];
+                if(!(offset >= 0.0F && offset < static_cast<float>(grid.cells_per_axis))) {
+                    in_grid = false;
+                    break;
+                }
+                cell_index = cell_index * grid.cells_per_axis + std::min(static_cast<std::uint32_t>(offset), grid.cells_per_axis - 1);
+            }
+            if(in_grid) {
+                start_node = grid.start_nodes[cell_index];
+            }
+        }
+        
+        auto result = HEK::leaf_for_point_of_bsp_tree(point, this->bsp3d_nodes, this->bsp3d_node_count, this->planes, this->plane_count, start_node);
         
         // If null, then we don't have anything
         if(result.is_null()) {
@@ -119,4 +128,85 @@ namespace Invader::HEK {
         
         return true;
     }
+    
+    void BSPData::build_leaf_grid(std::uint32_t cells_per_axis) {
+        auto &grid = this->leaf_grid;
+        grid = {};
+        
+        if(cells_per_axis == 0 || this->vertex_count == 0 || this->bsp3d_node_count == 0) {
+            return;
+        }
+        
+        // Get the bounds of the BSP
+        float minimum[3] = { this->vertices[0].point.x, this->vertices[0].point.y, this->vertices[0].point.z };
+        float maximum[3] = { minimum[0], minimum[1], minimum[2] };
+        for(std::uint32_t v = 1; v < this->vertex_count; v++) {
+            auto &point = this->vertices[v].point;
+            const float coordinates[3] = { point.x, point.y, point.z };
+            for(std::size_t a = 0; a < 3; a++) {
+                minimum[a] = std::min(minimum[a], coordinates[a]);
+                maximum[a] = std::max(maximum[a], coordinates[a]);
+            }
+        }
+        
+        for(std::size_t a = 0; a < 3; a++) {
+            grid.minimum[a] = minimum[a];
+            grid.cell_size[a] = std::max((maximum[a] - minimum[a]) / static_cast<float>(cells_per_axis), 0.001F);
+        }
+        grid.cells_per_axis = cells_per_axis;
+        grid.start_nodes.resize(static_cast<std::size_t>(cells_per_axis) * cells_per_axis * cells_per_axis);
+        
+        // Pad each cell a little bit in case a point near the edge gets rounded into the wrong cell
+        float half_size[3];
+        for(std::size_t a = 0; a < 3; a++) {
+            half_size[a] = grid.cell_size[a] * 0.51F;
+        }
+        
+        std::size_t cell_index = 0;
+        for(std::uint32_t z = 0; z < cells_per_axis; z++) {
+            for(std::uint32_t y = 0; y < cells_per_axis; y++) {
+                for(std::uint32_t x = 0; x < cells_per_axis; x++) {
+                    const float center[3] = {
+                        grid.minimum[0] + (static_cast<float>(x) + 0.5F) * grid.cell_size[0],
+                        grid.minimum[1] + (static_cast<float>(y) + 0.5F) * grid.cell_size[1],
+                        grid.minimum[2] + (static_cast<float>(z) + 0.5F) * grid.cell_size[2]
+                    };
+                    float largest_coordinate = 0.0F;
+                    for(std::size_t a = 0; a < 3; a++) {
+                        largest_coordinate = std::max(largest_coordinate, std::fabs(center[a]) + half_size[a]);
+                    }
+                    
+                    // Go down the tree as long as the whole cell is on one side of the plane. Anything invalid is left for the tree walk to complain about.
+                    FlaggedInt<std::uint32_t> node_index = {0};
+                    while(!node_index.flag_value() && !node_index.is_null() && node_index < this->bsp3d_node_count) {
+                        auto &node = this->bsp3d_nodes[node_index];
+                        std::uint32_t plane_index = node.plane;
+                        if(plane_index >= this->plane_count) {
+                            break;
+                        }
+                        
+                        auto &plane = this->planes[plane_index].plane;
+                        float i = plane.vector.i, j = plane.vector.j, k = plane.vector.k, w = plane.w;
+                        float distance = i * center[0] + j * center[1] + k * center[2] - w;
+                        float radius = std::fabs(i) * half_size[0] + std::fabs(j) * half_size[1] + std::fabs(k) * half_size[2];
+                        
+                        // Leave some room for rounding error when the point itself is checked
+                        float margin = ((std::fabs(i) + std::fabs(j) + std::fabs(k)) * largest_coordinate + std::fabs(w)) * 0.00001F;
+                        
+                        if(distance - radius > margin) {
+                            node_index = node.front_child;
+                        }
+                        else if(distance + radius < -margin) {
+                            node_index = node.back_child;
+                        }
+                        else {
+                            break;
+                        }
+                    }
+                    
+                    grid.start_nodes[cell_index++] = node_index;
+                }
+            }
+        }
+    }
 }
@@ -153,7 +153,7 @@ namespace Invader::Parser {
             // Make the struct
             auto &markers_struct = workload.structs.emplace_back();
             ModelMarker::struct_little *markers_struct_arr;
-            markers_struct.data = std::vector<std::byte>(marker_count * sizeof(*markers_struct_arr));
+            markers_struct.data.resize(marker_count * sizeof(*markers_struct_arr));
             markers_struct_arr = reinterpret_cast<decltype(markers_struct_arr)>(markers_struct.data.data());
 
             // Go through each marker
@@ -177,7 +177,7 @@ namespace Invader::Parser {
                 // Make the instances
                 auto &instance_struct = workload.structs.emplace_back();
                 ModelMarkerInstance::struct_little *instances_struct_arr;
-                instance_struct.data = std::vector<std::byte>(sizeof(*instances_struct_arr) * instance_count);
+                instance_struct.data.resize(sizeof(*instances_struct_arr) * instance_count);
                 instances_struct_arr = reinterpret_cast<decltype(instances_struct_arr)>(instance_struct.data.data());
                 for(std::size_t i = 0; i < instance_count; i++) {
                     instances_struct_arr[i].node_index = marker_c.instances[i].node_index;
@@ -1,5 +1,8 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <atomic>
+#include <exception>
+#include <thread>
 #include <invader/tag/parser/parser.hpp>
 #include <invader/build/build_workload.hpp>
 #include <invader/file/file.hpp>
@@ -13,6 +16,72 @@ namespace Invader::Parser {
         reinterpret_cast<struct_little *>(workload.structs[struct_index].data.data() + struct_offset)->unknown_ffffffff = 0xFFFFFFFF;
     }
     
+    // Warnings found while finding stuff in parallel, reported afterwards in order so the output is the same every time
+    struct DeferredWarnings {
+        struct Warning {
+            bool report;
+            std::string message;
+        };
+        std::vector<Warning> warnings;
+        std::size_t bsp_find_warnings = 0;
+        std::exception_ptr exception;
+    };
+    
+    // If report is true, this is reported as a warning for the tag; otherwise it's printed as-is
+    #define DEFER_WARNING_PRINTF(deferred, report, ...) { \
+        char deferred_warning_message[2048]; \
+        std::snprintf(deferred_warning_message, sizeof(deferred_warning_message), __VA_ARGS__); \
+        (deferred).warnings.emplace_back(DeferredWarnings::Warning { report, deferred_warning_message }); \
+    }
+    
+    // For when we don't need any per-thread state
+    struct NoFindState {};
+    
+    // Call function(i, deferred[i], state) for every i in [0, count) on the build's threads; each thread gets its own state
+    template<typename State, typename Function> static void find_in_parallel(const BuildWorkload &workload, std::size_t count, std::vector<DeferredWarnings> &deferred, const Function &function) {
+        std::atomic<std::size_t> next_index = 0;
+        auto work = [&count, &deferred, &function, &next_index]() {
+            State state;
+            for(std::size_t i; (i = next_index++) < count;) {
+                try {
+                    function(i, deferred[i], state);
+                }
+                catch(...) {
+                    deferred[i].exception = std::current_exception();
+                }
+            }
+        };
+        
+        std::size_t thread_count = std::min(workload.get_build_parameters()->get_thread_count(), count);
+        std::vector<std::thread> threads;
+        threads.reserve(thread_count);
+        for(std::size_t t = 1; t < thread_count; t++) {
+            threads.emplace_back(work);
+        }
+        work();
+        for(auto &t : threads) {
+            t.join();
+        }
+    }
+    
+    // Report everything in order, stopping at the first thing that threw (like it would have if it was done serially)
+    static void report_deferred_warnings(BuildWorkload &workload, std::size_t tag_index, const std::vector<DeferredWarnings> &deferred, std::size_t &bsp_find_warnings) {
+        for(auto &d : deferred) {
+            for(auto &w : d.warnings) {
+                if(w.report) {
+                    workload.report_error(ErrorHandler::ErrorType::ERROR_TYPE_WARNING, w.message.c_str(), tag_index);
+                }
+                else {
+                    eprintf_warn_lesser("%s", w.message.c_str());
+                }
+            }
+            bsp_find_warnings += d.bsp_find_warnings;
+            if(d.exception) {
+                std::rethrow_exception(d.exception);
+            }
+        }
+    }
+    
     // Functions for finding stuff
     static std::vector<BSPData> get_bsp_data(const Scenario &scenario, BuildWorkload &workload);
     static void find_encounters(Scenario &scenario, BuildWorkload &workload, std::size_t tag_index, const std::vector<BSPData> &bsp_data, BuildWorkload::BuildWorkloadStruct &scenario_struct, const Scenario::struct_little &scenario_data, std::size_t &bsp_find_warnings, bool show_warnings);
@@ -168,6 +237,9 @@ namespace Invader::Parser {
             if(bsp_data_s.render_leaf_count) {
                 bsp_data_s.render_leaves = reinterpret_cast<const ScenarioStructureBSPLeaf::struct_little *>(workload.structs[*bsp_tag_struct->resolve_pointer(&bsp_tag_data.leaves.pointer)].data.data());
             }
+
+            // We check a lot of points against each BSP, so this is worth it
+            bsp_data_s.build_leaf_grid();
         }
         
         return bsp_data;
@@ -183,7 +255,9 @@ namespace Invader::Parser {
             auto *encounter_array = reinterpret_cast<ScenarioEncounter::struct_little *>(encounter_struct.data.data());
             auto bsp_count = bsp_data.size();
             
-            for(std::size_t i = 0; i < encounter_list_count; i++) {
+            // Each encounter is independent, so find them all in parallel and report any warnings in order afterwards
+            std::vector<DeferredWarnings> deferred(encounter_list_count);
+            find_in_parallel<HEK::BSPIntersectionBatch>(workload, encounter_list_count, deferred, [&](std::size_t i, DeferredWarnings &warnings, HEK::BSPIntersectionBatch &raycast_batch) {
                 auto &encounter = scenario.encounters[i];
                 auto &encounter_data = encounter_array[i];
 
@@ -247,6 +321,21 @@ namespace Invader::Parser {
                     firing_positions_indices.clear();
                     squad_positions_found.clear();
                     auto &bsp = bsp_data[b];
+                    
+                    // If raycasting, check every squad starting location and then every firing position in one go
+                    std::size_t raycast_index = 0;
+                    if(raycast) {
+                        raycast_batch.clear();
+                        for(auto &squad : encounter.squads) {
+                            for(auto &location : squad.starting_locations) {
+                                raycast_batch.points.emplace_back(location.position);
+                            }
+                        }
+                        for(auto &f : encounter.firing_positions) {
+                            raycast_batch.points.emplace_back(f.position);
+                        }
+                        bsp.check_for_intersections(0.5F, raycast_batch);
+                    }
 
                     // Go through each squad; add 1 to hits for every squad we find in the BSP
                     std::size_t squad_hits = 0;
@@ -262,10 +351,10 @@ namespace Invader::Parser {
                             std::optional<std::uint32_t> leaf_index;
                             
                             if(raycast) {
-                                std::uint32_t leaf;
-                                if((found = bsp.check_for_intersection(location.position, 0.5F, nullptr, nullptr, &leaf))) {
-                                    leaf_index = leaf;
+                                if((found = raycast_batch.found[raycast_index])) {
+                                    leaf_index = raycast_batch.leaf_indices[raycast_index];
                                 }
+                                raycast_index++;
                             }
                             else {
                                 std::uint32_t leaf;
@@ -298,7 +387,11 @@ namespace Invader::Parser {
                         
                         // Raycast stuff
                         if(raycast) {
-                            in_bsp = bsp.check_for_intersection(f.position, 0.5F, nullptr, &surface_index, &leaf_index);
+                            if((in_bsp = raycast_batch.found[raycast_index])) {
+                                surface_index = raycast_batch.surface_indices[raycast_index];
+                                leaf_index = raycast_batch.leaf_indices[raycast_index];
+                            }
+                            raycast_index++;
                         }
                         else {
                             std::uint32_t leaf;
@@ -350,20 +443,20 @@ namespace Invader::Parser {
                 
                 // Ambiguous?
                 if(total_best_bsps > 1) {
-                    REPORT_ERROR_PRINTF(workload, ERROR_TYPE_WARNING, tag_index, "Encounter #%zu (%s) was found in %zu BSPs (will place in BSP #%zu)", i, encounter.name.string, total_best_bsps, best_bsp);
-                    bsp_find_warnings++;
+                    DEFER_WARNING_PRINTF(warnings, true, "Encounter #%zu (%s) was found in %zu BSPs (will place in BSP #%zu)", i, encounter.name.string, total_best_bsps, best_bsp);
+                    warnings.bsp_find_warnings++;
                 }
                 
                 // Are we missing stuff?
                 if(total_best_bsps == 0) {
-                    REPORT_ERROR_PRINTF(workload, ERROR_TYPE_WARNING, tag_index, "Encounter #%zu (%s) was found in 0 BSPs", i, encounter.name.string);
+                    DEFER_WARNING_PRINTF(warnings, true, "Encounter #%zu (%s) was found in 0 BSPs", i, encounter.name.string);
                 }
                 else if(best_bsp_total_hits != best_possible_hits) {
                     if(best_bsp_total_hits == 0) {
-                        REPORT_ERROR_PRINTF(workload, ERROR_TYPE_WARNING, tag_index, "Encounter #%zu (%s) is completely outside of BSP #%zu", i, encounter.name.string, best_bsp);
+                        DEFER_WARNING_PRINTF(warnings, true, "Encounter #%zu (%s) is completely outside of BSP #%zu", i, encounter.name.string, best_bsp);
                     }
                     else {
-                        REPORT_ERROR_PRINTF(workload, ERROR_TYPE_WARNING, tag_index, "Encounter #%zu (%s) is partially outside of BSP #%zu", i, encounter.name.string, best_bsp);
+                        DEFER_WARNING_PRINTF(warnings, true, "Encounter #%zu (%s) is partially outside of BSP #%zu", i, encounter.name.string, best_bsp);
                     }
                     
                     // Show the firing positions and squad positions that are missing
@@ -387,7 +480,7 @@ namespace Invader::Parser {
                             }
                         }
                         
-                        eprintf_warn_lesser("    - %zu firing position%s fell out: [%s]", missing_firing_positions, missing_firing_positions == 1 ? "" : "s", missing_firing_positions_list);
+                        DEFER_WARNING_PRINTF(warnings, false, "    - %zu firing position%s fell out: [%s]", missing_firing_positions, missing_firing_positions == 1 ? "" : "s", missing_firing_positions_list);
                     }
                     
                     auto missing_squad_positions = squad_position_count - best_bsp_squad_hits;
@@ -411,7 +504,7 @@ namespace Invader::Parser {
                             }
                         }
                         
-                        eprintf_warn_lesser("    - %zu squad position%s fell out: [%s]", missing_squad_positions, missing_squad_positions == 1 ? "" : "s", missing_squad_positions_list);
+                        DEFER_WARNING_PRINTF(warnings, false, "    - %zu squad position%s fell out: [%s]", missing_squad_positions, missing_squad_positions == 1 ? "" : "s", missing_squad_positions_list);
                     }
                 }
 
@@ -451,6 +544,16 @@ namespace Invader::Parser {
                         std::size_t move_position_count = squad.move_positions.count.read();
                         if(move_position_count) {
                             auto *move_position_data = reinterpret_cast<Parser::ScenarioMovePosition::struct_little *>(workload.structs[*squad_struct.resolve_pointer(&squad.move_positions.pointer)].data.data());
+                            
+                            // If raycasting, check all of the squad's move positions in one go
+                            if(found_bsp && raycast) {
+                                raycast_batch.clear();
+                                for(std::size_t p = 0; p < move_position_count; p++) {
+                                    raycast_batch.points.emplace_back(move_position_data[p].position);
+                                }
+                                found_bsp->check_for_intersections(0.5F, raycast_batch);
+                            }
+                            
                             for(std::size_t p = 0; p < move_position_count; p++) {
                                 if(!found_bsp) {
                                     move_position_data[p].cluster_index = NULL_INDEX;
@@ -462,9 +565,9 @@ namespace Invader::Parser {
                                 std::uint32_t surface_index = 0;
                                 
                                 if(raycast) {
-                                    std::uint32_t leaf;
-                                    if(found_bsp->check_for_intersection(move_position_data[p].position, 0.5F, nullptr, &surface_index, &leaf)) {
-                                        leaf_index = leaf;
+                                    if(raycast_batch.found[p]) {
+                                        surface_index = raycast_batch.surface_indices[p];
+                                        leaf_index = raycast_batch.leaf_indices[p];
                                     }
                                 }
                                 else {
@@ -493,7 +596,7 @@ namespace Invader::Parser {
                     }
                     
                     if(out_of_bounds && show_warnings) {
-                        REPORT_ERROR_PRINTF(workload, ERROR_TYPE_WARNING, tag_index, "Encounter #%zu (%s) has %zu squad move position%s that fall out of BSP #%zu", i, encounter.name.string, out_of_bounds, out_of_bounds == 1 ? "" : "s", best_bsp);
+                        DEFER_WARNING_PRINTF(warnings, true, "Encounter #%zu (%s) has %zu squad move position%s that fall out of BSP #%zu", i, encounter.name.string, out_of_bounds, out_of_bounds == 1 ? "" : "s", best_bsp);
                         
                         int offset = 0;
                         char missing_move_positions_list[256] = {};
@@ -515,10 +618,11 @@ namespace Invader::Parser {
                             }
                         }
                         
-                        eprintf_warn_lesser("    - %zu move position%s fell out: [%s]", out_of_bounds, out_of_bounds == 1 ? "" : "s", missing_move_positions_list);
+                        DEFER_WARNING_PRINTF(warnings, false, "    - %zu move position%s fell out: [%s]", out_of_bounds, out_of_bounds == 1 ? "" : "s", missing_move_positions_list);
                     }
                 }
-            }
+            });
+            report_deferred_warnings(workload, tag_index, deferred, bsp_find_warnings);
         }
     }
     
@@ -528,14 +632,16 @@ namespace Invader::Parser {
             auto &command_list_struct = workload.structs[*scenario_struct.resolve_pointer(&scenario_data.command_lists.pointer)];
             auto *command_list_array = reinterpret_cast<ScenarioCommandList::struct_little *>(command_list_struct.data.data());
             auto bsp_count = bsp_data.size();
-            for(std::size_t i = 0; i < command_list_count; i++) {
+            // Same as encounters; each command list is independent
+            std::vector<DeferredWarnings> deferred(command_list_count);
+            find_in_parallel<HEK::BSPIntersectionBatch>(workload, command_list_count, deferred, [&](std::size_t i, DeferredWarnings &warnings, HEK::BSPIntersectionBatch &raycast_batch) {
                 auto &command_list = scenario.command_lists[i];
                 auto &command_list_data = command_list_array[i];
 
                 // If there are no points, set to a null BSP
                 if(command_list.points.size() == 0) {
                     command_list_data.precomputed_bsp_index = NULL_INDEX;
-                    continue;
+                    return;
                 }
 
                 // Go through each BSP
@@ -567,13 +673,18 @@ namespace Invader::Parser {
 
                     // Basically, add 1 for every time we find it in here
                     // We need to check if there is a surface that is half a world unit or less below the position
+                    raycast_batch.clear();
                     for(auto &p : command_list.points) {
+                        raycast_batch.points.emplace_back(p.position);
+                    }
+                    bsp.check_for_intersections(0.5F, raycast_batch);
+                    
+                    for(std::size_t p = 0; p < point_count; p++) {
                         total_hits++;
                         
-                        std::uint32_t surface_index = 0;
-                        if(bsp.check_for_intersection(p.position, 0.5F, nullptr, &surface_index, nullptr)) {
+                        if(raycast_batch.found[p]) {
                             hits++;
-                            surface_indices.emplace_back(surface_index); // found a surface
+                            surface_indices.emplace_back(raycast_batch.surface_indices[p]); // found a surface
                         }
                         else {
                             surface_indices.emplace_back(std::nullopt); // no surface underneath
@@ -618,14 +729,14 @@ namespace Invader::Parser {
                 // Show warnings if needed (only warn if we have more than 0 points, since 0 point encounters can't technically be in any BSP)
                 if(show_warnings && point_count > 0) {
                     if(total_best_bsps == 0) {
-                        REPORT_ERROR_PRINTF(workload, ERROR_TYPE_WARNING, tag_index, "Command list #%zu (%s) was found in 0 BSPs", i, command_list.name.string);
+                        DEFER_WARNING_PRINTF(warnings, true, "Command list #%zu (%s) was found in 0 BSPs", i, command_list.name.string);
                     }
                     else if(best_bsp_hits != point_count) {
                         if(best_bsp_hits == 0) {
-                            REPORT_ERROR_PRINTF(workload, ERROR_TYPE_WARNING, tag_index, "Command list #%zu (%s) is completely outside of BSP #%zu (%zu / %zu hit%s)", i, command_list.name.string, best_bsp, best_bsp_hits, point_count, point_count == 1 ? "" : "s");
+                            DEFER_WARNING_PRINTF(warnings, true, "Command list #%zu (%s) is completely outside of BSP #%zu (%zu / %zu hit%s)", i, command_list.name.string, best_bsp, best_bsp_hits, point_count, point_count == 1 ? "" : "s");
                         }
                         else {
-                            REPORT_ERROR_PRINTF(workload, ERROR_TYPE_WARNING, tag_index, "Command list #%zu (%s) is partially outside of BSP #%zu (%zu / %zu hit%s)", i, command_list.name.string, best_bsp, best_bsp_hits, point_count, point_count == 1 ? "" : "s");
+                            DEFER_WARNING_PRINTF(warnings, true, "Command list #%zu (%s) is partially outside of BSP #%zu (%zu / %zu hit%s)", i, command_list.name.string, best_bsp, best_bsp_hits, point_count, point_count == 1 ? "" : "s");
                         }
                             
                         auto missing_points = point_count - best_bsp_hits;
@@ -647,32 +758,81 @@ namespace Invader::Parser {
                             }
                         }
                         
-                        eprintf_warn_lesser("    - %zu point%s fell out: [%s]", missing_points, missing_points == 1 ? "" : "s", missing_points_list);
+                        DEFER_WARNING_PRINTF(warnings, false, "    - %zu point%s fell out: [%s]", missing_points, missing_points == 1 ? "" : "s", missing_points_list);
                     }
                     else if(total_best_bsps > 1) {
-                        REPORT_ERROR_PRINTF(workload, ERROR_TYPE_WARNING, tag_index, "Command list #%zu (%s) was found in %zu BSP%s (will place in BSP #%zu)", i, command_list.name.string, total_best_bsps, total_best_bsps == 1 ? "" : "s", best_bsp);
-                        bsp_find_warnings++;
+                        DEFER_WARNING_PRINTF(warnings, true, "Command list #%zu (%s) was found in %zu BSP%s (will place in BSP #%zu)", i, command_list.name.string, total_best_bsps, total_best_bsps == 1 ? "" : "s", best_bsp);
+                        warnings.bsp_find_warnings++;
                     }
                 }
-            }
+            });
+            report_deferred_warnings(workload, tag_index, deferred, bsp_find_warnings);
         }
     }
     
     static void find_decals(Scenario &scenario, BuildWorkload &workload, const std::vector<BSPData> &bsp_data) {
         std::size_t decal_count = scenario.decals.size();
         if(decal_count > 0) {
-            for(std::size_t bsp = 0; bsp < scenario.structure_bsps.size(); bsp++) {
-                auto &b = scenario.structure_bsps[bsp];
-                auto &bsp_id = b.structure_bsp.tag_id;
-                if(!bsp_id.is_null()) {
-                    // Figure out the base tag struct thing
-                    auto *bsp_tag_struct = &workload.structs[workload.tags[bsp_id.index].base_struct.value()];
-                    
-                    // If we're not on native, we need to read the pointer at the beginning of the struct
-                    if(workload.get_build_parameters()->details.build_cache_file_engine != HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
-                        bsp_tag_struct = &workload.structs[bsp_tag_struct->resolve_pointer(static_cast<std::size_t>(0)).value()];
+            std::size_t bsp_count = scenario.structure_bsps.size();
+            
+            // Get the BSP tag data (if any)
+            auto get_bsp_tag_struct = [&scenario, &workload](std::size_t bsp) -> BuildWorkload::BuildWorkloadStruct * {
+                auto &bsp_id = scenario.structure_bsps[bsp].structure_bsp.tag_id;
+                if(bsp_id.is_null()) {
+                    return nullptr;
+                }
+                
+                // Figure out the base tag struct thing
+                auto *bsp_tag_struct = &workload.structs[workload.tags[bsp_id.index].base_struct.value()];
+                
+                // If we're not on native, we need to read the pointer at the beginning of the struct
+                if(workload.get_build_parameters()->details.build_cache_file_engine != HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
+                    bsp_tag_struct = &workload.structs[bsp_tag_struct->resolve_pointer(static_cast<std::size_t>(0)).value()];
+                }
+                
+                return bsp_tag_struct;
+            };
+            
+            // Go through each decal for each BSP; see what we can come up with (decals for each cluster are kept in the order they appear in the scenario)
+            std::vector<std::vector<std::vector<std::size_t>>> cluster_decals(bsp_count);
+            std::vector<DeferredWarnings> deferred(bsp_count);
+            find_in_parallel<NoFindState>(workload, bsp_count, deferred, [&](std::size_t bsp, DeferredWarnings &, NoFindState &) {
+                auto *bsp_tag_struct = get_bsp_tag_struct(bsp);
+                if(bsp_tag_struct == nullptr) {
+                    return;
+                }
+                
+                auto &bsp_tag_data = *reinterpret_cast<const ScenarioStructureBSP::struct_little *>(bsp_tag_struct->data.data());
+                std::size_t bsp_cluster_count = bsp_tag_data.clusters.count.read();
+                if(bsp_cluster_count == 0) {
+                    return;
+                }
+                
+                auto &bd = bsp_data[bsp];
+                auto &bsp_cluster_decals = cluster_decals[bsp];
+                bsp_cluster_decals.resize(bsp_cluster_count);
+                for(std::size_t d = 0; d < decal_count; d++) {
+                    std::uint32_t leaf;
+                    if(!bd.check_if_point_inside_bsp(scenario.decals[d].position, &leaf)) {
+                        continue;
                     }
-                    
+                    std::size_t cluster = bd.render_leaves[leaf].cluster.read();
+                    if(cluster < bsp_cluster_count) {
+                        bsp_cluster_decals[cluster].emplace_back(d);
+                    }
+                }
+            });
+            for(auto &d : deferred) {
+                if(d.exception) {
+                    std::rethrow_exception(d.exception);
+                }
+            }
+            
+            // Now add them to the BSPs
+            for(std::size_t bsp = 0; bsp < bsp_count; bsp++) {
+                auto *bsp_tag_struct = get_bsp_tag_struct(bsp);
+                if(bsp_tag_struct != nullptr) {
+                    auto &bsp_id = scenario.structure_bsps[bsp].structure_bsp.tag_id;
                     auto &bsp_tag_data = *reinterpret_cast<ScenarioStructureBSP::struct_little *>(bsp_tag_struct->data.data());
                     std::size_t bsp_cluster_count = bsp_tag_data.clusters.count.read();
 
@@ -680,25 +840,10 @@ namespace Invader::Parser {
                         continue;
                     }
 
-                    // Make sure we know which decals we used for this BSP so we don't reuse them
-                    std::vector<bool> used(decal_count, false);
-
                     // Now let's go do stuff
                     auto &bsp_cluster_struct = workload.structs[*bsp_tag_struct->resolve_pointer(&bsp_tag_data.clusters.pointer)];
                     auto *clusters = reinterpret_cast<ScenarioStructureBSPCluster::struct_little *>(bsp_cluster_struct.data.data());
 
-                    // Go through each decal; see what we can come up with
-                    std::vector<std::pair<std::size_t, std::size_t>> cluster_decals;
-                    for(std::size_t d = 0; d < decal_count; d++) {
-                        auto &decal = scenario.decals[d];
-                        auto &bd = bsp_data[bsp];
-                        std::uint32_t leaf;
-                        if(!bd.check_if_point_inside_bsp(decal.position, &leaf)) {
-                            continue;
-                        }
-                        cluster_decals.emplace_back(bd.render_leaves[leaf].cluster, d);
-                    }
-
                     // Get clusters
                     std::vector<ScenarioStructureBSPRuntimeDecal::struct_little> runtime_decals;
 
@@ -707,15 +852,13 @@ namespace Invader::Parser {
 
                         // Put stuff together
                         std::size_t first_decal = runtime_decals.size();
-                        for(auto &cd : cluster_decals) {
-                            if(cd.first == c) {
-                                auto &decal = scenario.decals[cd.second];
-                                auto &d = runtime_decals.emplace_back();
-                                d.decal_type = decal.decal_type;
-                                d.pitch = decal.pitch;
-                                d.yaw = decal.yaw;
-                                d.position = decal.position;
-                            }
+                        for(auto decal_index : cluster_decals[bsp][c]) {
+                            auto &decal = scenario.decals[decal_index];
+                            auto &d = runtime_decals.emplace_back();
+                            d.decal_type = decal.decal_type;
+                            d.pitch = decal.pitch;
+                            d.yaw = decal.yaw;
+                            d.position = decal.position;
                         }
                         std::size_t decal_end = runtime_decals.size();
 
@@ -739,7 +882,7 @@ namespace Invader::Parser {
                         new_struct_ptr.struct_index = workload.structs.size();
                         auto &new_struct = workload.structs.emplace_back();
                         new_struct.bsp = workload.structs[*workload.tags[bsp_id.index].base_struct].bsp;
-                        new_struct.data = std::vector<std::byte>(reinterpret_cast<std::byte *>(runtime_decals.data()), reinterpret_cast<std::byte *>(runtime_decals.data() + runtime_decals.size()));
+                        new_struct.data.assign(reinterpret_cast<std::byte *>(runtime_decals.data()), reinterpret_cast<std::byte *>(runtime_decals.data() + runtime_decals.size()));
                     }
                 }
             }
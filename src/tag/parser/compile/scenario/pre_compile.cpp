@@ -59,7 +59,11 @@ namespace Invader::Parser {
         }
     }
     
-    void compile_scripts(Scenario &scenario, const HEK::GameEngineInfo &info, std::vector<std::string> &warnings, const std::vector<std::filesystem::path> &tags_directories, const std::optional<std::vector<std::pair<std::string, std::vector<std::byte>>>> &script_source) {
+    void compile_scripts(Scenario &scenario, const HEK::GameEngineInfo &info, std::vector<std::string> &warnings, const std::vector<std::filesystem::path> &tags_directories, const std::optional<std::vector<std::pair<std::string, std::vector<std::byte>>>> &script_source, const File::TagDirectoryIndex *tags_index) {
+        auto find_tag = [&tags_directories, &tags_index](const std::string &tag_path) {
+            return tags_index ? tags_index->find(tag_path) : File::tag_path_to_file_path(tag_path, tags_directories);
+        };
+        
         // Instantiate it
         RIAT::Compiler instance(static_cast<RIATCompileTarget>(info.scenario_script_compile_target));
         
@@ -67,7 +71,7 @@ namespace Invader::Parser {
         Parser::HUDMessageText hmt;
         bool hmt_exists = !scenario.hud_messages.path.empty();
         if(hmt_exists) {
-            auto file_path = File::tag_path_to_file_path(File::halo_path_to_preferred_path(scenario.hud_messages.path) + ".hud_message_text", tags_directories);
+            auto file_path = find_tag(File::halo_path_to_preferred_path(scenario.hud_messages.path) + ".hud_message_text");
             if(file_path.has_value()) {
                 auto hud_message_text_data = File::open_file(*file_path);
                 if(!hud_message_text_data.has_value()) {
@@ -80,7 +84,7 @@ namespace Invader::Parser {
         
         // Eventually get the HUD globals tag
         Parser::HUDGlobals hud_globals;
-        auto globals_file_path = File::tag_path_to_file_path(File::halo_path_to_preferred_path("globals\\globals.globals"), tags_directories);
+        auto globals_file_path = find_tag(File::halo_path_to_preferred_path("globals\\globals.globals"));
         bool globals_exists = globals_file_path.has_value();
         bool hud_globals_exists = false;
         if(globals_exists) {
@@ -94,7 +98,7 @@ namespace Invader::Parser {
             if(!globals.interface_bitmaps.empty()) {
                 auto &interface_bitmaps = globals.interface_bitmaps[0];
                 if(!interface_bitmaps.hud_globals.path.empty()) {
-                    auto file_path = File::tag_path_to_file_path(File::halo_path_to_preferred_path(interface_bitmaps.hud_globals.path) + ".hud_globals", tags_directories);
+                    auto file_path = find_tag(File::halo_path_to_preferred_path(interface_bitmaps.hud_globals.path) + ".hud_globals");
                     if(file_path.has_value()) {
                         auto hud_globals_data = File::open_file(*file_path);
                         if(!hud_globals_data.has_value()) {
@@ -555,8 +559,8 @@ namespace Invader::Parser {
             
             if(!resolved) {
                 try {
-                    auto resolve_maybe = [&tags_directories, &r]() -> bool {
-                        return File::tag_path_to_file_path(r.first, tags_directories).has_value();
+                    auto resolve_maybe = [&find_tag, &r]() -> bool {
+                        return find_tag(r.first.join()).has_value();
                     };
                     auto resolve_with_fourcc_maybe = [&resolve_maybe, &r](HEK::TagFourCC fourcc) -> bool {
                         r.first.fourcc = fourcc;
@@ -603,7 +607,7 @@ namespace Invader::Parser {
                     
                     // Warn if so, but add it
                     if(fourcc_matches) {
-                        if((resolved = File::tag_path_to_file_path(tfp, tags_directories).has_value())) {
+                        if((resolved = find_tag(tfp.join()).has_value())) {
                             char w[1024];
                             std::snprintf(w, sizeof(w), "%s:%zu:%zu: warning: using tag paths with explicit groups is a Halo 2 extension and may not work with stock tools or any future release of Invader", n.file, n.line, n.column);
                             warnings.emplace_back(w);
@@ -892,7 +896,7 @@ namespace Invader::Parser {
         try {
             std::vector<std::string> warnings;
             
-            compile_scripts(scenario, HEK::GameEngineInfo::get_game_engine_info(build_parameters.details.build_game_engine), warnings, build_parameters.tags_directories);
+            compile_scripts(scenario, HEK::GameEngineInfo::get_game_engine_info(build_parameters.details.build_game_engine), warnings, build_parameters.tags_directories, std::nullopt, workload.get_tags_index());
             for(auto &w : warnings) {
                 REPORT_ERROR_PRINTF(workload, ERROR_TYPE_WARNING, tag_index, "Script compilation warning: %s", w.c_str());
             }
@@ -925,7 +929,7 @@ namespace Invader::Parser {
 
         // Get these things
         BuildWorkload::BuildWorkloadStruct script_data_struct = {};
-        script_data_struct.data = std::move(scenario.script_syntax_data);
+        script_data_struct.data.assign(scenario.script_syntax_data.begin(), scenario.script_syntax_data.end());
         scenario.script_syntax_data.clear();
         const char *string_data = reinterpret_cast<const char *>(scenario.script_string_data.data());
         
@@ -1394,8 +1398,8 @@ namespace Invader::Parser {
                     // Find it
                     char file_path_cstr[1024];
                     std::snprintf(file_path_cstr, sizeof(file_path_cstr), "%s.%s", File::halo_path_to_preferred_path(first_scenario.path).c_str(), HEK::tag_fourcc_to_extension(first_scenario.tag_fourcc));
-                    auto file_path = File::tag_path_to_file_path(file_path_cstr, workload.get_build_parameters()->tags_directories);
-                    if(!file_path.has_value() || !std::filesystem::exists(*file_path)) {
+                    auto file_path = workload.find_tag_file(file_path_cstr);
+                    if(!file_path.has_value()) {
                         REPORT_ERROR_PRINTF(workload, ERROR_TYPE_FATAL_ERROR, tag_index, "Child scenario %s not found", file_path_cstr);
                         throw InvalidTagDataException();
                     }
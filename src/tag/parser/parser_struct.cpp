@@ -704,6 +704,29 @@ namespace Invader::Parser {
         #undef DO_TAG_CLASS
     }
 
+    void ParserStruct::scan_hek_dependencies(const std::byte *data, std::size_t data_size, const DependencyCallback &callback) {
+        const auto *header = reinterpret_cast<const HEK::TagFileHeader *>(data);
+        HEK::TagFileHeader::validate_header(header, data_size);
+
+        #define DO_TAG_CLASS(class_struct, fourcc) case TagFourCC::fourcc: { \
+            return Invader::Parser::class_struct::scan_hek_dependencies(data, data_size, callback); \
+        }
+
+        switch(header->tag_fourcc) {
+            DO_BASED_ON_TAG_CLASS
+
+            case Invader::HEK::TagFourCC::TAG_FOURCC_NONE:
+            case Invader::HEK::TagFourCC::TAG_FOURCC_NULL:
+            case Invader::HEK::TagFourCC::TAG_FOURCC_SPHEROID:
+                break;
+        }
+
+        eprintf_error("Unknown tag class %s", tag_fourcc_to_extension(header->tag_fourcc));
+        throw InvalidTagDataException();
+
+        #undef DO_TAG_CLASS
+    }
+
     std::unique_ptr<ParserStruct> ParserStruct::generate_base_struct(TagFourCC tag_class) {
         #define DO_TAG_CLASS(class_struct, fourcc) case TagFourCC::fourcc: { \
             return std::unique_ptr<ParserStruct>(new class_struct()); \